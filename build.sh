@@ -6,9 +6,12 @@
 # This is the main build script.
 # To generate a debug build, do ./build.sh debug
 # To generate a release build, do ./build.sh release
+# To generate a release build with findAQ --perf, do ./build.sh perf
 # To clean the source, do ./build.sh clean
 #
 # If no arguments are supplied, the default is to do a debug build.
+# Any further arguments are passed to configure, e.g. to build the
+# shared-memory variant without MPI, do ./build.sh release --without-mpi
 
 if [ -z "$1" ]; then
     BUILD_TYPE=debug
@@ -22,17 +25,21 @@ elif [ $BUILD_TYPE = "profile" ]; then
     CFLAGS="$CFLAGS -pg -g -fno-inline -O3 -DNDEBUG"
 elif [ $BUILD_TYPE = "release" ]; then
     CFLAGS="$CFLAGS -O3 -DNDEBUG"
+elif [ $BUILD_TYPE = "perf" ]; then
+    CFLAGS="$CFLAGS -g -O3 -DNDEBUG"
+    CONFIGURE_ARGS="--enable-perf"
 elif [ $BUILD_TYPE = "clean" ]; then
     make clean
     exit
 else
-    echo "Build type must be either \"debug\", \"release\" or \"profile\"."
+    echo "Build type must be either \"debug\", \"release\", \"profile\" or \"perf\"."
     exit
 fi
 
 NUM_CPUS=$(getconf _NPROCESSORS_ONLN)
 
-CFLAGS=$CFLAGS ./configure
+[ $# -gt 0 ] && shift
+CFLAGS=$CFLAGS ./configure $CONFIGURE_ARGS "$@"
 make -j $NUM_CPUS
 
 # vim: set ts=4 sw=4 et:
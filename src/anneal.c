@@ -0,0 +1,167 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A local search for large solutions.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "anneal.h"
+#include "aq.h"
+#include "trace.h"
+
+/**
+ * Returns a random number in [0, 1).
+ */
+static inline
+double anneal_uniform(uint64_t *state) {
+    return (aq_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Sums how far the number of attacks on every queen is from k.
+ */
+static
+int anneal_violation(struct aq_board *board,
+        const struct aq_geometry *geometry, int k, int wrap) {
+    int violation = 0;
+    int attacks;
+
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (!board_is_occupied(board, geometry, i, j)) {
+                continue;
+            }
+
+            struct aq_board simulation_board = *board;
+            board_set_unoccupied(&simulation_board, geometry, i, j);
+            attacks = wrap ?
+                board_cell_count_attacks_wrap(&simulation_board, geometry, i,
+                        j) :
+                board_cell_count_attacks(&simulation_board, geometry, i, j);
+            violation += attacks > k ? attacks - k : k - attacks;
+        }
+    }
+
+    return violation;
+}
+
+/**
+ * Checks that a board is a solution for k with the same tests as the exact
+ * search.
+ */
+static
+int anneal_is_solution(struct aq_board *board,
+        const struct aq_geometry *geometry, int k, int wrap) {
+    if (wrap) {
+        return board_all_has_same_attacks_wrap(board, geometry) &&
+               board_max_attacks_wrap(board, geometry) == k;
+    }
+
+    return board_all_has_same_attacks(board, geometry) &&
+           board_max_attacks(board, geometry) == k;
+}
+
+/**
+ * Anneals for the given number of seconds, looking for a board with as many
+ * queens as possible on which every queen is attacked exactly k times.
+ *
+ * Every step adds a queen on a random empty cell, removes a random queen or
+ * moves it to a random empty cell. The cost of a board is its violation
+ * weighted by AQ_ANNEAL_PENALTY less its number of queens, and a step that
+ * raises the cost is kept with the usual Boltzmann probability.
+ *
+ * The best solution found is stored in best. Returns its number of queens, or
+ * zero if no solution was found, in which case best is empty.
+ */
+int anneal_run(int size, int k, int wrap, double seconds, uint64_t seed,
+        struct aq_board *best) {
+    struct aq_geometry geometry;
+    struct aq_board board;
+    struct aq_board previous;
+    uint64_t state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    int num_cells = size * size;
+    int num_queens = 0;
+    int previous_queens;
+    int best_queens = 0;
+    int violation = 0;
+    int next_violation;
+    int row, col, cell;
+    double temperature = AQ_ANNEAL_START_TEMPERATURE;
+    double start = trace_clock(CLOCK_MONOTONIC) / 1e9;
+    double elapsed;
+    double cost = 0;
+    double next_cost;
+    long steps;
+
+    board_geometry_init(&geometry, size);
+    board = board_new();
+    *best = board;
+
+    for (steps = 0; ; ++steps) {
+        if (steps % AQ_ANNEAL_CHECK_INTERVAL == 0) {
+            elapsed = trace_clock(CLOCK_MONOTONIC) / 1e9 - start;
+            if (elapsed >= seconds) {
+                break;
+            }
+
+            temperature = AQ_ANNEAL_START_TEMPERATURE *
+                pow(AQ_ANNEAL_END_TEMPERATURE / AQ_ANNEAL_START_TEMPERATURE,
+                        elapsed / seconds);
+        }
+
+        previous = board;
+        previous_queens = num_queens;
+
+        cell = aq_random(&state) % num_cells;
+        row = cell / size;
+        col = cell % size;
+        if (!board_is_occupied(&board, &geometry, row, col)) {
+            board_set_occupied(&board, &geometry, row, col);
+            num_queens++;
+        } else {
+            board_set_unoccupied(&board, &geometry, row, col);
+            num_queens--;
+
+            // Move the queen half of the time, so that the number of queens
+            // can stay put while the placement changes.
+            if (aq_random(&state) & 1) {
+                do {
+                    cell = aq_random(&state) % num_cells;
+                    row = cell / size;
+                    col = cell % size;
+                } while (board_is_occupied(&board, &geometry, row, col));
+
+                board_set_occupied(&board, &geometry, row, col);
+                num_queens++;
+            }
+        }
+
+        next_violation = anneal_violation(&board, &geometry, k, wrap);
+        next_cost = AQ_ANNEAL_PENALTY * next_violation - num_queens;
+        if (next_cost > cost &&
+            anneal_uniform(&state) >= exp((cost - next_cost) / temperature)) {
+            board = previous;
+            num_queens = previous_queens;
+            continue;
+        }
+
+        violation = next_violation;
+        cost = next_cost;
+        if (!violation && num_queens > best_queens &&
+            anneal_is_solution(&board, &geometry, k, wrap)) {
+            *best = board;
+            best_queens = num_queens;
+            TRACE_INFO(ANNEAL_FOUND, best_queens, steps);
+        }
+    }
+
+    return best_queens;
+}
+
+/* vim: set ts=4 sw=4 et: */
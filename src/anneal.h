@@ -0,0 +1,52 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A local search for large solutions.
+ *
+ * Simulated annealing over queen placements finds boards on which every
+ * queen is attacked exactly k times, with no guarantee that they have the
+ * most queens. Such a board is a lower bound that lets the exact search skip
+ * branches that cannot beat it, and on its own a quick answer for boards too
+ * large to search exactly.
+ */
+
+#ifndef AQ_ANNEAL_H_
+#define AQ_ANNEAL_H_
+
+#include <stdint.h>
+
+#include "board.h"
+
+/**
+ * Default number of seconds spent annealing for a quick answer.
+ */
+#define AQ_ANNEAL_SECONDS 1.0
+
+/**
+ * Temperatures at the start and at the end of the schedule, which cools
+ * geometrically over the time given.
+ */
+#define AQ_ANNEAL_START_TEMPERATURE 2.0
+#define AQ_ANNEAL_END_TEMPERATURE 0.05
+
+/**
+ * Cost of one attack too many or too few on a queen, against the gain of one
+ * queen.
+ */
+#define AQ_ANNEAL_PENALTY 2
+
+/**
+ * Number of steps between two looks at the clock.
+ */
+#define AQ_ANNEAL_CHECK_INTERVAL 256
+
+/**
+ * Function prototypes.
+ */
+int anneal_run(int size, int k, int wrap, double seconds, uint64_t seed,
+        struct aq_board *best);
+
+#endif /* AQ_ANNEAL_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,1196 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * The Aggressive Queens solver library.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "aq.h"
+#include "batch.h"
+#include "move.h"
+#include "perf.h"
+#include "symmetry.h"
+#include "trace.h"
+
+extern uint64_t aq_random(uint64_t*);
+
+/**
+ * Returns an upper bound on the number of queens in a solution.
+ *
+ * A queen sees at most one other queen on either side of its row, so with
+ * k < 2 no row can hold more than k + 1 queens.
+ *
+ * On a normal board, m queens on a line see each other in m - 1 pairs, and
+ * each pair makes two attacks. Over the rows, columns and diagonals, which
+ * number 6N - 2, q queens thus make at least 2 (4q - 6N + 2) attacks, and at
+ * most kq, so q is at most (12N - 4) / (8 - k).
+ */
+int aq_upper_bound(const struct aq_params *params) {
+    int bound = params->N * params->N;
+
+    if (params->k < 2) {
+        bound = (params->k + 1) * params->N;
+    }
+
+    if (!params->w && params->k < 8 &&
+        (12 * params->N - 4) / (8 - params->k) < bound) {
+        bound = (12 * params->N - 4) / (8 - params->k);
+    }
+
+    return bound;
+}
+
+/**
+ * Names of the move ordering policies, indexed by enum aq_order.
+ */
+static const char *AQ_ORDER_NAMES[AQ_NUM_ORDERS] = {
+    "row-major",
+    "constrained",
+    "fewest-attacks",
+    "center"
+};
+
+/**
+ * Returns the name of a move ordering policy.
+ */
+const char *aq_order_name(int order) {
+    return order >= 0 && order < AQ_NUM_ORDERS ? AQ_ORDER_NAMES[order] : NULL;
+}
+
+/**
+ * Returns the move ordering policy with the given name, or -1.
+ */
+int aq_order_from_name(const char *name) {
+    for (int order = 0; order < AQ_NUM_ORDERS; ++order) {
+        if (!strcmp(name, AQ_ORDER_NAMES[order])) {
+            return order;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Checks if a queen can be placed on a position without any queen being
+ * attacked more than k times.
+ */
+static inline
+int aq_is_candidate(const struct aq_params *params, struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
+    int num_attacks = params->w ?
+        board_cell_count_attacks_wrap(board, geometry, row, col) :
+        board_cell_count_attacks(board, geometry, row, col);
+
+    return num_attacks != -1 && num_attacks <= params->k &&
+        (params->w ?
+            board_simulate_max_attacks_wrap(board, geometry, row, col) :
+            board_simulate_max_attacks(board, geometry, row, col)) <=
+        params->k;
+}
+
+/**
+ * Returns how promising a move is under the ordering policy of a search, from
+ * the attacks on every cell on a normal board. Moves with a higher priority
+ * are tried first.
+ *
+ * A new queen is attacked by the queens it sees, and in turn attacks those of
+ * them that saw nothing on its other side. On a wrap-around board, where the
+ * rays of a queen may meet again, both are taken to be the number of attacks
+ * on the cell.
+ */
+static inline
+int aq_move_priority(const struct aq_params *params,
+        struct aq_planes_geometry *geometry, struct aq_board *board,
+        struct aq_planes_attacks *attacks, struct aq_move *move) {
+    int row = move->row;
+    int col = move->col;
+    int num_attacks = 0;
+    int dr;
+    int dc;
+
+    switch (params->order) {
+    case AQ_ORDER_CONSTRAINED:
+        return params->w ?
+            board_cell_count_attacks_wrap(board, &geometry->board, row, col) :
+            planes_get(&attacks->counters, row, col, geometry);
+    case AQ_ORDER_FEWEST_ATTACKS:
+        if (params->w) {
+            return -2 * board_cell_count_attacks_wrap(board, &geometry->board,
+                    row, col);
+        }
+
+        for (int d = 0; d < 8; ++d) {
+            if (board_is_occupied(&attacks->seen[d], &geometry->board, row,
+                    col)) {
+                num_attacks += board_is_occupied(&attacks->seen[7 - d],
+                        &geometry->board, row, col) ? 1 : 2;
+            }
+        }
+
+        return -num_attacks;
+    case AQ_ORDER_CENTER:
+        dr = 2 * row - (params->N - 1);
+        dc = 2 * col - (params->N - 1);
+        return -(dr * dr + dc * dc);
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Sorts moves by increasing priority, keeping the order of moves with the
+ * same priority. The stack pops the last move pushed first, so this puts
+ * the most promising move on top.
+ */
+static inline
+void aq_order_moves(const struct aq_params *params,
+        struct aq_planes_geometry *geometry, struct aq_board *board,
+        struct aq_planes_attacks *attacks, struct aq_move *moves,
+        int num_moves) {
+    int priorities[AQ_MAX_MOVES];
+    struct aq_move move;
+    int priority;
+    int j;
+
+    for (int i = 0; i < num_moves; ++i) {
+        move = moves[i];
+        priority = aq_move_priority(params, geometry, board, attacks, &move);
+        for (j = i; j > 0 && priorities[j - 1] > priority; --j) {
+            moves[j] = moves[j - 1];
+            priorities[j] = priorities[j - 1];
+        }
+
+        moves[j] = move;
+        priorities[j] = priority;
+    }
+}
+
+/**
+ * Generates the moves that may follow a move, in the order in which they are
+ * pushed onto the task stack. Returns the number of moves.
+ *
+ * num_candidates is set to the number of cells that could still receive a
+ * queen somewhere below this move.
+ *
+ * On a normal board, the legal cells are found for the whole board at once
+ * with planes_candidates, unless the caller has already done so and passes
+ * them as legal along with the attacks they were found from. Rays on a
+ * wrap-around board do not end at the edges, so there attacks and legal are
+ * ignored, and the cells are checked by batch_simulate instead.
+ *
+ * The moves are ordered by the policy of the search.
+ */
+static inline
+int aq_generate_moves(const struct aq_params *params,
+        struct aq_planes_geometry *geometry, struct aq_board *board,
+        struct aq_planes_attacks *attacks, struct aq_board *legal,
+        struct aq_move *move, struct aq_move *moves, int *num_candidates) {
+    int num_moves = 0;
+    struct aq_planes_attacks board_attacks;
+    struct aq_board candidates;
+    struct aq_batch_parent parent;
+    int rows[AQ_MAX_MOVES];
+    int cols[AQ_MAX_MOVES];
+    int cell_attacks[AQ_MAX_MOVES];
+    int max_attacks[AQ_MAX_MOVES];
+    int same[AQ_MAX_MOVES];
+    int num_cells = 0;
+
+    if (!params->w && legal == NULL) {
+        planes_attacks(board, geometry, &board_attacks);
+        candidates = planes_candidates(board, params->k, geometry,
+                &board_attacks);
+        attacks = &board_attacks;
+        legal = &candidates;
+    }
+
+    *num_candidates = 0;
+    for (int i = 0; i < params->N; ++i) {
+        for (int j = 0; j < params->N; ++j) {
+            // Cells sharing a row or column with this move are only placed
+            // further down, but still count towards the number of queens this
+            // branch could reach.
+            if ((move->row == i || move->col == j) &&
+                !board_is_occupied(board, &geometry->board, i, j)) {
+                (*num_candidates)++;
+            }
+
+            if (move->row == i || move->col == j ||
+                board_is_occupied(board, &geometry->board, i, j)) {
+                continue;
+            }
+
+            // On a wrap-around board, only the cells whose own queen would
+            // not be attacked too often are left for the batch.
+            if (params->w) {
+                cell_attacks[num_cells] = board_cell_count_attacks_wrap(board,
+                        &geometry->board, i, j);
+                if (cell_attacks[num_cells] <= params->k) {
+                    rows[num_cells] = i;
+                    cols[num_cells] = j;
+                    num_cells++;
+                }
+            } else if (board_is_occupied(legal, &geometry->board, i, j)) {
+                (*num_candidates)++;
+
+                moves[num_moves].row = i;
+                moves[num_moves].col = j;
+                moves[num_moves].applied = 0;
+                moves[num_moves].depth = move->depth + 1;
+                num_moves++;
+            }
+        }
+    }
+
+    if (num_cells > 0) {
+        PERF_PHASE(SIMULATE);
+        batch_parent_init(&parent, board, &geometry->board, 1);
+        batch_simulate(&parent, rows, cols, cell_attacks, num_cells,
+                max_attacks, same);
+        PERF_PHASE(MOVES);
+        for (int i = 0; i < num_cells; ++i) {
+            if (max_attacks[i] > params->k) {
+                continue;
+            }
+
+            (*num_candidates)++;
+
+            moves[num_moves].row = rows[i];
+            moves[num_moves].col = cols[i];
+            moves[num_moves].applied = 0;
+            moves[num_moves].depth = move->depth + 1;
+            num_moves++;
+        }
+    }
+
+    if (params->order != AQ_ORDER_ROW_MAJOR) {
+        aq_order_moves(params, geometry, board, attacks, moves, num_moves);
+    }
+
+    return num_moves;
+}
+
+/**
+ * Returns the number of tasks the search is split into.
+ *
+ * On a normal board, each task starts from one cell of one half of the
+ * board. On a wrap-around board every configuration can be translated so
+ * that one of its queens sits at (0, 0), so every task starts from that
+ * single move, and owns one of its children instead. A root without
+ * children still makes one task, so that the lone queen is a solution.
+ */
+int aq_num_tasks(const struct aq_params *params) {
+    int num_tasks = 0;
+
+    if (!params->w) {
+        return params->N * (params->N + 1) / 2;
+    }
+
+    struct aq_geometry geometry;
+    board_geometry_init(&geometry, params->N);
+
+    struct aq_board board = board_new();
+    board_set_occupied(&board, &geometry, 0, 0);
+    for (int i = 1; i < params->N; ++i) {
+        for (int j = 1; j < params->N; ++j) {
+            if (aq_is_candidate(params, &board, &geometry, i, j)) {
+                num_tasks++;
+            }
+        }
+    }
+
+    return num_tasks ? num_tasks : 1;
+}
+
+/**
+ * Returns the number of values of k a search solves for.
+ */
+int aq_num_k(const struct aq_params *params) {
+    if (!params->multi) {
+        return 1;
+    }
+
+    return params->k < AQ_MAX_ATTACKS ? params->k + 1 : AQ_MAX_ATTACKS + 1;
+}
+
+/**
+ * Initializes a context for a search.
+ */
+void aq_context_init(struct aq_context *ctx, const struct aq_params *params,
+        const struct aq_callbacks *callbacks) {
+    ctx->params = *params;
+    if (callbacks) {
+        ctx->callbacks = *callbacks;
+    } else {
+        ctx->callbacks.solution = NULL;
+        ctx->callbacks.progress = NULL;
+        ctx->callbacks.next_task = NULL;
+        ctx->callbacks.progress_interval = 0;
+        ctx->callbacks.user = NULL;
+    }
+
+    if (ctx->callbacks.progress_interval <= 0) {
+        ctx->callbacks.progress_interval = AQ_PROGRESS_INTERVAL;
+    }
+
+    // Use a simple integer for the board - we abuse the bits for queen
+    // positioning.
+    planes_geometry_init(&ctx->geometry, params->N);
+    ctx->board = board_new();
+    ctx->stack = stack_new();
+    ctx->stack_applied = stack_new();
+    store_init(&ctx->store, params->N, 0);
+    ctx->solutions = &ctx->store;
+    ctx->num_k = aq_num_k(params);
+    for (int i = 0; i < ctx->num_k; ++i) {
+        ctx->max_queens[i] = 0;
+        ctx->open_bound[i] = 0;
+    }
+
+    ctx->threshold = 0;
+    ctx->nodes = 0;
+    ctx->tasks_remaining = -1;
+    ctx->found = 0;
+    ctx->stopped = 0;
+    ctx->error = 0;
+    ctx->frontier = 0;
+}
+
+/**
+ * Releases the resources held by a context.
+ */
+void aq_context_free(struct aq_context *ctx) {
+    store_free(&ctx->store);
+}
+
+/**
+ * Returns the first move of a task.
+ */
+static inline
+struct aq_move aq_task_move(const struct aq_params *params, int task) {
+    struct aq_move initial_move;
+    int N = params->N;
+
+    initial_move.row = 0;
+    initial_move.col = 0;
+    initial_move.applied = 0;
+    initial_move.depth = 0;
+
+    // Optimization: we only need to find one half the board.
+    if (!params->w) {
+        for (int i = 0; i < N; ++i) {
+            if (task < N - i) {
+                initial_move.row = i;
+                initial_move.col = task;
+                break;
+            }
+
+            task -= N - i;
+        }
+    }
+
+    return initial_move;
+}
+
+/**
+ * Returns the upper bound of a search on the number of queens in a solution
+ * for k, if it is less than bound, and bound otherwise.
+ */
+static inline
+int aq_clamp_bound(const struct aq_params *params, int k, int bound) {
+    struct aq_params params_k = *params;
+
+    params_k.k = k;
+    return bound < aq_upper_bound(&params_k) ? bound :
+        aq_upper_bound(&params_k);
+}
+
+/**
+ * Returns the number of free cells of a board that could still take a queen
+ * for k.
+ */
+static inline
+int aq_count_candidates(const struct aq_params *params, int k,
+        struct aq_board *board, const struct aq_geometry *geometry) {
+    struct aq_params params_k = *params;
+    int num_candidates = 0;
+
+    params_k.k = k;
+    for (int i = 0; i < params->N; ++i) {
+        for (int j = 0; j < params->N; ++j) {
+            num_candidates += !board_is_occupied(board, geometry, i, j) &&
+                aq_is_candidate(&params_k, board, geometry, i, j);
+        }
+    }
+
+    return num_candidates;
+}
+
+/**
+ * Fills bounds with an upper bound on the number of queens in any solution
+ * in the subtree of a task, for each k solved for: the queens of its root,
+ * plus every cell that could still take one. Attacks only grow as queens are
+ * added, so no other cell ever will.
+ */
+void aq_task_bound(const struct aq_params *params, int task, int *bounds) {
+    struct aq_move moves[AQ_MAX_MOVES];
+    struct aq_move move = aq_task_move(params, task);
+    struct aq_planes_geometry geometry;
+    struct aq_board board;
+    int num_queens = 1;
+    int num_candidates;
+    int num_moves;
+    int k;
+
+    planes_geometry_init(&geometry, params->N);
+    board = board_new();
+    board_set_occupied(&board, &geometry.board, move.row, move.col);
+
+    // On a wrap-around board, the task only owns one child of the root.
+    if (params->w) {
+        num_moves = aq_generate_moves(params, &geometry, &board, NULL, NULL,
+                &move, moves, &num_candidates);
+        if (task >= num_moves) {
+            for (int i = 0; i < aq_num_k(params); ++i) {
+                bounds[i] = 0;
+            }
+
+            return;
+        }
+
+        board_set_occupied(&board, &geometry.board, moves[task].row,
+                moves[task].col);
+        num_queens++;
+    }
+
+    for (int i = 0; i < aq_num_k(params); ++i) {
+        k = params->multi ? i : params->k;
+        bounds[i] = aq_clamp_bound(params, k, num_queens +
+                aq_count_candidates(params, k, &board, &geometry.board));
+    }
+}
+
+/**
+ * Estimates the number of nodes in the subtree of a task.
+ *
+ * Each probe walks down a random path, choosing uniformly between the moves
+ * generated at every node, and estimates the subtree size as the sum of the
+ * products of the branching factors seen so far.
+ */
+double aq_estimate_task(const struct aq_params *params, int task,
+        int num_probes) {
+    struct aq_move moves[AQ_MAX_MOVES];
+    struct aq_move move;
+    struct aq_board board;
+    struct aq_planes_geometry geometry;
+    int num_moves;
+    int num_candidates;
+    double weight;
+    double estimate;
+    double total = 0;
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (uint64_t) (task + 1);
+
+    planes_geometry_init(&geometry, params->N);
+
+    for (int probe = 0; probe < num_probes; ++probe) {
+        board = board_new();
+        move = aq_task_move(params, task);
+        board_set_occupied(&board, &geometry.board, move.row, move.col);
+        weight = 1;
+        estimate = 1;
+
+        // On a wrap-around board, the task only owns one child of the root.
+        if (params->w) {
+            num_moves = aq_generate_moves(params, &geometry, &board, NULL,
+                    NULL, &move, moves, &num_candidates);
+            if (task >= num_moves) {
+                total += estimate;
+                continue;
+            }
+
+            move = moves[task];
+            board_set_occupied(&board, &geometry.board, move.row, move.col);
+            estimate++;
+        }
+
+        for (;;) {
+            num_moves = aq_generate_moves(params, &geometry, &board, NULL,
+                    NULL, &move, moves, &num_candidates);
+            if (!num_moves) {
+                break;
+            }
+
+            weight *= num_moves;
+            estimate += weight;
+            move = moves[aq_random(&state) % num_moves];
+            board_set_occupied(&board, &geometry.board, move.row, move.col);
+        }
+
+        total += estimate;
+    }
+
+    return num_probes > 0 ? total / num_probes : 1;
+}
+
+/**
+ * The estimated cost of a task, for sorting.
+ */
+struct aq_task_cost {
+    double cost;
+    int task;
+};
+
+/**
+ * Orders tasks from the most to the least expensive, breaking ties by task.
+ */
+static
+int aq_task_cost_compare(const void *p1, const void *p2) {
+    const struct aq_task_cost *c1 = p1;
+    const struct aq_task_cost *c2 = p2;
+
+    if (c1->cost != c2->cost) {
+        return c1->cost < c2->cost ? 1 : -1;
+    }
+
+    return c1->task - c2->task;
+}
+
+/**
+ * Assigns every task to an instance.
+ */
+void aq_assign_tasks(const struct aq_params *params, int num_tasks,
+        int *owners) {
+    struct aq_task_cost *costs = NULL;
+    double *loads = NULL;
+
+    if (params->balance) {
+        costs = malloc(num_tasks * sizeof(struct aq_task_cost));
+        loads = calloc(params->nprocs, sizeof(double));
+    }
+
+    // Fall back to round-robin if we cannot balance.
+    if (costs == NULL || loads == NULL) {
+        for (int task = 0; task < num_tasks; ++task) {
+            owners[task] = task % params->nprocs;
+        }
+
+        free(costs);
+        free(loads);
+        return;
+    }
+
+    for (int task = 0; task < num_tasks; ++task) {
+        costs[task].cost = aq_estimate_task(params, task, params->balance);
+        costs[task].task = task;
+    }
+
+    qsort(costs, num_tasks, sizeof(struct aq_task_cost), aq_task_cost_compare);
+
+    for (int i = 0; i < num_tasks; ++i) {
+        int owner = 0;
+        for (int rank = 1; rank < params->nprocs; ++rank) {
+            if (loads[rank] < loads[owner]) {
+                owner = rank;
+            }
+        }
+
+        owners[costs[i].task] = owner;
+        loads[owner] += costs[i].cost;
+        TRACE_INFO(TASK_ASSIGN, costs[i].task,
+                costs[i].cost < INT32_MAX ? costs[i].cost : INT32_MAX, owner);
+    }
+
+    free(costs);
+    free(loads);
+}
+
+/**
+ * Returns the index of the k a board with the given maximum number of
+ * attacks is a solution for, or -1 if that k is not solved for.
+ */
+static inline
+int aq_solution_index(struct aq_context *ctx, int max_attacks) {
+    if (!ctx->params.multi) {
+        return max_attacks == ctx->params.k ? 0 : -1;
+    }
+
+    return max_attacks < ctx->num_k ? max_attacks : -1;
+}
+
+/**
+ * Records a solution for the index-th k, keeping only those with the most
+ * queens.
+ */
+static inline
+void aq_add_solution(struct aq_context *ctx, int index, int num_queens) {
+    struct aq_board solution;
+    struct aq_store *solutions = &ctx->solutions[index];
+
+    // On a wrap-around board, only the lexicographically smallest image
+    // under translations and rotations is kept.
+    solution = ctx->params.w ?
+        symmetry_canonical(&ctx->board, &ctx->geometry.board, 1) :
+        ctx->board;
+    if (num_queens > ctx->max_queens[index]) {
+        store_clear(solutions);
+        ctx->max_queens[index] = num_queens;
+
+        ctx->threshold = ctx->max_queens[0];
+        for (int i = 1; i < ctx->num_k; ++i) {
+            if (ctx->max_queens[i] < ctx->threshold) {
+                ctx->threshold = ctx->max_queens[i];
+            }
+        }
+    }
+
+    // The store drops duplicates itself.
+    if (store_insert(solutions, &solution) == -1) {
+        ctx->error = errno;
+        ctx->stopped = 1;
+        return;
+    }
+
+    if (ctx->params.target) {
+        ctx->found = 1;
+        ctx->stopped = 1;
+        if (ctx->callbacks.solution) {
+            ctx->callbacks.solution(ctx->callbacks.user, &solution,
+                    num_queens);
+        }
+    }
+}
+
+/**
+ * Finds the values of k the subtree below a board can still solve for in
+ * multi mode, and sets legal to the cells a queen may go on for any of them.
+ * Returns the least maximum found so far among those k, or -1 if none is
+ * left.
+ *
+ * A k is dead once a queen is attacked more than k times, or can no longer
+ * reach k, or, if bound is set, once the queens and candidates left fall
+ * short of the maximum already found for it. A wrap-around board only drops
+ * the k below the attacks a queen already receives.
+ */
+static inline
+int aq_viable_threshold(struct aq_context *ctx, struct aq_board *board,
+        struct aq_planes_attacks *attacks, struct aq_move *move,
+        int num_queens, int bound, struct aq_board *legal) {
+    const struct aq_geometry *geometry = &ctx->geometry.board;
+    struct aq_board candidates;
+    struct aq_board line;
+    struct aq_board reachable;
+    struct aq_board above;
+    struct aq_board equal;
+    int threshold = -1;
+
+    if (ctx->params.w) {
+        for (int k = board_max_attacks_wrap(board, geometry);
+             k < ctx->num_k; ++k) {
+            if (threshold == -1 || ctx->max_queens[k] < threshold) {
+                threshold = ctx->max_queens[k];
+            }
+        }
+
+        return threshold;
+    }
+
+    // The free cells sharing a row or column with the move count as
+    // candidates whatever their attacks, as in aq_generate_moves.
+    line = board_new();
+    board_set_row_occupied(&line, geometry, move->row);
+    board_set_col_occupied(&line, geometry, move->col);
+    for (int i = 0; i < geometry->slices_occupied; ++i) {
+        line.slices[i] &= ~board->slices[i];
+    }
+
+    *legal = board_new();
+
+    // A queen attacked more than k times is attacked more than any smaller
+    // k, so the search stops at the first such k.
+    for (int k = ctx->num_k - 1; k >= 0; --k) {
+        planes_compare(&attacks->counters, k, &above, &equal, &ctx->geometry);
+        for (int i = 0; i < geometry->slices_occupied; ++i) {
+            if (above.slices[i] & board->slices[i]) {
+                return threshold;
+            }
+        }
+
+        candidates = planes_candidates(board, k, &ctx->geometry, attacks);
+        if (!planes_can_reach(board, k, &ctx->geometry, attacks,
+                &candidates)) {
+            continue;
+        }
+
+        reachable = candidates;
+        for (int i = 0; i < geometry->slices_occupied; ++i) {
+            reachable.slices[i] |= line.slices[i];
+        }
+
+        if (bound && num_queens + board_count_occupied(&reachable, geometry) <
+            ctx->max_queens[k]) {
+            continue;
+        }
+
+        for (int i = 0; i < geometry->slices_occupied; ++i) {
+            legal->slices[i] |= candidates.slices[i];
+        }
+
+        if (threshold == -1 || ctx->max_queens[k] < threshold) {
+            threshold = ctx->max_queens[k];
+        }
+    }
+
+    return threshold;
+}
+
+/**
+ * Fills bounds with an upper bound on the number of queens in any solution in
+ * the subtree of a board, for each k solved for: its queens, plus every cell
+ * that could still take one, or zero if no queen can reach k. Attacks only
+ * grow as queens are added, so no other cell ever will.
+ */
+static inline
+void aq_board_bound(struct aq_context *ctx, struct aq_board *board,
+        int *bounds) {
+    const struct aq_params *params = &ctx->params;
+    const struct aq_geometry *geometry = &ctx->geometry.board;
+    struct aq_planes_attacks attacks;
+    struct aq_board candidates;
+    int num_queens = board_count_occupied(board, geometry);
+    int bound;
+    int k;
+
+    if (!params->w) {
+        planes_attacks(board, &ctx->geometry, &attacks);
+    }
+
+    for (int i = 0; i < ctx->num_k; ++i) {
+        k = params->multi ? i : params->k;
+        if (params->w) {
+            bound = num_queens + aq_count_candidates(params, k, board,
+                    geometry);
+        } else {
+            candidates = planes_candidates(board, k, &ctx->geometry,
+                    &attacks);
+            bound = planes_can_reach(board, k, &ctx->geometry, &attacks,
+                    &candidates) ?
+                num_queens + board_count_occupied(&candidates, geometry) : 0;
+        }
+
+        bounds[i] = aq_clamp_bound(params, k, bound);
+    }
+}
+
+/**
+ * Accounts for the moves a stopped search leaves on its stack.
+ *
+ * Every move waiting on the stack follows the moves applied so far up to the
+ * depth before its own, so its board is those queens and its own. Nodes cut
+ * or finished already cannot beat the maximum found.
+ */
+static inline
+void aq_leave_stack(struct aq_context *ctx) {
+    struct aq_stack *stack = &ctx->stack;
+    struct aq_stack *stack_applied = &ctx->stack_applied;
+    const struct aq_geometry *geometry = &ctx->geometry.board;
+    struct aq_move *move;
+    struct aq_move *applied;
+    struct aq_board board;
+    int bounds[AQ_MAX_ATTACKS + 1];
+
+    if (ctx->params.target) {
+        return;
+    }
+
+    for (int i = 0; i < stack_count(stack); ++i) {
+        move = &stack->stack[i];
+        board = board_new();
+        for (int j = 0; j < stack_count(stack_applied); ++j) {
+            applied = &stack_applied->stack[j];
+            if (applied->depth < move->depth) {
+                board_set_occupied(&board, geometry, applied->row,
+                        applied->col);
+            }
+        }
+
+        board_set_occupied(&board, geometry, move->row, move->col);
+        aq_board_bound(ctx, &board, bounds);
+        for (int j = 0; j < ctx->num_k; ++j) {
+            if (bounds[j] > ctx->open_bound[j]) {
+                ctx->open_bound[j] = bounds[j];
+            }
+        }
+    }
+}
+
+/**
+ * Searches the subtree of a single task.
+ */
+void aq_search(struct aq_context *ctx, int task) {
+    const struct aq_params *params = &ctx->params;
+    struct aq_board *board = &ctx->board;
+    const struct aq_geometry *geometry = &ctx->geometry.board;
+    struct aq_stack *stack = &ctx->stack;
+    struct aq_stack *stack_applied = &ctx->stack_applied;
+    struct aq_progress progress;
+    struct aq_move move;
+    struct aq_move moves[AQ_MAX_MOVES];
+    struct aq_move* undo_move_ptr;
+    struct aq_move undo_move;
+    int num_queens = 0;
+    int num_moves = 0;
+    int moves_generated = 0;
+    int depth = 0;
+    int num_candidates = 0;
+    struct aq_planes_attacks attacks;
+    struct aq_board legal;
+    int max_attacks = 0;
+    int threshold = 0;
+    int viable = 0;
+    int index = 0;
+    int i = 0;
+
+    TRACE_INFO(TASK_START, task, ctx->tasks_remaining);
+    stack_push(stack, aq_task_move(params, task));
+
+    // Perform a depth first search.
+    while (!stack_empty(stack) && !ctx->stopped) {
+        if (ctx->callbacks.progress &&
+            ++ctx->nodes % ctx->callbacks.progress_interval == 0) {
+            progress.nodes = ctx->nodes;
+            progress.depth = depth;
+            progress.remaining = stack_count(stack);
+            progress.tasks_remaining = ctx->tasks_remaining;
+            progress.max_queens = ctx->max_queens[ctx->num_k - 1];
+            if (ctx->callbacks.progress(ctx->callbacks.user, &progress)) {
+                ctx->stopped = 1;
+                break;
+            }
+        }
+
+        move = stack_pop(stack);
+
+        // Discard impossible moves.
+        while (!stack_empty(stack_applied)) {
+            undo_move_ptr = stack_peek_ptr(stack_applied);
+            if (undo_move_ptr->depth >= move.depth) {
+                stack_pop(stack_applied);
+                move_undo(board, geometry, undo_move_ptr);
+                TRACE_DEBUG(MOVE_UNDO, undo_move_ptr->row,
+                        undo_move_ptr->col, depth);
+            } else {
+                depth--;
+                break;
+            }
+        }
+
+        // We only apply if we won't get attacked.
+        TRACE_DEBUG(MOVE_APPLY, move.row, move.col, move.depth);
+        move_apply(board, geometry, &move, move.depth);
+        stack_push(stack_applied, move);
+        depth = move.depth;
+
+        // On a normal board, the attacks on every cell serve both the check
+        // for a solution and the generation of moves.
+        if (!params->w) {
+            PERF_PHASE(SIMULATE);
+            planes_attacks(board, &ctx->geometry, &attacks);
+        }
+
+        // Accumate solutions. The maximum number of attacks tells which k
+        // the board can be a solution for.
+        PERF_PHASE(SOLUTIONS);
+        num_queens = board_count_occupied(board, geometry);
+        if (num_queens >= (params->target ? params->target : ctx->threshold)) {
+            max_attacks = params->w ?
+                board_max_attacks_wrap(board, geometry) :
+                planes_uniform_attacks(board, &ctx->geometry, &attacks);
+            index = max_attacks == -1 ? -1 :
+                                        aq_solution_index(ctx, max_attacks);
+            if (index != -1 &&
+                num_queens >= (params->target ? params->target :
+                                                ctx->max_queens[index]) &&
+                (!params->w ||
+                 board_all_has_same_attacks_wrap(board, geometry))) {
+                TRACE_DEBUG(SOLUTION, num_queens, index, depth);
+                aq_add_solution(ctx, index, num_queens);
+                if (ctx->stopped) {
+                    break;
+                }
+            }
+        }
+
+        // Generate moves.
+        //
+        // Solutions need every queen attacked exactly k times and queens are
+        // never taken back, so a queen that can no longer reach k dooms the
+        // whole branch. In multi mode the branch lives on as long as any k
+        // does, and only the maxima of the live k bound it.
+        PERF_PHASE(MOVES);
+        moves_generated = 0;
+        num_moves = 0;
+        threshold = params->target ? params->target : ctx->threshold;
+        if (params->multi) {
+            threshold = aq_viable_threshold(ctx, board, &attacks, &move,
+                    num_queens, depth + 1 >= params->split_depth, &legal);
+            viable = threshold != -1;
+        } else if (!params->w) {
+            legal = planes_candidates(board, params->k, &ctx->geometry,
+                    &attacks);
+            viable = planes_can_reach(board, params->k, &ctx->geometry,
+                    &attacks, &legal);
+        } else {
+            viable = 1;
+        }
+
+        if (viable) {
+            num_moves = aq_generate_moves(params, &ctx->geometry, board,
+                    &attacks, params->w ? NULL : &legal, &move, moves,
+                    &num_candidates);
+        }
+
+        PERF_PHASE(OTHER);
+        for (i = 0; i < num_moves; ++i) {
+            // On a wrap-around board, the task owns just one child of the
+            // shared root.
+            if (params->w && depth == 0 && i != task) {
+                continue;
+            }
+
+            // Below the split depth, only the nodes of this instance's
+            // share are searched.
+            if (params->split_depth && depth + 1 == params->split_depth &&
+                ctx->frontier++ % params->nprocs != params->rank) {
+                continue;
+            }
+
+            moves[i].depth = depth + 1;
+            TRACE_DEBUG(MOVE_GENERATE, moves[i].row, moves[i].col,
+                    moves[i].depth);
+            stack_push(stack, moves[i]);
+            moves_generated++;
+        }
+
+        // Attacks on a cell never decrease as queens are added, so cells that
+        // are not candidates now never will be. If the remaining candidates
+        // cannot reach the target, or the least maximum found so far, this
+        // branch is hopeless. Above the split depth, the maximum so far
+        // differs between instances, and so would the nodes they number.
+        if (depth + 1 >= params->split_depth &&
+            num_queens + num_candidates < threshold) {
+            for (; moves_generated > 0; --moves_generated) {
+                stack_pop(stack);
+            }
+        }
+
+        // No more moves can be generated. Let's backtrack!
+        if (!moves_generated) {
+            undo_move = stack_pop(stack_applied);
+            move_undo(board, geometry, &undo_move);
+            TRACE_DEBUG(MOVE_UNDO, undo_move.row, undo_move.col, depth);
+        } else {
+            depth++;
+        }
+    }
+
+    TRACE_INFO(TASK_END, task, ctx->max_queens[ctx->num_k - 1], ctx->stopped);
+    if (ctx->stopped) {
+        aq_leave_stack(ctx);
+    }
+
+    // Leave a clean board for the next task.
+    while (!stack_empty(stack_applied)) {
+        undo_move = stack_pop(stack_applied);
+        move_undo(board, geometry, &undo_move);
+    }
+    stack_clear(stack);
+}
+
+/**
+ * Reports the solutions accumulated in a context.
+ */
+void aq_report(struct aq_context *ctx) {
+    if (!ctx->callbacks.solution || ctx->params.target) {
+        return;
+    }
+
+    for (size_t i = 0; i < store_count(ctx->solutions); ++i) {
+        struct aq_board solution = store_get(ctx->solutions, i);
+        ctx->callbacks.solution(ctx->callbacks.user, &solution,
+                ctx->max_queens[0]);
+    }
+}
+
+/**
+ * Accounts for a task that a stopped search never started.
+ */
+static inline
+void aq_leave_task(struct aq_context *ctx, int task) {
+    int bounds[AQ_MAX_ATTACKS + 1];
+
+    if (ctx->params.target) {
+        return;
+    }
+
+    aq_task_bound(&ctx->params, task, bounds);
+    for (int i = 0; i < ctx->num_k; ++i) {
+        if (bounds[i] > ctx->open_bound[i]) {
+            ctx->open_bound[i] = bounds[i];
+        }
+    }
+}
+
+/**
+ * Runs every task of this instance's share on a context. Returns 0, or -1
+ * with errno set.
+ */
+static
+int aq_run(struct aq_context *ctx) {
+    const struct aq_params *params = &ctx->params;
+
+    if (ctx->callbacks.next_task) {
+        while (!ctx->stopped) {
+            int task = ctx->callbacks.next_task(ctx->callbacks.user);
+            if (task == -1) {
+                break;
+            }
+
+            aq_search(ctx, task);
+        }
+    } else {
+        int num_tasks = aq_num_tasks(params);
+        int *owners = malloc(num_tasks * sizeof(int));
+        if (owners == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        aq_assign_tasks(params, num_tasks, owners);
+
+        // With a split depth, every instance runs every task.
+        ctx->tasks_remaining = 0;
+        for (int task = 0; task < num_tasks; ++task) {
+            if (params->split_depth) {
+                owners[task] = params->rank;
+            }
+
+            ctx->tasks_remaining += owners[task] == params->rank;
+        }
+
+        // Tasks are taken from the last so that the search visits them in the
+        // same order as a single stack seeded with all of them.
+        for (int task = num_tasks - 1; task >= 0; --task) {
+            if (owners[task] != params->rank) {
+                continue;
+            }
+
+            if (ctx->stopped) {
+                aq_leave_task(ctx, task);
+            } else {
+                aq_search(ctx, task);
+                ctx->tasks_remaining--;
+            }
+        }
+
+        free(owners);
+    }
+
+    if (ctx->error) {
+        errno = ctx->error;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Runs a complete search over this instance's share of the tasks.
+ */
+int aq_solve(const struct aq_params *params,
+        const struct aq_callbacks *callbacks) {
+    int result;
+    struct aq_context *ctx;
+
+    if (params->multi) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx = malloc(sizeof(struct aq_context));
+    if (ctx == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    aq_context_init(ctx, params, callbacks);
+
+    result = aq_run(ctx);
+    if (result != -1) {
+        aq_report(ctx);
+        result = params->target && !ctx->found ? 0 : ctx->max_queens[0];
+    }
+
+    aq_context_free(ctx);
+    free(ctx);
+    return result;
+}
+
+/**
+ * Runs a complete search, leaving the solutions in a store.
+ */
+int aq_solve_store(const struct aq_params *params,
+        const struct aq_callbacks *callbacks, struct aq_store *solutions) {
+    struct aq_params single = *params;
+    int max_queens = 0;
+
+    single.multi = 0;
+    if (aq_solve_multi(&single, callbacks, solutions, &max_queens,
+                NULL) == -1) {
+        return -1;
+    }
+
+    return max_queens;
+}
+
+/**
+ * Runs a complete search in multi mode.
+ */
+int aq_solve_multi(const struct aq_params *params,
+        const struct aq_callbacks *callbacks, struct aq_store *solutions,
+        int *max_queens, int *open_bound) {
+    int result;
+    struct aq_context *ctx = malloc(sizeof(struct aq_context));
+    if (ctx == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    aq_context_init(ctx, params, callbacks);
+    ctx->solutions = solutions;
+    for (int i = 0; i < ctx->num_k; ++i) {
+        ctx->max_queens[i] = max_queens[i];
+        if (i == 0 || max_queens[i] < ctx->threshold) {
+            ctx->threshold = max_queens[i];
+        }
+    }
+
+    result = aq_run(ctx);
+    for (int i = 0; i < ctx->num_k && result != -1; ++i) {
+        max_queens[i] = params->target && !ctx->found ? 0 :
+                                                        ctx->max_queens[i];
+    }
+
+    for (int i = 0; i < ctx->num_k && open_bound; ++i) {
+        open_bound[i] = ctx->open_bound[i];
+    }
+
+    aq_context_free(ctx);
+    free(ctx);
+    return result;
+}
+
+/* vim: set ts=4 sw=4 et: */
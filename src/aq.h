@@ -0,0 +1,313 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * The Aggressive Queens solver library.
+ *
+ * The solver holds no global state: every call to aq_solve works on its own
+ * context, so any number of instances may run in the same process. It does
+ * not know about MPI either. A driver that splits the work between processes
+ * tells each instance which share of the tasks it owns, and combines the
+ * solutions reported back through the callbacks.
+ *
+ * The one exception is tracing (see trace.h). Its trace points record into
+ * a single ring buffer of the process, so that the handlers trace_open
+ * installs for SIGUSR1 and fatal signals can dump it. The ring only holds
+ * diagnostics, and never changes what an instance computes. Instances that
+ * run at once share it, and tell their events apart by trace_thread. The
+ * performance counters of perf.h are diagnostics of the same kind, kept per
+ * thread rather than per process.
+ */
+
+#ifndef AQ_AQ_H_
+#define AQ_AQ_H_
+
+#include "board.h"
+#include "planes.h"
+#include "stack.h"
+#include "store.h"
+
+/**
+ * Maximum number of moves that can follow a move.
+ */
+#define AQ_MAX_MOVES (AQ_BOARD_SLICES * 64)
+
+/**
+ * A queen attacks at most one other queen in each of the eight directions.
+ */
+#define AQ_MAX_ATTACKS 8
+
+/**
+ * Default number of nodes between two progress callbacks.
+ */
+#define AQ_PROGRESS_INTERVAL 1024
+
+/**
+ * Default number of random probes per task when estimating its cost.
+ */
+#define AQ_ESTIMATE_PROBES 32
+
+/**
+ * Orders in which the moves following a move are tried.
+ *
+ * AQ_ORDER_ROW_MAJOR tries the cells from the bottom-right up, which is the
+ * order in which they are generated. The other policies first try the cell
+ * that already receives the most attacks, and would be the first to become
+ * illegal (AQ_ORDER_CONSTRAINED), the cell that adds the fewest attacks to
+ * the board (AQ_ORDER_FEWEST_ATTACKS), or the cell nearest to the centre of
+ * the board (AQ_ORDER_CENTER). Ties are broken in row-major order.
+ */
+enum aq_order {
+    AQ_ORDER_ROW_MAJOR,
+    AQ_ORDER_CONSTRAINED,
+    AQ_ORDER_FEWEST_ATTACKS,
+    AQ_ORDER_CENTER,
+    AQ_NUM_ORDERS
+};
+
+/**
+ * Parameters of a single search.
+ *
+ * N, k and w have the same meaning as for findAQ. If target is non-zero, the
+ * search stops as soon as it finds a solution with at least target queens.
+ * The tasks of the search are shared between nprocs instances, of which this
+ * is the rank-th. They are dealt out round-robin, unless balance is non-zero,
+ * in which case the cost of every task is estimated with balance random
+ * probes and the tasks are packed by cost instead.
+ *
+ * If multi is non-zero, every k from 0 to params->k is solved by the same
+ * search. Legality is monotone in k, so the tree pruned at the largest k
+ * contains the tree of every smaller k.
+ *
+ * order is the enum aq_order policy for trying moves. It does not change
+ * the tree that is searched, only how early good boards are reached, which
+ * matters whenever a search stops before exhausting it.
+ *
+ * If split_depth is non-zero, the tasks are not shared out at all. Every
+ * instance walks every task down to depth split_depth instead, numbering the
+ * nodes it reaches there in the order of the search, and only goes on below
+ * those whose number is its rank modulo nprocs. Nothing is cut above that
+ * depth, so every instance numbers the same nodes. This splits the search
+ * into far more pieces than there are tasks, at the cost of each instance
+ * repeating the shallow part of the tree.
+ */
+struct aq_params {
+    int N;
+    int k;
+    int w;
+    int target;
+    int rank;
+    int nprocs;
+    int balance;
+    int multi;
+    int order;
+    int split_depth;
+};
+
+/**
+ * A snapshot of the progress of a search.
+ *
+ * remaining is the number of moves left on the stack of the current task,
+ * and tasks_remaining the number of tasks of this instance not finished
+ * yet, including the current one. tasks_remaining is -1 when the tasks come
+ * from next_task, since only the caller knows how many are left.
+ */
+struct aq_progress {
+    long nodes;
+    int depth;
+    int remaining;
+    int tasks_remaining;
+    int max_queens;
+};
+
+/**
+ * Callbacks through which a search reports back. Any of them may be NULL.
+ *
+ * solution is called once for every maximal solution found by this instance
+ * when aq_solve ends. In target mode, it is called for the witness as soon
+ * as it is found instead.
+ *
+ * progress is called every progress_interval nodes (AQ_PROGRESS_INTERVAL if
+ * zero). The search stops if it returns non-zero.
+ *
+ * next_task, if set, replaces the static round-robin share of tasks: the
+ * search keeps asking it for the next task to run until it returns -1. This
+ * lets several instances share a pool of tasks.
+ */
+struct aq_callbacks {
+    void (*solution)(void *user, struct aq_board *board, int num_queens);
+    int (*progress)(void *user, struct aq_progress *progress);
+    int (*next_task)(void *user);
+    int progress_interval;
+    void *user;
+};
+
+/**
+ * The state of one solver instance.
+ *
+ * Solutions are kept in the stores pointed to by solutions, one for each of
+ * the num_k values of k solved for, and max_queens holds the maximum of each.
+ * With a single k, solutions is the context's own store unless the caller
+ * provides one. threshold is the least number of queens a board needs to be
+ * a solution for some k. If a store cannot grow, the search stops and error
+ * holds the errno of the failure.
+ *
+ * If the search is stopped before it finishes its share, open_bound holds an
+ * upper bound for each k on the number of queens in any solution among the
+ * tasks it left unfinished, and zero otherwise. With a split depth, frontier counts
+ * the nodes reached at that depth so far.
+ */
+struct aq_context {
+    struct aq_params params;
+    struct aq_callbacks callbacks;
+
+    struct aq_board board;
+    struct aq_planes_geometry geometry;
+    struct aq_stack stack;
+    struct aq_stack stack_applied;
+
+    struct aq_store store;
+    struct aq_store *solutions;
+    int num_k;
+    int max_queens[AQ_MAX_ATTACKS + 1];
+    int threshold;
+
+    long nodes;
+    int tasks_remaining;
+    int found;
+    int stopped;
+    int error;
+    int open_bound[AQ_MAX_ATTACKS + 1];
+    long frontier;
+};
+
+/**
+ * Returns an upper bound on the number of queens in a solution.
+ */
+int aq_upper_bound(const struct aq_params *params);
+
+/**
+ * Fills bounds, which holds aq_num_k(params) entries, with an upper bound for
+ * each k on the number of queens in any solution in the subtree of a task.
+ */
+void aq_task_bound(const struct aq_params *params, int task, int *bounds);
+
+/**
+ * Returns the number of tasks the search is split into.
+ */
+int aq_num_tasks(const struct aq_params *params);
+
+/**
+ * Returns the name of a move ordering policy, as taken by aq_order_from_name.
+ */
+const char *aq_order_name(int order);
+
+/**
+ * Returns the move ordering policy with the given name, or -1 if there is
+ * none.
+ */
+int aq_order_from_name(const char *name);
+
+/**
+ * Returns the number of values of k a search solves for: one, or in multi
+ * mode params->k + 1. No board has a queen attacked more than
+ * AQ_MAX_ATTACKS times, so larger values of k are not searched.
+ */
+int aq_num_k(const struct aq_params *params);
+
+/**
+ * Estimates the number of nodes in the subtree of a task, by averaging the
+ * estimates of random paths down the tree (Knuth's estimator). The estimate
+ * only depends on the parameters and the task, so every instance computes
+ * the same value.
+ */
+double aq_estimate_task(const struct aq_params *params, int task,
+        int num_probes);
+
+/**
+ * Assigns every task to an instance, writing the rank of its owner to
+ * owners. With params->balance set, tasks are assigned from the most
+ * expensive to the least expensive to the least loaded instance so far
+ * (longest processing time first). Otherwise they are dealt out
+ * round-robin.
+ */
+void aq_assign_tasks(const struct aq_params *params, int num_tasks,
+        int *owners);
+
+/**
+ * Initializes a context for a search.
+ */
+void aq_context_init(struct aq_context *ctx, const struct aq_params *params,
+        const struct aq_callbacks *callbacks);
+
+/**
+ * Releases the resources held by a context.
+ */
+void aq_context_free(struct aq_context *ctx);
+
+/**
+ * Searches the subtree of a single task. May be called repeatedly on the
+ * same context; solutions accumulate across calls.
+ */
+void aq_search(struct aq_context *ctx, int task);
+
+/**
+ * Reports the solutions accumulated in a context through its solution
+ * callback.
+ */
+void aq_report(struct aq_context *ctx);
+
+/**
+ * Runs a complete search over this instance's share of the tasks.
+ *
+ * Returns the maximum number of queens found by this instance (in target
+ * mode, the number of queens in the witness, or zero if there is none), or
+ * -1 with errno set if the search could not be started. Multi mode is not
+ * supported, since solutions are reported without their k.
+ */
+int aq_solve(const struct aq_params *params,
+        const struct aq_callbacks *callbacks);
+
+/**
+ * Runs a complete search like aq_solve, but leaves the maximal solutions in
+ * a store initialized by the caller instead of reporting them. This keeps a
+ * single copy of a large solution set.
+ */
+int aq_solve_store(const struct aq_params *params,
+        const struct aq_callbacks *callbacks, struct aq_store *solutions);
+
+/**
+ * Runs a complete search in multi mode. solutions and max_queens hold
+ * aq_num_k(params) entries, one for each k from zero. Returns 0, or -1 with
+ * errno set.
+ *
+ * On entry, max_queens holds a known lower bound for every k, or zero, and
+ * the matching store any solutions already known with that many queens
+ * (from a local search, say). Branches that cannot reach the bound are cut,
+ * and the stores are only cleared once a larger solution turns up.
+ *
+ * If the search is stopped through the progress callback, open_bound (which
+ * may be NULL, or else holds aq_num_k(params) entries) receives an upper
+ * bound for each k on the number of queens of any solution left unexplored,
+ * or zero if the share was finished. Together with
+ * max_queens, this is what an anytime search has proven.
+ */
+int aq_solve_multi(const struct aq_params *params,
+        const struct aq_callbacks *callbacks, struct aq_store *solutions,
+        int *max_queens, int *open_bound);
+
+/**
+ * A small xorshift generator, so that every caller keeps its own stream in
+ * state and there is no global state.
+ */
+inline
+uint64_t aq_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+#endif /* AQ_AQ_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,132 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Expands the output of findAQ --orbits.
+ *
+ * Takes any number of files, or stdin, and prints them with every orbit line
+ * replaced by a line for each solution in the orbit, as findAQ prints them
+ * without --orbits. Every other line is printed as it is.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cli.h"
+#include "store.h"
+#include "symmetry.h"
+
+/**
+ * Prints a line to stdout, for formatSolutions.
+ */
+static
+void printLine(void *user, const char *line, int length) {
+    fwrite(line, 1, length, stdout);
+}
+
+/**
+ * Expands a single orbit line, or prints any other line as it is. Returns
+ * 0, or -1 with an error printed if an orbit line does not hold the
+ * canonical form of an orbit of the given size.
+ */
+static
+int expandLine(const char *path, long number, const char *line) {
+    struct aq_board orbit[AQ_SYMMETRY_MAX_ORBIT];
+    struct aq_board representative;
+    struct aq_geometry geometry;
+    struct program_args args;
+    struct aq_store solutions;
+    int max_queens;
+    int num_images;
+    int expected;
+    int retval = 0;
+
+    memset(&args, 0, sizeof(args));
+    if (parseOrbit(line, &representative, &args, &max_queens,
+                &expected) == -1) {
+        fputs(line, stdout);
+        return 0;
+    }
+
+    board_geometry_init(&geometry, args.N);
+    num_images = symmetry_orbit(&representative, &geometry, args.w, orbit);
+    if (num_images != expected ||
+        !boards_are_equal(&orbit[0], &representative, &geometry)) {
+        fprintf(stderr, "%s:%ld: Not the canonical form of an orbit of %d\n",
+                path, number, expected);
+        return -1;
+    }
+
+    // Solutions on a wrap-around board are expanded by formatSolutions
+    // itself.
+    args.l = 1;
+    store_init(&solutions, args.N, 0);
+    for (int i = 0; i < (args.w ? 1 : num_images); ++i) {
+        if (store_insert(&solutions, &orbit[i]) == -1) {
+            fprintf(stderr, "%s:%ld: Failed to store the orbit (errno %d)\n",
+                    path, number, errno);
+            retval = -1;
+            break;
+        }
+    }
+
+    if (retval == 0) {
+        formatSolutions(&solutions, max_queens, &args, printLine, NULL);
+    }
+
+    store_free(&solutions);
+    return retval;
+}
+
+/**
+ * Expands every line of a file. Returns 0, or -1 with an error printed.
+ */
+static
+int expandFile(const char *path, FILE *file) {
+    char line[SOLUTION_LINE_MAX];
+    long number = 0;
+    int retval = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (expandLine(path, ++number, line) == -1) {
+            retval = -1;
+        }
+    }
+
+    if (ferror(file)) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return retval;
+}
+
+int main(int argc, char *argv[]) {
+    int retval = EXIT_SUCCESS;
+    FILE *file;
+
+    if (argc < 2) {
+        return expandFile("-", stdin) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        file = fopen(argv[i], "r");
+        if (file == NULL) {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+            retval = EXIT_FAILURE;
+            continue;
+        }
+
+        if (expandFile(argv[i], file) == -1) {
+            retval = EXIT_FAILURE;
+        }
+
+        fclose(file);
+    }
+
+    return retval;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,171 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Decodes the trace files written by findAQ --trace.
+ *
+ * Takes any number of trace files, typically one per process of a run, and
+ * prints every event they hold in the order they happened, one per line:
+ *
+ *     seconds rank/thread level EVENT name=value ...
+ *
+ * where seconds count from the earliest start of a trace. Events that were
+ * overwritten in a full ring buffer are reported per file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+
+/**
+ * An event along with the process it came from and its position in the
+ * trace file.
+ */
+struct decoded_event {
+    uint64_t time;
+    int rank;
+    uint64_t sequence;
+    struct trace_record record;
+};
+
+/**
+ * Orders events by time, then as they were recorded.
+ */
+static
+int compareEvents(const void *a, const void *b) {
+    const struct decoded_event *first = a;
+    const struct decoded_event *second = b;
+
+    if (first->time != second->time) {
+        return first->time < second->time ? -1 : 1;
+    }
+
+    if (first->rank != second->rank) {
+        return first->rank - second->rank;
+    }
+
+    return first->sequence < second->sequence ? -1 :
+        first->sequence > second->sequence;
+}
+
+/**
+ * Reads the events of a trace file, appending them to events. Returns 0, or
+ * -1 with an error printed.
+ */
+static
+int readTrace(const char *path, struct trace_header *header,
+        struct decoded_event **events, size_t *num_events) {
+    struct decoded_event *grown;
+    struct trace_record record;
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (fread(header, sizeof(*header), 1, file) != 1 ||
+        memcmp(header->magic, "AQTRACE1", sizeof(header->magic))) {
+        fprintf(stderr, "%s: Not a trace file\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    grown = realloc(*events, (*num_events + header->count) *
+            sizeof(struct decoded_event));
+    if (grown == NULL) {
+        fprintf(stderr, "%s: Failed to allocate events\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    *events = grown;
+    for (uint64_t i = 0; i < header->count; ++i) {
+        if (fread(&record, sizeof(record), 1, file) != 1) {
+            fprintf(stderr, "%s: Truncated after %llu events\n", path,
+                    (unsigned long long) i);
+            break;
+        }
+
+        (*events)[*num_events].time = header->start + record.time;
+        (*events)[*num_events].rank = header->rank;
+        (*events)[*num_events].sequence = i;
+        (*events)[*num_events].record = record;
+        (*num_events)++;
+    }
+
+    if (header->lost) {
+        fprintf(stderr, "%s: %llu older events were overwritten\n", path,
+                (unsigned long long) header->lost);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Prints an event.
+ */
+static
+void printEvent(const struct decoded_event *event, uint64_t start) {
+    const struct trace_record *record = &event->record;
+    const char *names;
+    int length;
+
+    if (record->event >= TRACE_NUM_EVENTS) {
+        printf("%12.6f %d/%d ? unknown event %d\n",
+                (event->time - start) / 1e9, event->rank, record->thread,
+                record->event);
+        return;
+    }
+
+    printf("%12.6f %d/%d %-5s %s", (event->time - start) / 1e9, event->rank,
+            record->thread, record->level == AQ_TRACE_DEBUG ? "debug" : "info",
+            TRACE_EVENT_NAMES[record->event]);
+
+    names = TRACE_EVENT_ARGS[record->event];
+    for (int i = 0; i < AQ_TRACE_MAX_ARGS && *names; ++i) {
+        length = strcspn(names, " ");
+        printf(" %.*s=%d", length, names, record->args[i]);
+        names += length + (names[length] == ' ');
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct trace_header header;
+    struct decoded_event *events = NULL;
+    size_t num_events = 0;
+    uint64_t start = UINT64_MAX;
+    int retval = EXIT_SUCCESS;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (readTrace(argv[i], &header, &events, &num_events) == -1) {
+            retval = EXIT_FAILURE;
+            continue;
+        }
+
+        if (header.start < start) {
+            start = header.start;
+        }
+    }
+
+    qsort(events, num_events, sizeof(struct decoded_event), compareEvents);
+    for (size_t i = 0; i < num_events; ++i) {
+        printEvent(&events[i], start);
+    }
+
+    free(events);
+    return retval;
+}
+
+/* vim: set ts=4 sw=4 et: */
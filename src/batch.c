@@ -0,0 +1,352 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Batch evaluation of sibling candidates.
+ */
+
+#include "batch.h"
+
+#if AQ_BATCH_LANES > 1
+#include <immintrin.h>
+#endif
+
+/**
+ * One step in each of the eight directions, as rows and columns.
+ */
+static const int DIRECTIONS[8][2] = {
+    { -1, -1 }, { -1, 0 }, { -1, 1 },
+    { 0, -1 }, { 0, 1 },
+    { 1, -1 }, { 1, 0 }, { 1, 1 }
+};
+
+/**
+ * The lanes of a vector of 32-bit integers. Comparisons give -1 in the lanes
+ * where they hold and 0 elsewhere, whatever the instruction set.
+ */
+#if AQ_BATCH_LANES == 8
+
+typedef __m256i batch_vector;
+
+static inline batch_vector batch_set(int x) { return _mm256_set1_epi32(x); }
+static inline batch_vector batch_load(const int *p) {
+    return _mm256_loadu_si256((const __m256i*) p);
+}
+static inline void batch_store(int *p, batch_vector a) {
+    _mm256_storeu_si256((__m256i*) p, a);
+}
+static inline batch_vector batch_add(batch_vector a, batch_vector b) {
+    return _mm256_add_epi32(a, b);
+}
+static inline batch_vector batch_sub(batch_vector a, batch_vector b) {
+    return _mm256_sub_epi32(a, b);
+}
+static inline batch_vector batch_and(batch_vector a, batch_vector b) {
+    return _mm256_and_si256(a, b);
+}
+static inline batch_vector batch_or(batch_vector a, batch_vector b) {
+    return _mm256_or_si256(a, b);
+}
+static inline batch_vector batch_andnot(batch_vector a, batch_vector b) {
+    return _mm256_andnot_si256(a, b);
+}
+static inline batch_vector batch_eq(batch_vector a, batch_vector b) {
+    return _mm256_cmpeq_epi32(a, b);
+}
+static inline batch_vector batch_gt(batch_vector a, batch_vector b) {
+    return _mm256_cmpgt_epi32(a, b);
+}
+static inline batch_vector batch_max(batch_vector a, batch_vector b) {
+    return _mm256_max_epi32(a, b);
+}
+static inline batch_vector batch_min(batch_vector a, batch_vector b) {
+    return _mm256_min_epi32(a, b);
+}
+
+#elif AQ_BATCH_LANES == 4
+
+typedef __m128i batch_vector;
+
+static inline batch_vector batch_set(int x) { return _mm_set1_epi32(x); }
+static inline batch_vector batch_load(const int *p) {
+    return _mm_loadu_si128((const __m128i*) p);
+}
+static inline void batch_store(int *p, batch_vector a) {
+    _mm_storeu_si128((__m128i*) p, a);
+}
+static inline batch_vector batch_add(batch_vector a, batch_vector b) {
+    return _mm_add_epi32(a, b);
+}
+static inline batch_vector batch_sub(batch_vector a, batch_vector b) {
+    return _mm_sub_epi32(a, b);
+}
+static inline batch_vector batch_and(batch_vector a, batch_vector b) {
+    return _mm_and_si128(a, b);
+}
+static inline batch_vector batch_or(batch_vector a, batch_vector b) {
+    return _mm_or_si128(a, b);
+}
+static inline batch_vector batch_andnot(batch_vector a, batch_vector b) {
+    return _mm_andnot_si128(a, b);
+}
+static inline batch_vector batch_eq(batch_vector a, batch_vector b) {
+    return _mm_cmpeq_epi32(a, b);
+}
+static inline batch_vector batch_gt(batch_vector a, batch_vector b) {
+    return _mm_cmpgt_epi32(a, b);
+}
+
+// SSE2 has no 32-bit minimum or maximum, so select through a comparison.
+static inline batch_vector batch_max(batch_vector a, batch_vector b) {
+    batch_vector greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, a),
+            _mm_andnot_si128(greater, b));
+}
+static inline batch_vector batch_min(batch_vector a, batch_vector b) {
+    batch_vector greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, b),
+            _mm_andnot_si128(greater, a));
+}
+
+#else
+
+typedef int batch_vector;
+
+static inline batch_vector batch_set(int x) { return x; }
+static inline batch_vector batch_load(const int *p) { return *p; }
+static inline void batch_store(int *p, batch_vector a) { *p = a; }
+static inline batch_vector batch_add(batch_vector a, batch_vector b) {
+    return a + b;
+}
+static inline batch_vector batch_sub(batch_vector a, batch_vector b) {
+    return a - b;
+}
+static inline batch_vector batch_and(batch_vector a, batch_vector b) {
+    return a & b;
+}
+static inline batch_vector batch_or(batch_vector a, batch_vector b) {
+    return a | b;
+}
+static inline batch_vector batch_andnot(batch_vector a, batch_vector b) {
+    return ~a & b;
+}
+static inline batch_vector batch_eq(batch_vector a, batch_vector b) {
+    return -(a == b);
+}
+static inline batch_vector batch_gt(batch_vector a, batch_vector b) {
+    return -(a > b);
+}
+static inline batch_vector batch_max(batch_vector a, batch_vector b) {
+    return a > b ? a : b;
+}
+static inline batch_vector batch_min(batch_vector a, batch_vector b) {
+    return a < b ? a : b;
+}
+
+#endif
+
+/**
+ * Summarizes a board as seen from each of its queens.
+ */
+void batch_parent_init(struct aq_batch_parent *parent, struct aq_board *board,
+        const struct aq_geometry *geometry, int wrap) {
+    int size = geometry->size;
+    int cells[8];
+    int q, r, c, s;
+
+    parent->size = size;
+    parent->wrap = wrap;
+    parent->num_queens = 0;
+
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j < size; ++j) {
+            if (!board_is_occupied(board, geometry, i, j)) {
+                continue;
+            }
+
+            q = parent->num_queens++;
+            parent->rows[q] = i;
+            parent->cols[q] = j;
+            parent->num_seen[q] = 0;
+
+            for (int d = 0; d < 8; ++d) {
+                parent->distances[q][d] = size;
+                r = i;
+                c = j;
+                for (int step = 1; step < size; ++step) {
+                    r += DIRECTIONS[d][0];
+                    c += DIRECTIONS[d][1];
+                    if (wrap) {
+                        r = (r + size) % size;
+                        c = (c + size) % size;
+                    } else if (r < 0 || r >= size || c < 0 || c >= size) {
+                        break;
+                    }
+
+                    if (board_is_occupied(board, geometry, r, c)) {
+                        parent->distances[q][d] = step;
+                        break;
+                    }
+                }
+
+                if (parent->distances[q][d] == size) {
+                    continue;
+                }
+
+                // Group the directions by the queen seen in them.
+                for (s = 0; s < parent->num_seen[q]; ++s) {
+                    if (cells[s] == r * size + c) {
+                        break;
+                    }
+                }
+
+                if (s == parent->num_seen[q]) {
+                    cells[s] = r * size + c;
+                    parent->directions[q][s] = 0;
+                    parent->num_seen[q]++;
+                }
+
+                parent->directions[q][s] |= 1 << d;
+            }
+        }
+    }
+}
+
+/**
+ * Evaluates AQ_BATCH_LANES candidates, one per lane.
+ */
+static inline
+void batch_simulate_lanes(const struct aq_batch_parent *parent,
+        const int *rows, const int *cols, const int *attacks,
+        int *max_attacks, int *same) {
+    const batch_vector zero = batch_set(0);
+    const batch_vector size = batch_set(parent->size);
+    batch_vector candidate_rows = batch_load(rows);
+    batch_vector candidate_cols = batch_load(cols);
+    batch_vector own = batch_load(attacks);
+    batch_vector most = own;
+    batch_vector least = own;
+    batch_vector dr, dc, forward_r, backward_r, forward_c, backward_c;
+    batch_vector on_row, on_col, on_diag, on_anti, closer, count;
+    batch_vector conditions[8], steps[8];
+
+    for (int q = 0; q < parent->num_queens; ++q) {
+        dr = batch_sub(candidate_rows, batch_set(parent->rows[q]));
+        dc = batch_sub(candidate_cols, batch_set(parent->cols[q]));
+
+        // Steps to the candidate going forward and backward along each
+        // axis. Steps that can never be taken are the size of the board,
+        // which is never closer than any queen.
+        if (parent->wrap) {
+            dr = batch_add(dr, batch_and(batch_gt(zero, dr), size));
+            dc = batch_add(dc, batch_and(batch_gt(zero, dc), size));
+            forward_r = dr;
+            backward_r = batch_sub(size, dr);
+            forward_c = dc;
+            backward_c = batch_sub(size, dc);
+            on_anti = batch_eq(batch_add(dr, dc), size);
+        } else {
+            forward_r = batch_or(batch_and(batch_gt(dr, zero), dr),
+                    batch_andnot(batch_gt(dr, zero), size));
+            backward_r = batch_or(batch_and(batch_gt(zero, dr),
+                        batch_sub(zero, dr)),
+                    batch_andnot(batch_gt(zero, dr), size));
+            forward_c = batch_or(batch_and(batch_gt(dc, zero), dc),
+                    batch_andnot(batch_gt(dc, zero), size));
+            backward_c = batch_or(batch_and(batch_gt(zero, dc),
+                        batch_sub(zero, dc)),
+                    batch_andnot(batch_gt(zero, dc), size));
+            on_anti = batch_eq(batch_add(dr, dc), zero);
+        }
+
+        on_row = batch_eq(dr, zero);
+        on_col = batch_eq(dc, zero);
+        on_diag = batch_eq(dr, dc);
+
+        conditions[0] = on_diag;
+        steps[0] = backward_r;
+        conditions[1] = on_col;
+        steps[1] = backward_r;
+        conditions[2] = on_anti;
+        steps[2] = backward_r;
+        conditions[3] = on_row;
+        steps[3] = backward_c;
+        conditions[4] = on_row;
+        steps[4] = forward_c;
+        conditions[5] = on_anti;
+        steps[5] = forward_r;
+        conditions[6] = on_col;
+        steps[6] = forward_r;
+        conditions[7] = on_diag;
+        steps[7] = forward_r;
+
+        // The directions in which the candidate is seen first.
+        closer = zero;
+        for (int d = 0; d < 8; ++d) {
+            closer = batch_or(closer, batch_and(batch_and(conditions[d],
+                            batch_gt(batch_set(parent->distances[q][d]),
+                                steps[d])), batch_set(1 << d)));
+        }
+
+        // A queen seen before is lost once the candidate hides it in every
+        // direction it was seen in, and the candidate counts once however
+        // many directions it is seen in.
+        count = batch_add(batch_set(parent->num_seen[q] + 1),
+                batch_eq(closer, zero));
+        for (int s = 0; s < parent->num_seen[q]; ++s) {
+            count = batch_add(count, batch_eq(batch_andnot(closer,
+                            batch_set(parent->directions[q][s])), zero));
+        }
+
+        most = batch_max(most, count);
+        least = batch_min(least, count);
+    }
+
+    batch_store(max_attacks, most);
+    batch_store(same, batch_sub(zero, batch_eq(most, least)));
+}
+
+/**
+ * Evaluates the boards made by placing one more queen on the parent, at
+ * each of count empty cells. attacks holds the attacks on each new queen,
+ * as board_cell_count_attacks or its wrap-around counterpart returns them.
+ *
+ * For each candidate, max_attacks receives what board_simulate_max_attacks
+ * or its wrap-around counterpart returns, and same whether every queen of
+ * the new board is attacked the same number of times.
+ */
+void batch_simulate(const struct aq_batch_parent *parent, const int *rows,
+        const int *cols, const int *attacks, int count, int *max_attacks,
+        int *same) {
+    int lane_rows[AQ_BATCH_LANES];
+    int lane_cols[AQ_BATCH_LANES];
+    int lane_attacks[AQ_BATCH_LANES];
+    int lane_max[AQ_BATCH_LANES];
+    int lane_same[AQ_BATCH_LANES];
+    int lanes;
+
+    for (int i = 0; i < count; i += AQ_BATCH_LANES) {
+        lanes = count - i < AQ_BATCH_LANES ? count - i : AQ_BATCH_LANES;
+        if (lanes == AQ_BATCH_LANES) {
+            batch_simulate_lanes(parent, rows + i, cols + i, attacks + i,
+                    max_attacks + i, same + i);
+            continue;
+        }
+
+        // Fill the lanes left over with the last candidate.
+        for (int j = 0; j < AQ_BATCH_LANES; ++j) {
+            lane_rows[j] = rows[i + (j < lanes ? j : lanes - 1)];
+            lane_cols[j] = cols[i + (j < lanes ? j : lanes - 1)];
+            lane_attacks[j] = attacks[i + (j < lanes ? j : lanes - 1)];
+        }
+
+        batch_simulate_lanes(parent, lane_rows, lane_cols, lane_attacks,
+                lane_max, lane_same);
+        for (int j = 0; j < lanes; ++j) {
+            max_attacks[i + j] = lane_max[j];
+            same[i + j] = lane_same[j];
+        }
+    }
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,74 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Batch evaluation of sibling candidates.
+ *
+ * Every candidate cell of a node is a board that differs from its parent by
+ * one queen. Instead of recounting the attacks on every queen of each such
+ * board, as board_simulate_max_attacks does, the parent is summarized once:
+ * for every queen, how far it sees in each direction, and which directions
+ * each queen it sees lies in. A new queen only changes what a queen sees in
+ * the directions where it lands closer than the queen seen so far, which is
+ * a handful of comparisons.
+ *
+ * These comparisons are the same for every candidate, so candidates are
+ * evaluated AQ_BATCH_LANES at a time, one per lane of a vector register:
+ * eight with AVX2, four with SSE2, or one at a time on other targets or with
+ * AQ_BATCH_SCALAR defined. configure --enable-simd picks the instruction set.
+ *
+ * On a normal board, planes.h already evaluates every cell at once, so the
+ * search only uses this for wrap-around boards.
+ */
+
+#ifndef AQ_BATCH_H_
+#define AQ_BATCH_H_
+
+#include <stdint.h>
+
+#include "board.h"
+
+/**
+ * Number of candidates evaluated at once.
+ */
+#if defined(__AVX2__) && !defined(AQ_BATCH_SCALAR)
+#define AQ_BATCH_LANES 8
+#elif defined(__SSE2__) && !defined(AQ_BATCH_SCALAR)
+#define AQ_BATCH_LANES 4
+#else
+#define AQ_BATCH_LANES 1
+#endif
+
+/**
+ * A parent board as seen from each of its queens.
+ *
+ * The eight directions go around the 3x3 neighbourhood of a cell in
+ * row-major order, as in planes.h. distances[q][d] is the number of steps
+ * from queen q to the first queen it sees in direction d, or the size of the
+ * board if there is none. On a wrap-around board the same queen may be seen
+ * in several directions, so the queens seen by q are kept as the set of
+ * directions each of them is seen in, in directions[q].
+ */
+struct aq_batch_parent {
+    int size;
+    int wrap;
+    int num_queens;
+    int16_t rows[AQ_BOARD_MAX_CELLS];
+    int16_t cols[AQ_BOARD_MAX_CELLS];
+    int8_t distances[AQ_BOARD_MAX_CELLS][8];
+    uint8_t directions[AQ_BOARD_MAX_CELLS][8];
+    int8_t num_seen[AQ_BOARD_MAX_CELLS];
+};
+
+/**
+ * Function prototypes.
+ */
+void batch_parent_init(struct aq_batch_parent *parent, struct aq_board *board,
+        const struct aq_geometry *geometry, int wrap);
+void batch_simulate(const struct aq_batch_parent *parent, const int *rows,
+        const int *cols, const int *attacks, int count, int *max_attacks,
+        int *same);
+
+#endif /* AQ_BATCH_H_ */
+
+/* vim: set ts=4 sw=4 et: */
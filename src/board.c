@@ -7,23 +7,41 @@
 
 #include "board.h"
 
-extern struct aq_board board_new(int);
-extern int board_get_slice_id(struct aq_board*, int, int);
-extern int board_get_offset_in_slice(struct aq_board*, int, int);
-extern int board_is_occupied(struct aq_board*, int, int);
-extern void board_set_occupied(struct aq_board*, int, int);
-extern void board_set_row_occupied(struct aq_board*, int);
-extern void board_set_col_occupied(struct aq_board*, int);
-extern void board_set_diag_occupied(struct aq_board*, int, int);
-extern void board_set_unoccupied(struct aq_board*, int, int);
-extern void board_clear(struct aq_board*);
-extern int board_cell_count_attacks(struct aq_board*, int, int);
-extern int board_cell_count_attacks_wrap(struct aq_board*, int, int);
-extern int board_max_attacks(struct aq_board*);
-extern int board_simulate_max_attacks(struct aq_board*, int, int);
-extern int board_all_has_same_attacks(struct aq_board*);
-extern int board_count_occupied(struct aq_board*);
-extern int boards_are_equal(struct aq_board*, struct aq_board*);
-extern void board_print(struct aq_board*);
-
+extern void board_geometry_init(struct aq_geometry*, int);
+extern struct aq_board board_new();
+extern int board_get_slice_id(const struct aq_geometry*, int, int);
+extern int board_get_offset_in_slice(const struct aq_geometry*, int, int);
+extern int board_is_occupied(struct aq_board*, const struct aq_geometry*, int,
+        int);
+extern void board_set_occupied(struct aq_board*, const struct aq_geometry*,
+        int, int);
+extern void board_set_row_occupied(struct aq_board*,
+        const struct aq_geometry*, int);
+extern void board_set_col_occupied(struct aq_board*,
+        const struct aq_geometry*, int);
+extern void board_set_diag_occupied(struct aq_board*,
+        const struct aq_geometry*, int, int);
+extern void board_set_unoccupied(struct aq_board*, const struct aq_geometry*,
+        int, int);
+extern void board_clear(struct aq_board*, const struct aq_geometry*);
+extern int board_cell_count_attacks(struct aq_board*,
+        const struct aq_geometry*, int, int);
+extern int board_cell_count_attacks_wrap(struct aq_board*,
+        const struct aq_geometry*, int, int);
+extern int board_max_attacks(struct aq_board*, const struct aq_geometry*);
+extern int board_simulate_max_attacks(struct aq_board*,
+        const struct aq_geometry*, int, int);
+extern int board_all_has_same_attacks(struct aq_board*,
+        const struct aq_geometry*);
+extern int board_max_attacks_wrap(struct aq_board*, const struct aq_geometry*);
+extern int board_simulate_max_attacks_wrap(struct aq_board*,
+        const struct aq_geometry*, int, int);
+extern int board_all_has_same_attacks_wrap(struct aq_board*,
+        const struct aq_geometry*);
+extern int board_count_occupied(struct aq_board*, const struct aq_geometry*);
+extern int boards_are_equal(struct aq_board*, struct aq_board*,
+        const struct aq_geometry*);
+extern int boards_compare(struct aq_board*, struct aq_board*,
+        const struct aq_geometry*);
+extern void board_print(struct aq_board*, const struct aq_geometry*);
 /* vim: set ts=4 sw=4 et: */
@@ -12,7 +12,6 @@
 #include <math.h>
 #include <stdint.h>
 #include <assert.h>
-#include "log.h"
 
 /**
  * Since each board configuration is stored as a bit string, we only have up
@@ -24,45 +23,83 @@
  */
 #define AQ_BOARD_SLICES 4
 
+/**
+ * Largest number of cells a board can hold.
+ */
+#define AQ_BOARD_MAX_CELLS (AQ_BOARD_SLICES * 64)
+
 /**
  * A structure that represents a chess board.
- * Contains bookkeeping information.
+ *
+ * Only the occupied positions are kept here. Everything that follows from
+ * the size of the board lives in a struct aq_geometry shared by every board
+ * of a run, so that copies of a board are just a few words. Slices past the
+ * ones in use are always clear.
  */
 struct aq_board {
 	uint64_t slices[AQ_BOARD_SLICES];
-	int size;
-	int bits_occupied;
-	int slices_occupied;
 };
 
 /**
- * Creates a new board.
+ * The layout of the boards of one size, which never changes during a run.
+ * Contains bookkeeping information.
+ *
+ * all has every cell of the board set, while slice_ids and masks give the
+ * slice and the bit of each position, indexed by row * size + col.
+ */
+struct aq_geometry {
+    int size;
+    int bits_occupied;
+    int slices_occupied;
+    struct aq_board all;
+    uint8_t slice_ids[AQ_BOARD_MAX_CELLS];
+    uint64_t masks[AQ_BOARD_MAX_CELLS];
+};
+
+/**
+ * Computes the layout of boards of a size.
  */
 inline
-struct aq_board board_new(int size) {
+void board_geometry_init(struct aq_geometry *geometry, int size) {
 #ifndef NDEBUG
     int slices_required = ceil(size * size / 64.0);
     assert(slices_required <= AQ_BOARD_SLICES &&
            "Try increasing AQ_BOARD_SLICES?");
 #endif
 
-    struct aq_board board = { {0}, 0, 0, 0 };
-    board.bits_occupied = size * size;
-    board.slices_occupied = (board.bits_occupied + 64 - 1) >> 6;
-    board.size = size;
+    geometry->size = size;
+    geometry->bits_occupied = size * size;
+    geometry->slices_occupied = (geometry->bits_occupied + 64 - 1) >> 6;
+
+    for (int i = 0; i < AQ_BOARD_SLICES; ++i) {
+        geometry->all.slices[i] = 0;
+    }
+
+    for (int offset = 0; offset < geometry->bits_occupied; ++offset) {
+        geometry->slice_ids[offset] = offset >> 6;
+        geometry->masks[offset] = 0x8000000000000000ULL >> (offset & 63);
+        geometry->all.slices[offset >> 6] |= geometry->masks[offset];
+    }
+}
+
+/**
+ * Creates a new board with no position occupied.
+ */
+inline
+struct aq_board board_new() {
+    struct aq_board board = { {0} };
     return board;
 }
 
 inline
-int board_get_slice_id(struct aq_board *board, int row, int col) {
-    int offset = row * board->size + col;
-    int slice_id = offset >> 6;
-    return slice_id;
+int board_get_slice_id(const struct aq_geometry *geometry, int row, int col) {
+    return geometry->slice_ids[row * geometry->size + col];
 }
 
 inline
-int board_get_offset_in_slice(struct aq_board *board, int row, int col) {
-    int offset = row * board->size + col;
+int board_get_offset_in_slice(const struct aq_geometry *geometry, int row,
+        int col) {
+    int offset = row * geometry->size + col;
     return offset & 63;
 }
 
@@ -71,13 +108,13 @@ int board_get_offset_in_slice(struct aq_board *board, int row, int col) {
  * Returns zero if position is not occupied, non-zero otherwise.
  */
 inline
-int board_is_occupied(struct aq_board *board, int row, int col) {
-	int slice_id = board_get_slice_id(board, row, col);
-	int offset = board_get_offset_in_slice(board, row, col);
+int board_is_occupied(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
+	int offset = row * geometry->size + col;
 
 	// Select the correct value.
-	uint64_t mask = 0x8000000000000000ULL >> offset;
-	uint64_t value = board->slices[slice_id] & mask;
+	uint64_t value = board->slices[geometry->slice_ids[offset]] &
+	                 geometry->masks[offset];
 
 	return __builtin_ffsll(value);
 }
@@ -86,12 +123,13 @@ int board_is_occupied(struct aq_board *board, int row, int col) {
  * Sets the value of a specified position on the board.
  */
 inline
-void board_set_occupied(struct aq_board *board, int row, int col) {
-    int slice_id = board_get_slice_id(board, row, col);
-    int offset = board_get_offset_in_slice(board, row, col);
+void board_set_occupied(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
+    int offset = row * geometry->size + col;
+    int slice_id = geometry->slice_ids[offset];
 
     // Select the correct value.
-    uint64_t mask = 0x8000000000000000ULL >> offset;
+    uint64_t mask = geometry->masks[offset];
     board->slices[slice_id] |= mask;
 }
 
@@ -99,15 +137,17 @@ void board_set_occupied(struct aq_board *board, int row, int col) {
  * Sets the value of a specified row on the board.
  */
 inline
-void board_set_row_occupied(struct aq_board *board, int row) {
+void board_set_row_occupied(struct aq_board *board,
+        const struct aq_geometry *geometry, int row) {
 #ifndef NDEBUG
-    assert(row < board->size);
+    assert(row < geometry->size);
 #endif
 
-    int start_slice_id = board_get_slice_id(board, row, 0);
-    int start_offset = board_get_offset_in_slice(board, row, 0);
-    int end_slice_id = board_get_slice_id(board, row, board->size - 1);
-    int end_offset = board_get_offset_in_slice(board, row, board->size - 1);
+    int start_slice_id = board_get_slice_id(geometry, row, 0);
+    int start_offset = board_get_offset_in_slice(geometry, row, 0);
+    int end_slice_id = board_get_slice_id(geometry, row, geometry->size - 1);
+    int end_offset = board_get_offset_in_slice(geometry, row,
+            geometry->size - 1);
 
     if (start_slice_id == end_slice_id) {
         // XXX: This effectively limits the board size to 63x63.
@@ -126,29 +166,31 @@ void board_set_row_occupied(struct aq_board *board, int row) {
  * Sets the value of a specified column on the board.
  */
 inline
-void board_set_col_occupied(struct aq_board *board, int col) {
+void board_set_col_occupied(struct aq_board *board,
+        const struct aq_geometry *geometry, int col) {
 #ifndef NDEBUG
-    assert(col < board->size);
+    assert(col < geometry->size);
 #endif
 
     // Compute mask for a specified slice.
-    for (int i = 0; i < board->slices_occupied; ++i){
+    for (int i = 0; i < geometry->slices_occupied; ++i){
         uint64_t mask = 0x8000000000000000ULL;
-        for (int j = col; j < 64; j += board->size) {
-            mask >>= board->size;
+        for (int j = col; j < 64; j += geometry->size) {
+            mask >>= geometry->size;
             mask |= 0x8000000000000000ULL;
         }
 
         // Sometimes we may end up on the same row - we need to correct that.
-        int row = (i << 6) / board->size;
-        int slice_id = board_get_slice_id(board, row, col);
+        int row = (i << 6) / geometry->size;
+        int slice_id = board_get_slice_id(geometry, row, col);
         if (slice_id != i) {
             row++;
         }
 
-        int offset = (row * board->size + col) % 64 % board->size;
+        // The pattern runs on past the last cell, so keep it to the board.
+        int offset = (row * geometry->size + col) % 64 % geometry->size;
         mask >>= offset;
-        board->slices[i] |= mask;
+        board->slices[i] |= mask & geometry->all.slices[i];
     }
 }
 
@@ -156,12 +198,13 @@ void board_set_col_occupied(struct aq_board *board, int col) {
  * Sets the value of a specified diagonal on the board.
  */
 inline
-void board_set_diag_occupied(struct aq_board *board, int row, int col) {
+void board_set_diag_occupied(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
     // I don't think there's an easy fast way to do this...
     // Top left direction.
     int i = row, j = col;
     while (i >= 0 && j >= 0) {
-        board_set_occupied(board, i, j);
+        board_set_occupied(board, geometry, i, j);
         i--;
         j--;
     }
@@ -169,8 +212,8 @@ void board_set_diag_occupied(struct aq_board *board, int row, int col) {
     // Top right direction.
     i = row;
     j = col;
-    while (i >= 0 && j < board->size) {
-        board_set_occupied(board, i, j);
+    while (i >= 0 && j < geometry->size) {
+        board_set_occupied(board, geometry, i, j);
         i--;
         j++;
     }
@@ -178,8 +221,8 @@ void board_set_diag_occupied(struct aq_board *board, int row, int col) {
     // Bottom left direction.
     i = row;
     j = col;
-    while (i < board->size && j >= 0) {
-        board_set_occupied(board, i, j);
+    while (i < geometry->size && j >= 0) {
+        board_set_occupied(board, geometry, i, j);
         i++;
         j--;
     }
@@ -187,8 +230,8 @@ void board_set_diag_occupied(struct aq_board *board, int row, int col) {
     // Bottom right direction.
     i = row;
     j = col;
-    while (i < board->size && j < board->size) {
-        board_set_occupied(board, i, j);
+    while (i < geometry->size && j < geometry->size) {
+        board_set_occupied(board, geometry, i, j);
         i++;
         j++;
     }
@@ -198,12 +241,13 @@ void board_set_diag_occupied(struct aq_board *board, int row, int col) {
  * Clears the value of a specified position on the board.
  */
 inline
-void board_set_unoccupied(struct aq_board *board, int row, int col) {
-    int slice_id = board_get_slice_id(board, row, col);
-    int offset = board_get_offset_in_slice(board, row, col);
+void board_set_unoccupied(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
+    int offset = row * geometry->size + col;
+    int slice_id = geometry->slice_ids[offset];
 
     // Select the correct value.
-    uint64_t mask = 0x8000000000000000ULL >> offset;
+    uint64_t mask = geometry->masks[offset];
     board->slices[slice_id] &= ~mask;
 }
 
@@ -211,8 +255,8 @@ void board_set_unoccupied(struct aq_board *board, int row, int col) {
  * Clears all values from the board.
  */
 inline
-void board_clear(struct aq_board *board) {
-    for (int i = 0; i < board->slices_occupied; ++i) {
+void board_clear(struct aq_board *board, const struct aq_geometry *geometry) {
+    for (int i = 0; i < geometry->slices_occupied; ++i) {
         board->slices[i] = 0;
     }
 }
@@ -222,26 +266,27 @@ void board_clear(struct aq_board *board) {
  * Returns -1 if the position is already occupied by a piece.
  */
 inline
-int board_cell_count_attacks(struct aq_board *board, int row, int col) {
+int board_cell_count_attacks(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
     int attack_count = 0;
 
     // We short circuit if the slot is already occupied.
-    if (board_is_occupied(board, row, col)) {
+    if (board_is_occupied(board, geometry, row, col)) {
         return -1;
     }
     
     // Check occupied positions on row.
     // Top direction.
     for (int i = col; i >= 0; --i) {
-        if (board_is_occupied(board, row, i)) {
+        if (board_is_occupied(board, geometry, row, i)) {
             attack_count++;
             break;
         }
     }
 
     // Bottom direction.
-    for (int i = col; i < board->size; ++i) {
-        if (board_is_occupied(board, row, i)) {
+    for (int i = col; i < geometry->size; ++i) {
+        if (board_is_occupied(board, geometry, row, i)) {
             attack_count++;
             break;
         }
@@ -250,15 +295,15 @@ int board_cell_count_attacks(struct aq_board *board, int row, int col) {
     // Check occupied positions on column.
     // Left direction.
     for (int i = row; i >= 0; --i) {
-        if (board_is_occupied(board, i, col)) {
+        if (board_is_occupied(board, geometry, i, col)) {
             attack_count++;
             break;
         }
     }
 
     // Right direction.
-    for (int i = row; i < board->size; ++i) {
-        if (board_is_occupied(board, i, col)) {
+    for (int i = row; i < geometry->size; ++i) {
+        if (board_is_occupied(board, geometry, i, col)) {
             attack_count++;
             break;
         }
@@ -268,7 +313,7 @@ int board_cell_count_attacks(struct aq_board *board, int row, int col) {
     // Top left direction.
     int i = row, j = col;
     while (i >= 0 && j >= 0) {
-        if (board_is_occupied(board, i, j)) {
+        if (board_is_occupied(board, geometry, i, j)) {
             attack_count++;
             break;
         }
@@ -280,8 +325,8 @@ int board_cell_count_attacks(struct aq_board *board, int row, int col) {
     // Top right direction.
     i = row;
     j = col;
-    while (i >= 0 && j < board->size) {
-        if (board_is_occupied(board, i, j)) {
+    while (i >= 0 && j < geometry->size) {
+        if (board_is_occupied(board, geometry, i, j)) {
             attack_count++;
             break;
         }
@@ -293,8 +338,8 @@ int board_cell_count_attacks(struct aq_board *board, int row, int col) {
     // Bottom left direction.
     i = row;
     j = col;
-    while (i < board->size && j >= 0) {
-        if (board_is_occupied(board, i, j)) {
+    while (i < geometry->size && j >= 0) {
+        if (board_is_occupied(board, geometry, i, j)) {
             attack_count++;
             break;
         }
@@ -306,8 +351,8 @@ int board_cell_count_attacks(struct aq_board *board, int row, int col) {
     // Bottom right direction.
     i = row;
     j = col;
-    while (i < board->size && j < board->size) {
-        if (board_is_occupied(board, i, j)) {
+    while (i < geometry->size && j < geometry->size) {
+        if (board_is_occupied(board, geometry, i, j)) {
             attack_count++;   
             break;
         }
@@ -324,13 +369,14 @@ int board_cell_count_attacks(struct aq_board *board, int row, int col) {
  * Returns -1 if the position is already occupied by a piece.
  */
 inline
-int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
+int board_cell_count_attacks_wrap(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
     int attack_count = 0;
     int attacks[20];
-    int bs = board->size * board->size;
+    int bs = geometry->size * geometry->size;
     
     // We short circuit if the slot is already occupied.
-    if (board_is_occupied(board, row, col)) {
+    if (board_is_occupied(board, geometry, row, col)) {
         return -1;
     }
 
@@ -341,22 +387,22 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     // Check occupied positions on row.
     // Left direction.
     for (int i = row; i >= 0; --i) {
-        if (board_is_occupied(board, i, col)) {
+        if (board_is_occupied(board, geometry, i, col)) {
             if(attacks[0] == -1) {
-                attacks[0] = board_get_slice_id(board, i, col) * bs + board_get_offset_in_slice(board, i, col);
+                attacks[0] = board_get_slice_id(geometry, i, col) * bs + board_get_offset_in_slice(geometry, i, col);
             } else {
-                attacks[1] = board_get_slice_id(board, i, col) * bs + board_get_offset_in_slice(board, i, col);
+                attacks[1] = board_get_slice_id(geometry, i, col) * bs + board_get_offset_in_slice(geometry, i, col);
             }
         }
     }
 
     // Right direction.
-    for (int i = row; i < board->size; ++i) {
-        if (board_is_occupied(board, i, col)) {
+    for (int i = row; i < geometry->size; ++i) {
+        if (board_is_occupied(board, geometry, i, col)) {
             if(attacks[2] == -1) {
-                attacks[2] = board_get_slice_id(board, i, col) * bs + board_get_offset_in_slice(board, i, col);
+                attacks[2] = board_get_slice_id(geometry, i, col) * bs + board_get_offset_in_slice(geometry, i, col);
             } else {
-                attacks[3] = board_get_slice_id(board, i, col) * bs + board_get_offset_in_slice(board, i, col);            
+                attacks[3] = board_get_slice_id(geometry, i, col) * bs + board_get_offset_in_slice(geometry, i, col);            
             }
         }
     }
@@ -364,22 +410,22 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     // Check occupied positions on column.
     // Top direction.
     for (int i = col; i >= 0; --i) {
-        if (board_is_occupied(board, row, i)) {
+        if (board_is_occupied(board, geometry, row, i)) {
             if(attacks[4] == -1) {
-                attacks[4] = board_get_slice_id(board, row, i) * bs + board_get_offset_in_slice(board, row, i);
+                attacks[4] = board_get_slice_id(geometry, row, i) * bs + board_get_offset_in_slice(geometry, row, i);
             } else {
-                attacks[5] = board_get_slice_id(board, row, i) * bs + board_get_offset_in_slice(board, row, i);          
+                attacks[5] = board_get_slice_id(geometry, row, i) * bs + board_get_offset_in_slice(geometry, row, i);          
             }
         }
     }
 
     // Bottom direction.
-    for (int i = col; i < board->size; ++i) {
-        if (board_is_occupied(board, row, i)) {
+    for (int i = col; i < geometry->size; ++i) {
+        if (board_is_occupied(board, geometry, row, i)) {
             if(attacks[6] == -1) {
-                attacks[6] = board_get_slice_id(board, row, i) * bs + board_get_offset_in_slice(board, row, i);
+                attacks[6] = board_get_slice_id(geometry, row, i) * bs + board_get_offset_in_slice(geometry, row, i);
             } else {
-                attacks[7] = board_get_slice_id(board, row, i) * bs + board_get_offset_in_slice(board, row, i);            
+                attacks[7] = board_get_slice_id(geometry, row, i) * bs + board_get_offset_in_slice(geometry, row, i);            
             }
         }
     }
@@ -389,11 +435,11 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     // Top left direction.
     int i = row, j = col;
     while (i >= 0 && j >= 0) {
-        if (board_is_occupied(board, i, j)) {
+        if (board_is_occupied(board, geometry, i, j)) {
             if(attacks[8] == -1) {
-                attacks[8] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);
+                attacks[8] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);
             } else {
-                attacks[9] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);          
+                attacks[9] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);          
             }
         }
         
@@ -405,12 +451,12 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     // Bottom right direction.
     i = row;
     j = col;
-    while (i < board->size && j < board->size) {
-        if (board_is_occupied(board, i, j)) {
+    while (i < geometry->size && j < geometry->size) {
+        if (board_is_occupied(board, geometry, i, j)) {
             if(attacks[10] == -1) {
-                attacks[10] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);
+                attacks[10] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);
             } else {
-                attacks[11] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);          
+                attacks[11] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);          
             }
         }
         
@@ -419,19 +465,19 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     }
     
     //if not in center diagonal
-    if (!(attacks[8] != -1 && attacks [10] != -1) && !(i == board->size && j == board->size)) {
-        if (i >= board->size) {
-            i -= board->size;        
+    if (!(attacks[8] != -1 && attacks [10] != -1) && !(i == geometry->size && j == geometry->size)) {
+        if (i >= geometry->size) {
+            i -= geometry->size;        
         } else {
-            j -= board->size;        
+            j -= geometry->size;        
         }     
     
-        while (i < board->size && j < board->size) {
-            if (board_is_occupied(board, i, j)) {
+        while (i < geometry->size && j < geometry->size) {
+            if (board_is_occupied(board, geometry, i, j)) {
                 if(attacks[12] == -1) {
-                    attacks[12] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);
+                    attacks[12] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);
                 } else {
-                    attacks[13] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);          
+                    attacks[13] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);          
                 }
             }
             
@@ -445,12 +491,12 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     // Top right direction.
     i = row;
     j = col;
-    while (i >= 0 && j < board->size) {
-        if (board_is_occupied(board, i, j)) {
+    while (i >= 0 && j < geometry->size) {
+        if (board_is_occupied(board, geometry, i, j)) {
             if(attacks[14] == -1) {
-                attacks[14] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);
+                attacks[14] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);
             } else {
-                attacks[15] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);          
+                attacks[15] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);          
             }
         }
         
@@ -461,12 +507,12 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     // Bottom left direction.
     i = row;
     j = col;
-    while (i < board->size && j > -1) {
-        if (board_is_occupied(board, i, j)) {
+    while (i < geometry->size && j > -1) {
+        if (board_is_occupied(board, geometry, i, j)) {
             if(attacks[16] == -1) {
-                attacks[16] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);
+                attacks[16] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);
             } else {
-                attacks[17] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);          
+                attacks[17] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);          
             }
         }
         
@@ -475,19 +521,19 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
     }
     
     // not in the center diagonal
-    if (!(attacks[14] != -1 && attacks[16] != -1) && !(i == board->size && j == -1)) {
-        if (i >= board->size) {
-            i -= board->size;        
+    if (!(attacks[14] != -1 && attacks[16] != -1) && !(i == geometry->size && j == -1)) {
+        if (i >= geometry->size) {
+            i -= geometry->size;        
         } else {
-            j += board->size;        
+            j += geometry->size;        
         }     
     
-        while (i < board->size && j > -1) {
-            if (board_is_occupied(board, i, j)) {
+        while (i < geometry->size && j > -1) {
+            if (board_is_occupied(board, geometry, i, j)) {
                 if(attacks[18] == -1) {
-                    attacks[18] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);
+                    attacks[18] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);
                 } else {
-                    attacks[19] = board_get_slice_id(board, i, j) * bs + board_get_offset_in_slice(board, i, j);          
+                    attacks[19] = board_get_slice_id(geometry, i, j) * bs + board_get_offset_in_slice(geometry, i, j);          
                 }
             }
             
@@ -609,17 +655,19 @@ int board_cell_count_attacks_wrap(struct aq_board *board, int row, int col) {
  * board.
  */
 inline
-int board_max_attacks(struct aq_board *board) {
+int board_max_attacks(struct aq_board *board,
+        const struct aq_geometry *geometry) {
     int max_attacks = 0;
     int num_attacks = 0;
 
-    for (int i = 0; i < board->size; ++i) {
-        for (int j = 0; j < board->size; ++j) {
-            if (board_is_occupied(board, i, j)) {
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
                 struct aq_board simulation_board = *board;
-                board_set_unoccupied(&simulation_board, i, j);
+                board_set_unoccupied(&simulation_board, geometry, i, j);
 
-                num_attacks = board_cell_count_attacks(&simulation_board, i, j);
+                num_attacks = board_cell_count_attacks(&simulation_board,
+                        geometry, i, j);
                 if (num_attacks > max_attacks) {
                     max_attacks = num_attacks;
                 }
@@ -635,10 +683,11 @@ int board_max_attacks(struct aq_board *board) {
  * board.
  */
 inline
-int board_simulate_max_attacks(struct aq_board *board, int row, int col) {
+int board_simulate_max_attacks(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
     struct aq_board simulation_board = *board;
-    board_set_occupied(&simulation_board, row, col);
-    return board_max_attacks(&simulation_board);
+    board_set_occupied(&simulation_board, geometry, row, col);
+    return board_max_attacks(&simulation_board, geometry);
 }
 
 /**
@@ -646,17 +695,91 @@ int board_simulate_max_attacks(struct aq_board *board, int row, int col) {
  * board is the same, zero otherwise.
  */
 inline
-int board_all_has_same_attacks(struct aq_board *board) {
+int board_all_has_same_attacks(struct aq_board *board,
+        const struct aq_geometry *geometry) {
+    int prev_attacks = -1;
+    int attacks = 0;
+
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
+                struct aq_board simulation_board = *board;
+                board_set_unoccupied(&simulation_board, geometry, i, j);
+
+                attacks = board_cell_count_attacks(&simulation_board,
+                        geometry, i, j);
+                if (prev_attacks == -1) {
+                    prev_attacks = attacks;
+                }
+
+                if (prev_attacks != attacks) {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the maximum number of attacks on every occupied position on a
+ * wrap-around board.
+ */
+inline
+int board_max_attacks_wrap(struct aq_board *board,
+        const struct aq_geometry *geometry) {
+    int max_attacks = 0;
+    int num_attacks = 0;
+
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
+                struct aq_board simulation_board = *board;
+                board_set_unoccupied(&simulation_board, geometry, i, j);
+
+                num_attacks = board_cell_count_attacks_wrap(&simulation_board,
+                        geometry, i, j);
+                if (num_attacks > max_attacks) {
+                    max_attacks = num_attacks;
+                }
+            }
+        }
+    }
+
+    return max_attacks;
+}
+
+/**
+ * Simulates the maximum number of attacks on every occupied position on a
+ * wrap-around board.
+ */
+inline
+int board_simulate_max_attacks_wrap(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col) {
+    struct aq_board simulation_board = *board;
+    board_set_occupied(&simulation_board, geometry, row, col);
+    return board_max_attacks_wrap(&simulation_board, geometry);
+}
+
+/**
+ * Returns non-zero if the number of attacks on every occupied position on a
+ * wrap-around board is the same, zero otherwise.
+ */
+inline
+int board_all_has_same_attacks_wrap(struct aq_board *board,
+        const struct aq_geometry *geometry) {
     int prev_attacks = -1;
     int attacks = 0;
 
-    for (int i = 0; i < board->size; ++i) {
-        for (int j = 0; j < board->size; ++j) {
-            if (board_is_occupied(board, i, j)) {
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
                 struct aq_board simulation_board = *board;
-                board_set_unoccupied(&simulation_board, i, j);
+                board_set_unoccupied(&simulation_board, geometry, i, j);
 
-                attacks = board_cell_count_attacks(&simulation_board, i, j);
+                attacks = board_cell_count_attacks_wrap(&simulation_board,
+                        geometry, i, j);
                 if (prev_attacks == -1) {
                     prev_attacks = attacks;
                 }
@@ -675,9 +798,10 @@ int board_all_has_same_attacks(struct aq_board *board) {
  * Counts the number of occupied positions on the board.
  */
 inline
-int board_count_occupied(struct aq_board *board) {
+int board_count_occupied(struct aq_board *board,
+        const struct aq_geometry *geometry) {
     int count = 0;
-    for (int i = 0; i < board->slices_occupied; ++i) {
+    for (int i = 0; i < geometry->slices_occupied; ++i) {
         // Praise to be god of SSE4.2.
         count += __builtin_popcountll(board->slices[i]);
     }
@@ -689,12 +813,9 @@ int board_count_occupied(struct aq_board *board) {
  * Checks if two boards are equal.
  */
 inline
-int boards_are_equal(struct aq_board *b1, struct aq_board *b2) {
-#ifndef NDEBUG
-    assert(b1->size == b2->size);
-#endif
-
-    for (int i = 0; i < b1->size; ++i) {
+int boards_are_equal(struct aq_board *b1, struct aq_board *b2,
+        const struct aq_geometry *geometry) {
+    for (int i = 0; i < geometry->slices_occupied; ++i) {
         if (b1->slices[i] != b2->slices[i]) {
             return 0;
         }
@@ -703,6 +824,23 @@ int boards_are_equal(struct aq_board *b1, struct aq_board *b2) {
     return 1;
 }
 
+/**
+ * Orders two boards by their slices, so that the board occupying the earliest
+ * differing position compares greater. Returns a negative value, zero or a
+ * positive value like strcmp.
+ */
+inline
+int boards_compare(struct aq_board *b1, struct aq_board *b2,
+        const struct aq_geometry *geometry) {
+    for (int i = 0; i < geometry->slices_occupied; ++i) {
+        if (b1->slices[i] != b2->slices[i]) {
+            return b1->slices[i] < b2->slices[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Pretty-prints the board.
  *
@@ -710,40 +848,40 @@ int boards_are_equal(struct aq_board *b1, struct aq_board *b2) {
  * got time for that!
  */
 inline
-void board_print(struct aq_board *board) {
+void board_print(struct aq_board *board, const struct aq_geometry *geometry) {
     // Buffer containing format string.
     char buffer[64];
 
     // Column numbers.
-    snprintf(buffer, 64, " %%%ds   ", (board->size / 10) + 2);
+    snprintf(buffer, 64, " %%%ds   ", (geometry->size / 10) + 2);
     printf(buffer, " ");
     
-    snprintf(buffer, 64, "%%%dd", (board->size / 10) + 2);
-    for (int i = 0; i < board->size; ++i) {
+    snprintf(buffer, 64, "%%%dd", (geometry->size / 10) + 2);
+    for (int i = 0; i < geometry->size; ++i) {
         printf(buffer, i);
     }
     printf("\n");
 
     // Header divider.
-    snprintf(buffer, 64, " %%%ds   ", (board->size / 10) + 2);
+    snprintf(buffer, 64, " %%%ds   ", (geometry->size / 10) + 2);
     printf(buffer, " ");
     
     char dashes[16];
-    snprintf(buffer, 64, "%%%ds", (board->size / 10) + 2);
-    for (int i = 0; i < board->size; ++i) {
+    snprintf(buffer, 64, "%%%ds", (geometry->size / 10) + 2);
+    for (int i = 0; i < geometry->size; ++i) {
         snprintf(dashes, 16, "%.*s", (i / 10) + 1, "--------");
         printf(buffer, dashes);
     }
 
     // Actual data values are printed here.
     printf("\n");
-    for (int i = 0; i < board->size; ++i) {
-        snprintf(buffer, 64, " %%%dd | ", (board->size / 10) + 2);
+    for (int i = 0; i < geometry->size; ++i) {
+        snprintf(buffer, 64, " %%%dd | ", (geometry->size / 10) + 2);
         printf(buffer, i);
 
-        snprintf(buffer, 64, "%%%ds", (board->size / 10) + 2);
-        for (int j = 0; j < board->size; ++j) {
-            if (board_is_occupied(board, i, j)) {
+        snprintf(buffer, 64, "%%%ds", (geometry->size / 10) + 2);
+        for (int j = 0; j < geometry->size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
                 printf(buffer, "x");
             } else {
                 printf(buffer, "o");
@@ -0,0 +1,902 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Differential checks of the board kernels and the searches.
+ *
+ * Every kernel that counts attacks is checked, cell by cell, against a
+ * deliberately naive reference that walks each ray one step at a time. The
+ * boards are random ones of every density and ones built to hit the edge
+ * cases: empty and full boards, whole lines, corners and the cells around
+ * the boundaries of the slices, for every size up to CHECK_MAX_SIZE, on
+ * both normal and wrap-around boards.
+ *
+ * The complete searches are then checked against a brute-force enumeration
+ * of every board of the small sizes, for every k at once.
+ *
+ * Run by make check. Prints every mismatch with the board it was found on,
+ * and exits with a failure if there was any.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aq.h"
+#include "batch.h"
+#include "board.h"
+#include "join.h"
+#include "planes.h"
+#include "profile.h"
+#include "store.h"
+#include "symmetry.h"
+
+/**
+ * Largest board checked, and number of random boards checked for every size
+ * and mode.
+ */
+#define CHECK_MAX_SIZE 16
+#define CHECK_RANDOM_BOARDS 48
+
+/**
+ * Largest board whose every subset is enumerated.
+ */
+#define CHECK_BRUTE_FORCE_SIZE 4
+
+/**
+ * Largest k the search of aq.h is checked for, one k at a time and in multi
+ * mode. A wrap-around 4x4 board takes minutes for k above this.
+ */
+#define CHECK_SEARCH_MAX_K 5
+
+/**
+ * Largest number of nodes after which a search is stopped to check the bound
+ * it leaves.
+ */
+#define CHECK_STOP_NODES 64
+
+/**
+ * Number of shards, and the depth they are split at, when the search of
+ * aq.h is checked split into shards.
+ */
+#define CHECK_SHARDS 3
+#define CHECK_SHARD_DEPTH 2
+
+/**
+ * Number of mismatches printed before the rest are only counted.
+ */
+#define CHECK_MAX_REPORTS 32
+
+/**
+ * Most queens of a solution on a wrap-around board of each size from 2 and
+ * each k up to CHECK_SEARCH_MAX_K, with every attack counted on the torus.
+ * Counting some of them on the plane instead, as findAQ once did, gives 6
+ * queens for N = 4 and k = 2.
+ */
+static const int WRAP_MAX_QUEENS[CHECK_BRUTE_FORCE_SIZE - 1]
+        [CHECK_SEARCH_MAX_K + 1] = {
+    { 1, 2, 3, 4, 0, 0 },
+    { 1, 2, 3, 4, 5, 6 },
+    { 2, 4, 4, 6, 8, 8 }
+};
+
+/**
+ * Densities of the random boards, in percent.
+ */
+static const int DENSITIES[] = { 3, 10, 25, 50, 75, 95 };
+
+/**
+ * The eight directions of a queen.
+ */
+static const int DIRECTIONS[8][2] = {
+    { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, -1 },
+    { 0, 1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }
+};
+
+static int num_failures = 0;
+static long num_checks = 0;
+
+/**
+ * Counts the attacks a queen on an empty cell would receive, by walking
+ * every ray until it meets a queen. On a wrap-around board the rays go
+ * around the whole torus, and a queen seen from two directions only attacks
+ * once. Returns -1 for an occupied cell, like board_cell_count_attacks.
+ */
+static
+int referenceCountAttacks(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col, int wrap) {
+    int N = geometry->size;
+    int seen[8];
+    int num_seen = 0;
+    int r, c, cell;
+    int duplicate;
+
+    if (board_is_occupied(board, geometry, row, col)) {
+        return -1;
+    }
+
+    for (int d = 0; d < 8; ++d) {
+        r = row;
+        c = col;
+        for (int step = 1; step < N || (!wrap && step <= N); ++step) {
+            r += DIRECTIONS[d][0];
+            c += DIRECTIONS[d][1];
+            if (wrap) {
+                r = (r + N) % N;
+                c = (c + N) % N;
+            } else if (r < 0 || r >= N || c < 0 || c >= N) {
+                break;
+            }
+
+            if (!board_is_occupied(board, geometry, r, c)) {
+                continue;
+            }
+
+            cell = r * N + c;
+            duplicate = 0;
+            for (int i = 0; i < num_seen; ++i) {
+                duplicate |= seen[i] == cell;
+            }
+
+            if (!duplicate) {
+                seen[num_seen++] = cell;
+            }
+
+            break;
+        }
+    }
+
+    return num_seen;
+}
+
+/**
+ * Returns the attacks on the queen of an occupied cell.
+ */
+static
+int referenceQueenAttacks(struct aq_board *board,
+        const struct aq_geometry *geometry, int row, int col, int wrap) {
+    struct aq_board without = *board;
+
+    board_set_unoccupied(&without, geometry, row, col);
+    return referenceCountAttacks(&without, geometry, row, col, wrap);
+}
+
+/**
+ * Returns the most attacks on any queen, and whether every queen receives
+ * the same number in same.
+ */
+static
+int referenceMaxAttacks(struct aq_board *board,
+        const struct aq_geometry *geometry, int wrap, int *same) {
+    int max_attacks = 0;
+    int first = -1;
+    int attacks;
+
+    *same = 1;
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (!board_is_occupied(board, geometry, i, j)) {
+                continue;
+            }
+
+            attacks = referenceQueenAttacks(board, geometry, i, j, wrap);
+            if (first == -1) {
+                first = attacks;
+            }
+
+            *same &= attacks == first;
+            if (attacks > max_attacks) {
+                max_attacks = attacks;
+            }
+        }
+    }
+
+    return max_attacks;
+}
+
+/**
+ * Reports a mismatch between a kernel and the reference.
+ */
+static
+void checkEqual(const char *kernel, struct aq_board *board,
+        const struct aq_geometry *geometry, int wrap, int row, int col,
+        int expected, int actual) {
+    num_checks++;
+    if (expected == actual) {
+        return;
+    }
+
+    if (++num_failures > CHECK_MAX_REPORTS) {
+        return;
+    }
+
+    fprintf(stderr, "%s: N = %d, w = %d, cell (%d, %d): expected %d, got %d "
+            "on board ", kernel, geometry->size, wrap, row, col, expected,
+            actual);
+    for (int i = 0; i < geometry->size; ++i) {
+        for (int j = 0; j < geometry->size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
+                fprintf(stderr, "%d,", i * geometry->size + j);
+            }
+        }
+    }
+
+    fprintf(stderr, "\n");
+}
+
+/**
+ * Checks every kernel on a board. k is the bound the candidates are checked
+ * for.
+ */
+static
+void checkBoard(struct aq_board *board, struct aq_planes_geometry *planes,
+        int wrap, int k) {
+    const struct aq_geometry *geometry = &planes->board;
+    struct aq_planes_attacks attacks;
+    struct aq_batch_parent parent;
+    struct aq_board candidates;
+    struct aq_board with;
+    int rows[AQ_BOARD_MAX_CELLS];
+    int cols[AQ_BOARD_MAX_CELLS];
+    int cell_attacks[AQ_BOARD_MAX_CELLS];
+    int batch_max[AQ_BOARD_MAX_CELLS];
+    int batch_same[AQ_BOARD_MAX_CELLS];
+    int num_cells = 0;
+    int N = geometry->size;
+    int max_attacks;
+    int same;
+    int with_same;
+    int expected;
+    int legal;
+
+    max_attacks = referenceMaxAttacks(board, geometry, wrap, &same);
+    checkEqual(wrap ? "board_max_attacks_wrap" : "board_max_attacks", board,
+            geometry, wrap, -1, -1, max_attacks, wrap ?
+            board_max_attacks_wrap(board, geometry) :
+            board_max_attacks(board, geometry));
+    checkEqual(wrap ? "board_all_has_same_attacks_wrap" :
+            "board_all_has_same_attacks", board, geometry, wrap, -1, -1,
+            same, (wrap ?
+                board_all_has_same_attacks_wrap(board, geometry) :
+                board_all_has_same_attacks(board, geometry)) != 0);
+
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            expected = referenceCountAttacks(board, geometry, i, j, wrap);
+            checkEqual(wrap ? "board_cell_count_attacks_wrap" :
+                    "board_cell_count_attacks", board, geometry, wrap, i, j,
+                    expected, wrap ?
+                    board_cell_count_attacks_wrap(board, geometry, i, j) :
+                    board_cell_count_attacks(board, geometry, i, j));
+        }
+    }
+
+    // Every empty cell makes a sibling for the batch.
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            if (!board_is_occupied(board, geometry, i, j)) {
+                rows[num_cells] = i;
+                cols[num_cells] = j;
+                cell_attacks[num_cells] = referenceCountAttacks(board,
+                        geometry, i, j, wrap);
+                num_cells++;
+            }
+        }
+    }
+
+    batch_parent_init(&parent, board, geometry, wrap);
+    batch_simulate(&parent, rows, cols, cell_attacks, num_cells, batch_max,
+            batch_same);
+    for (int i = 0; i < num_cells; ++i) {
+        with = *board;
+        board_set_occupied(&with, geometry, rows[i], cols[i]);
+        expected = referenceMaxAttacks(&with, geometry, wrap, &with_same);
+        checkEqual("batch_simulate", board, geometry, wrap, rows[i], cols[i],
+                expected, batch_max[i]);
+        checkEqual("batch_simulate same", board, geometry, wrap, rows[i],
+                cols[i], with_same, batch_same[i]);
+    }
+
+    if (wrap) {
+        return;
+    }
+
+    planes_attacks(board, planes, &attacks);
+    checkEqual("planes_uniform_attacks", board, geometry, wrap, -1, -1,
+            same ? max_attacks : -1,
+            planes_uniform_attacks(board, planes, &attacks));
+
+    // The planes count, for an occupied cell, the attacks on its queen, and
+    // only give the candidates if no queen is already attacked more than k
+    // times.
+    candidates = planes_candidates(board, k, planes, &attacks);
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
+                expected = referenceQueenAttacks(board, geometry, i, j, 0);
+                legal = 0;
+            } else {
+                expected = referenceCountAttacks(board, geometry, i, j, 0);
+                with = *board;
+                board_set_occupied(&with, geometry, i, j);
+                legal = max_attacks <= k &&
+                    referenceMaxAttacks(&with, geometry, 0, &same) <= k;
+                checkEqual("board_simulate_max_attacks", board, geometry,
+                        wrap, i, j,
+                        referenceMaxAttacks(&with, geometry, 0, &same),
+                        board_simulate_max_attacks(board, geometry, i, j));
+            }
+
+            checkEqual("planes_attacks", board, geometry, wrap, i, j,
+                    expected, planes_get(&attacks.counters, i, j, planes));
+            checkEqual("planes_candidates", board, geometry, wrap, i, j,
+                    legal,
+                    board_is_occupied(&candidates, geometry, i, j) != 0);
+        }
+    }
+}
+
+/**
+ * Checks the kernels that fill a whole row or column against one set cell by
+ * cell. The number of bits that differ, whether on the board or past its
+ * last cell, must be zero.
+ */
+static
+void checkLines(const struct aq_geometry *geometry) {
+    struct aq_board expected;
+    struct aq_board actual;
+    int N = geometry->size;
+    int differ;
+
+    for (int line = 0; line < N; ++line) {
+        for (int col = 0; col <= 1; ++col) {
+            expected = board_new();
+            actual = board_new();
+            for (int i = 0; i < N; ++i) {
+                board_set_occupied(&expected, geometry, col ? i : line,
+                        col ? line : i);
+            }
+
+            if (col) {
+                board_set_col_occupied(&actual, geometry, line);
+            } else {
+                board_set_row_occupied(&actual, geometry, line);
+            }
+
+            differ = 0;
+            for (int i = 0; i < AQ_BOARD_SLICES; ++i) {
+                differ += __builtin_popcountll(expected.slices[i] ^
+                        actual.slices[i]);
+            }
+
+            checkEqual(col ? "board_set_col_occupied" :
+                    "board_set_row_occupied", &actual, geometry, 0,
+                    col ? -1 : line, col ? line : -1, 0, differ);
+        }
+    }
+}
+
+/**
+ * Checks the kernels on random and adversarial boards of every size.
+ */
+static
+void checkKernels() {
+    struct aq_planes_geometry planes;
+    struct aq_geometry *geometry = &planes.board;
+    struct aq_board board;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    int num_densities = sizeof(DENSITIES) / sizeof(DENSITIES[0]);
+    int N;
+
+    for (N = 2; N <= CHECK_MAX_SIZE; ++N) {
+        planes_geometry_init(&planes, N);
+        checkLines(geometry);
+        for (int wrap = 0; wrap <= 1; ++wrap) {
+            // Empty and full boards.
+            board = board_new();
+            checkBoard(&board, &planes, wrap, 0);
+            board = geometry->all;
+            checkBoard(&board, &planes, wrap, AQ_MAX_ATTACKS);
+
+            // A lone queen on every cell, which takes in every corner and
+            // both sides of every slice boundary.
+            for (int cell = 0; cell < N * N; ++cell) {
+                board = board_new();
+                board_set_occupied(&board, geometry, cell / N, cell % N);
+                checkBoard(&board, &planes, wrap, cell % 3);
+            }
+
+            // Whole rows, columns and both main diagonals, and the
+            // checkerboard.
+            for (int i = 0; i < N; ++i) {
+                board = board_new();
+                for (int j = 0; j < N; ++j) {
+                    board_set_occupied(&board, geometry, i, j);
+                }
+
+                checkBoard(&board, &planes, wrap, 2);
+                board = board_new();
+                for (int j = 0; j < N; ++j) {
+                    board_set_occupied(&board, geometry, j, i);
+                }
+
+                checkBoard(&board, &planes, wrap, 2);
+            }
+
+            board = board_new();
+            for (int i = 0; i < N; ++i) {
+                board_set_occupied(&board, geometry, i, i);
+                board_set_occupied(&board, geometry, i, N - 1 - i);
+            }
+
+            checkBoard(&board, &planes, wrap, 4);
+            board = board_new();
+            for (int cell = 0; cell < N * N; ++cell) {
+                if ((cell / N + cell % N) % 2 == 0) {
+                    board_set_occupied(&board, geometry, cell / N, cell % N);
+                }
+            }
+
+            checkBoard(&board, &planes, wrap, 4);
+
+            // Random boards of every density.
+            for (int b = 0; b < CHECK_RANDOM_BOARDS; ++b) {
+                board = board_new();
+                for (int cell = 0; cell < N * N; ++cell) {
+                    if ((int) (aq_random(&state) % 100) <
+                        DENSITIES[b % num_densities]) {
+                        board_set_occupied(&board, geometry, cell / N,
+                                cell % N);
+                    }
+                }
+
+                checkBoard(&board, &planes, wrap,
+                        aq_random(&state) % (AQ_MAX_ATTACKS + 1));
+            }
+        }
+    }
+}
+
+/**
+ * The solutions a search is expected to find for every k: the maximum, and
+ * one flag for every subset of the cells telling whether it is a solution
+ * with that many queens.
+ */
+struct check_expected {
+    int max_queens[AQ_MAX_ATTACKS + 1];
+    char *boards[AQ_MAX_ATTACKS + 1];
+};
+
+/**
+ * The state of referencePlaceable: the queens of the board, and for every
+ * set of queens placed and last queen, whether that was found to be a dead
+ * end.
+ */
+struct check_placement {
+    int num_queens;
+    int rows[CHECK_BRUTE_FORCE_SIZE * CHECK_BRUTE_FORCE_SIZE];
+    int cols[CHECK_BRUTE_FORCE_SIZE * CHECK_BRUTE_FORCE_SIZE];
+    char *dead;
+};
+
+/**
+ * Returns non-zero if the queens not in placed can follow the last one.
+ */
+static
+int referencePlaceFrom(struct check_placement *placement, unsigned placed,
+        int last) {
+    int n = placement->num_queens;
+
+    if (placed == (1u << n) - 1) {
+        return 1;
+    }
+
+    if (placement->dead[placed * n + last]) {
+        return 0;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (!(placed & 1u << i) &&
+            placement->rows[i] != placement->rows[last] &&
+            placement->cols[i] != placement->cols[last] &&
+            referencePlaceFrom(placement, placed | 1u << i, i)) {
+            return 1;
+        }
+    }
+
+    placement->dead[placed * n + last] = 1;
+    return 0;
+}
+
+/**
+ * Returns non-zero if the search of aq.h can reach a board at all.
+ *
+ * That search does not enumerate sets of cells: it starts from the first
+ * queen of a task, which is on a cell of aq_task_move, or (0, 0) on a
+ * wrap-around board, and never puts a queen on the row or column of the
+ * queen placed just before. Boards with too many of their queens on one
+ * line, such as three queens of a 2x2 board, cannot be ordered that way and
+ * are never found. The profile and join engines have no such limit.
+ */
+static
+int referencePlaceable(struct aq_board *board,
+        const struct aq_geometry *geometry, int wrap) {
+    struct check_placement placement;
+    int N = geometry->size;
+    int placeable = 0;
+
+    placement.num_queens = 0;
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
+                placement.rows[placement.num_queens] = i;
+                placement.cols[placement.num_queens++] = j;
+            }
+        }
+    }
+
+    placement.dead = calloc((size_t) placement.num_queens <<
+            placement.num_queens, 1);
+    for (int i = 0; i < placement.num_queens && !placeable; ++i) {
+        if (wrap ? placement.rows[i] == 0 && placement.cols[i] == 0 :
+                   placement.rows[i] + placement.cols[i] < N) {
+            placeable = referencePlaceFrom(&placement, 1u << i, i);
+        }
+    }
+
+    free(placement.dead);
+    return placeable;
+}
+
+/**
+ * Records a solution with num_queens queens for k, given as the subset of
+ * the cells it occupies.
+ */
+static
+void expectSolution(struct check_expected *expected, int k, int num_queens,
+        unsigned image, int num_cells) {
+    if (num_queens < expected->max_queens[k]) {
+        return;
+    }
+
+    if (num_queens > expected->max_queens[k]) {
+        memset(expected->boards[k], 0, (size_t) 1 << num_cells);
+        expected->max_queens[k] = num_queens;
+    }
+
+    expected->boards[k][image] = 1;
+}
+
+/**
+ * Returns the subset of the cells a board occupies.
+ */
+static inline
+unsigned checkImage(struct aq_board *board,
+        const struct aq_geometry *geometry) {
+    unsigned image = 0;
+
+    for (int cell = 0; cell < geometry->size * geometry->size; ++cell) {
+        if (board_is_occupied(board, geometry, cell / geometry->size,
+                    cell % geometry->size)) {
+            image |= 1u << cell;
+        }
+    }
+
+    return image;
+}
+
+/**
+ * Checks the solutions a search found for every k up to max_k against those
+ * expected.
+ */
+static
+void checkSearch(const char *engine, const struct aq_geometry *geometry,
+        int wrap, int max_k, struct aq_store *solutions, int *max_queens,
+        struct check_expected *expected) {
+    int num_cells = geometry->size * geometry->size;
+    char *found = malloc((size_t) 1 << num_cells);
+    struct aq_board board = geometry->all;
+    unsigned image;
+
+    for (int k = 0; k <= max_k; ++k) {
+        board = geometry->all;
+        checkEqual(engine, &board, geometry, wrap, k, -1,
+                expected->max_queens[k], max_queens[k]);
+
+        memset(found, 0, (size_t) 1 << num_cells);
+        for (size_t i = 0; i < store_count(&solutions[k]); ++i) {
+            board = store_get(&solutions[k], i);
+            image = checkImage(&board, geometry);
+            found[image] = 1;
+            checkEqual(engine, &board, geometry, wrap, k, 1, 1,
+                    expected->boards[k][image]);
+        }
+
+        for (image = 0; image < 1u << num_cells; ++image) {
+            if (!expected->boards[k][image] || found[image]) {
+                continue;
+            }
+
+            board = board_new();
+            for (int cell = 0; cell < num_cells; ++cell) {
+                if (image & 1u << cell) {
+                    board_set_occupied(&board, geometry,
+                            cell / geometry->size, cell % geometry->size);
+                }
+            }
+
+            checkEqual(engine, &board, geometry, wrap, k, 1, 1, 0);
+        }
+    }
+
+    free(found);
+}
+
+/**
+ * Stops a search at its first progress report.
+ */
+static
+int checkStop(void *user, struct aq_progress *progress) {
+    return 1;
+}
+
+/**
+ * Checks the complete searches for every k against a brute-force
+ * enumeration of every board up to CHECK_BRUTE_FORCE_SIZE.
+ *
+ * The profile and join engines, which take normal boards only, must find
+ * every solution. The search of aq.h must find those it can reach (see
+ * referencePlaceable), kept in canonical form on a wrap-around board.
+ */
+static
+void checkSearches() {
+    struct aq_geometry geometry;
+    struct aq_params params;
+    struct aq_store solutions[AQ_MAX_ATTACKS + 1];
+    struct aq_store shard_solutions;
+    struct aq_board board;
+    struct aq_board canonical;
+    struct check_expected every;
+    struct check_expected placeable;
+    int max_queens[AQ_MAX_ATTACKS + 1];
+    int shard_max_queens;
+    struct aq_store stop_solutions[AQ_MAX_ATTACKS + 1];
+    int stop_max_queens[AQ_MAX_ATTACKS + 1];
+    struct aq_params params_k;
+    struct aq_callbacks callbacks;
+    int open_bound[AQ_MAX_ATTACKS + 1];
+    int num_cells;
+    int num_queens, attacks, same;
+
+    for (int N = 2; N <= CHECK_BRUTE_FORCE_SIZE; ++N) {
+        board_geometry_init(&geometry, N);
+        num_cells = N * N;
+        for (int wrap = 0; wrap <= 1; ++wrap) {
+            for (int k = 0; k <= AQ_MAX_ATTACKS; ++k) {
+                every.boards[k] = calloc((size_t) 1 << num_cells, 1);
+                placeable.boards[k] = calloc((size_t) 1 << num_cells, 1);
+                every.max_queens[k] = 0;
+                placeable.max_queens[k] = 0;
+            }
+
+            for (unsigned mask = 1; mask < 1u << num_cells; ++mask) {
+                board = board_new();
+                num_queens = 0;
+                for (int cell = 0; cell < num_cells; ++cell) {
+                    if (mask & 1u << cell) {
+                        board_set_occupied(&board, &geometry, cell / N,
+                                cell % N);
+                        num_queens++;
+                    }
+                }
+
+                attacks = referenceMaxAttacks(&board, &geometry, wrap, &same);
+                if (!same) {
+                    continue;
+                }
+
+                expectSolution(&every, attacks, num_queens, mask, num_cells);
+                if (num_queens >= placeable.max_queens[attacks] &&
+                    referencePlaceable(&board, &geometry, wrap)) {
+                    canonical = wrap ?
+                        symmetry_canonical(&board, &geometry, 1) : board;
+                    expectSolution(&placeable, attacks, num_queens,
+                            checkImage(&canonical, &geometry), num_cells);
+                }
+            }
+
+            for (int k = 0; k <= AQ_MAX_ATTACKS; ++k) {
+                store_init(&solutions[k], N, 0);
+                max_queens[k] = 0;
+            }
+
+            memset(&params, 0, sizeof(params));
+            params.N = N;
+            params.w = wrap;
+            params.nprocs = 1;
+
+            // No board may beat the bound the anytime mode reports.
+            for (int k = 0; k <= AQ_MAX_ATTACKS; ++k) {
+                params.k = k;
+                board = geometry.all;
+                checkEqual("aq_upper_bound", &board, &geometry, wrap, k, -1,
+                        1, aq_upper_bound(&params) >= every.max_queens[k]);
+            }
+
+            for (int k = 0; k <= CHECK_SEARCH_MAX_K; ++k) {
+                params.k = k;
+                if (aq_solve_multi(&params, NULL, &solutions[k],
+                            &max_queens[k], NULL) == -1) {
+                    perror("checkSearches");
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            checkSearch("aq_solve_multi", &geometry, wrap, CHECK_SEARCH_MAX_K,
+                    solutions, max_queens, &placeable);
+
+            // Both the reference and the search must keep to the torus. On a
+            // 2x2 torus, the search cannot reach the boards of 3 and 4 queens
+            // (see referencePlaceable).
+            for (int k = 0; k <= CHECK_SEARCH_MAX_K && wrap; ++k) {
+                board = geometry.all;
+                checkEqual("torus reference", &board, &geometry, wrap, k, -1,
+                        WRAP_MAX_QUEENS[N - 2][k], every.max_queens[k]);
+                if (N > 2) {
+                    checkEqual("aq_solve_multi torus", &board, &geometry, wrap,
+                            k, -1, WRAP_MAX_QUEENS[N - 2][k], max_queens[k]);
+                }
+            }
+
+            // A search stopped after any number of nodes must leave a bound
+            // that covers what it missed.
+            memset(&callbacks, 0, sizeof(callbacks));
+            callbacks.progress = checkStop;
+            for (int k = 0; k <= CHECK_SEARCH_MAX_K; ++k) {
+                params.k = k;
+                for (int nodes = 1; nodes <= CHECK_STOP_NODES; ++nodes) {
+                    store_init(&shard_solutions, N, 0);
+                    shard_max_queens = 0;
+                    open_bound[0] = 0;
+                    callbacks.progress_interval = nodes;
+                    if (aq_solve_multi(&params, &callbacks, &shard_solutions,
+                                &shard_max_queens, open_bound) == -1) {
+                        perror("checkSearches");
+                        exit(EXIT_FAILURE);
+                    }
+
+                    board = geometry.all;
+                    checkEqual("open_bound", &board, &geometry, wrap, k, nodes,
+                            1, shard_max_queens >= max_queens[k] ||
+                               open_bound[0] >= max_queens[k]);
+                    store_free(&shard_solutions);
+                }
+            }
+
+            // The shards together must find what the whole search does. Their
+            // stores get a budget of a single byte, so that both the boards
+            // and the index spill to files right away.
+            for (int k = 0; k <= CHECK_SEARCH_MAX_K; ++k) {
+                params.k = k;
+                params.nprocs = CHECK_SHARDS;
+                params.split_depth = CHECK_SHARD_DEPTH;
+                store_clear(&solutions[k]);
+                max_queens[k] = 0;
+                for (int shard = 0; shard < CHECK_SHARDS; ++shard) {
+                    store_init(&shard_solutions, N, 1);
+                    shard_max_queens = 0;
+                    params.rank = shard;
+                    if (aq_solve_multi(&params, NULL, &shard_solutions,
+                                &shard_max_queens, NULL) == -1) {
+                        perror("checkSearches");
+                        exit(EXIT_FAILURE);
+                    }
+
+                    if (shard_max_queens > max_queens[k]) {
+                        store_clear(&solutions[k]);
+                        max_queens[k] = shard_max_queens;
+                    }
+
+                    if (shard_max_queens == max_queens[k] &&
+                        store_merge(&solutions[k], &shard_solutions) == -1) {
+                        perror("checkSearches");
+                        exit(EXIT_FAILURE);
+                    }
+
+                    store_free(&shard_solutions);
+                }
+            }
+
+            checkSearch("aq_solve_multi shards", &geometry, wrap,
+                    CHECK_SEARCH_MAX_K, solutions, max_queens, &placeable);
+
+            // A single search for every k must find what one search for each
+            // does.
+            params.rank = 0;
+            params.nprocs = 1;
+            params.split_depth = 0;
+            params.k = CHECK_SEARCH_MAX_K;
+            params.multi = 1;
+            for (int k = 0; k <= CHECK_SEARCH_MAX_K; ++k) {
+                store_clear(&solutions[k]);
+                max_queens[k] = 0;
+            }
+
+            if (aq_solve_multi(&params, NULL, solutions, max_queens,
+                        NULL) == -1) {
+                perror("checkSearches");
+                exit(EXIT_FAILURE);
+            }
+
+            checkSearch("aq_solve_multi --all-k", &geometry, wrap,
+                    CHECK_SEARCH_MAX_K, solutions, max_queens, &placeable);
+
+            // Stopped early, the search must leave each k a bound of its own,
+            // within the upper bound for that k.
+            for (int nodes = 1; nodes <= CHECK_STOP_NODES; ++nodes) {
+                for (int k = 0; k <= CHECK_SEARCH_MAX_K; ++k) {
+                    store_init(&stop_solutions[k], N, 0);
+                    stop_max_queens[k] = 0;
+                    open_bound[k] = 0;
+                }
+
+                callbacks.progress_interval = nodes;
+                if (aq_solve_multi(&params, &callbacks, stop_solutions,
+                            stop_max_queens, open_bound) == -1) {
+                    perror("checkSearches");
+                    exit(EXIT_FAILURE);
+                }
+
+                for (int k = 0; k <= CHECK_SEARCH_MAX_K; ++k) {
+                    params_k = params;
+                    params_k.k = k;
+                    board = geometry.all;
+                    checkEqual("open_bound --all-k", &board, &geometry, wrap,
+                            k, nodes, 1,
+                            open_bound[k] <= aq_upper_bound(&params_k) &&
+                            (stop_max_queens[k] >= max_queens[k] ||
+                             open_bound[k] >= max_queens[k]));
+                    store_free(&stop_solutions[k]);
+                }
+            }
+            if (!wrap) {
+                params.k = AQ_MAX_ATTACKS;
+                if (profile_solve_multi(&params, solutions,
+                            max_queens) == -1) {
+                    perror("checkSearches");
+                    exit(EXIT_FAILURE);
+                }
+
+                checkSearch("profile_solve_multi", &geometry, wrap,
+                        AQ_MAX_ATTACKS, solutions, max_queens, &every);
+                if (join_solve_multi(&params, solutions, max_queens) == -1) {
+                    perror("checkSearches");
+                    exit(EXIT_FAILURE);
+                }
+
+                checkSearch("join_solve_multi", &geometry, wrap,
+                        AQ_MAX_ATTACKS, solutions, max_queens, &every);
+            }
+
+            for (int k = 0; k <= AQ_MAX_ATTACKS; ++k) {
+                store_free(&solutions[k]);
+            }
+
+            for (int k = 0; k <= AQ_MAX_ATTACKS; ++k) {
+                free(every.boards[k]);
+                free(placeable.boards[k]);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    checkKernels();
+    checkSearches();
+
+    printf("%s: %ld checks, %d failures\n", argv[0], num_checks,
+            num_failures);
+    return num_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* vim: set ts=4 sw=4 et: */
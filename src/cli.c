@@ -0,0 +1,856 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Command line handling shared by every findAQ driver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ctype.h>
+#include <getopt.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "aq.h"
+#include "anneal.h"
+#include "cli.h"
+#include "join.h"
+#include "profile.h"
+#include "symmetry.h"
+
+/**
+ * Optional arguments, which may appear anywhere on the command line.
+ *
+ * --target q  only decide whether a solution with at least q queens exists.
+ * --probe     find the maximum by probing targets downwards from an upper
+ *             bound.
+ * --balance n assign tasks to processes by their cost, estimated with n
+ *             random probes per task, instead of round-robin. MPI build
+ *             only.
+ * --memory m  keep at most m MiB of solutions, their index included, in
+ *             memory per process, and spill the rest to a file in $TMPDIR.
+ * --heartbeat s
+ *             print a summary of the progress of every process to stderr
+ *             every s seconds.
+ * --all-k     solve every k from 0 to k in a single search, printing one
+ *             result for each.
+ * --order o   try moves following the policy named o: row-major (the
+ *             default), constrained, fewest-attacks or center.
+ * --anneal s  spend s seconds on a local search first, whose best solution
+ *             is a lower bound for the exact search.
+ * --quick     only print the best solution of the local search, which need
+ *             not be maximal. It runs for AQ_ANNEAL_SECONDS unless --anneal
+ *             says otherwise.
+ * --time-limit s
+ *             stop searching after s seconds, printing the best solutions
+ *             found so far, followed by a proven upper bound for each k.
+ * --daemon p  serve queries over a Unix-domain socket at path p instead of
+ *             solving a single instance, in which case N, k, l and w are not
+ *             given. See daemon.h.
+ * --engine e  solve with the engine named e: dfs (the default), profile
+ *             (see profile.h) or join (see join.h). The latter two take
+ *             normal boards only.
+ * --trace p   record trace events and write those of each process to p.rank
+ *             at exit, on a crash and on SIGUSR1. Decode them with aqtrace.
+ *             See trace.h.
+ * --output f  write the solutions to the file f instead of stdout. The MPI
+ *             build spreads the solutions over every process, which each
+ *             format and write their own share, so lines may come in any
+ *             order.
+ * --shard i/n solve only the i-th of n shards of the search, in this process
+ *             alone and without MPI, and write a partial result to the file
+ *             given with --output. findAQ merge combines the partial results
+ *             of every shard. See shard.h.
+ * --shard-depth d
+ *             with --shard, split the nodes at depth d of the search into
+ *             shards, rather than its tasks.
+ * --orbits    print a single line for every orbit of solutions under the
+ *             symmetries of the board (see symmetry.h), as
+ *
+ *                 N,k:queens:size,w:cells
+ *
+ *             where size is the number of solutions in the orbit, and cells
+ *             is a representative in hex, four cells to a digit in
+ *             row-major order, the first cell in the lowest bit. aqexpand
+ *             turns these back into a line per solution. On a normal board,
+ *             only the profile and join engines find whole orbits, so it
+ *             needs one of them there.
+ * --perf      count cycles, instructions, branch and cache misses, and
+ *             time, in every phase of the search (see perf.h), and print
+ *             them to stderr at exit for every process, or thread, and in
+ *             total. Needs a build with configure --enable-perf, as
+ *             ./build.sh perf does.
+ */
+static const struct option LONG_OPTIONS[] = {
+    { "target", required_argument, NULL, 't' },
+    { "probe", no_argument, NULL, 'p' },
+    { "balance", required_argument, NULL, 'b' },
+    { "memory", required_argument, NULL, 'm' },
+    { "heartbeat", required_argument, NULL, 'H' },
+    { "all-k", no_argument, NULL, 'a' },
+    { "order", required_argument, NULL, 'o' },
+    { "anneal", required_argument, NULL, 'A' },
+    { "quick", no_argument, NULL, 'q' },
+    { "time-limit", required_argument, NULL, 'T' },
+    { "daemon", required_argument, NULL, 'D' },
+    { "engine", required_argument, NULL, 'e' },
+    { "trace", required_argument, NULL, 'r' },
+    { "output", required_argument, NULL, 'O' },
+    { "shard", required_argument, NULL, 's' },
+    { "shard-depth", required_argument, NULL, 'S' },
+    { "orbits", no_argument, NULL, 'c' },
+    { "perf", no_argument, NULL, 'P' },
+    { NULL, 0, NULL, 0 }
+};
+
+/**
+ * We need more stack size than the default.
+ */
+void expandStackSize() {
+    // Set to 64MB.
+    const rlim_t stack_size = 64L * 1024L * 1024L;
+    struct rlimit rl;
+    int result;
+
+    result = getrlimit(RLIMIT_STACK, &rl);
+    if (result == 0) {
+        if (rl.rlim_cur < stack_size) {
+            rl.rlim_cur = stack_size;
+            result = setrlimit(RLIMIT_STACK, &rl);
+            if (result != 0) {
+                fprintf(stderr, "%s: Failed to increase stack size (errno %d)\n",
+                        "expandStackSize", result);
+            }
+        }
+    } else {
+        fprintf(stderr, "%s: Failed to increase stack size (errno %d)\n",
+                "expandStackSize", result);
+    }
+}
+
+/**
+ * Reads the arguments for the program.
+ */
+int readProgramArgs(int argc, char* argv[], struct program_args* program_args) {
+    assert(program_args != NULL);
+    errno = 0;
+    int option;
+
+    program_args->target = 0;
+    program_args->probe = 0;
+    program_args->balance = 0;
+    program_args->memory = 0;
+    program_args->heartbeat = 0;
+    program_args->all_k = 0;
+    program_args->order = AQ_ORDER_ROW_MAJOR;
+    program_args->anneal = 0;
+    program_args->quick = 0;
+    program_args->time_limit = 0;
+    program_args->daemon = NULL;
+    program_args->engine = ENGINE_DFS;
+    program_args->trace = NULL;
+    program_args->output = NULL;
+    program_args->shard = 0;
+    program_args->num_shards = 0;
+    program_args->shard_depth = 0;
+    program_args->orbits = 0;
+    program_args->perf = 0;
+
+    // Read the optional arguments first. GNU getopt moves them out of the way
+    // of the positional ones.
+    while ((option = getopt_long(argc, argv, "t:pb:m:H:ao:A:qT:D:e:r:O:s:S:cP", LONG_OPTIONS, NULL)) != -1) {
+        switch (option) {
+        case 't':
+            program_args->target = strtol(optarg, NULL, 0);
+            if (errno || program_args->target <= 0) {
+                fprintf(stderr, "Target must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'p':
+            program_args->probe = 1;
+            break;
+        case 'b':
+#ifdef AQ_THREADS
+            // Threads take the next task as they finish one, so there is
+            // no static assignment to balance.
+            fprintf(stderr, "--balance needs the MPI build.\n");
+            return EXIT_ARGS_INVALID;
+#else
+            program_args->balance = strtol(optarg, NULL, 0);
+            if (errno || program_args->balance <= 0) {
+                fprintf(stderr, "Number of probes must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+#endif
+        case 'm':
+            program_args->memory = strtol(optarg, NULL, 0) * 1024L * 1024L;
+            if (errno || program_args->memory <= 0) {
+                fprintf(stderr, "Memory budget must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'H':
+            program_args->heartbeat = strtol(optarg, NULL, 0);
+            if (errno || program_args->heartbeat <= 0) {
+                fprintf(stderr, "Heartbeat must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'a':
+            program_args->all_k = 1;
+            break;
+        case 'o':
+            program_args->order = aq_order_from_name(optarg);
+            if (program_args->order == -1) {
+                fprintf(stderr, "Order must be one of row-major, constrained, "
+                        "fewest-attacks or center.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'A':
+            program_args->anneal = strtod(optarg, NULL);
+            if (errno || program_args->anneal <= 0) {
+                fprintf(stderr, "Annealing time must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'q':
+            program_args->quick = 1;
+            break;
+        case 'D':
+            program_args->daemon = optarg;
+            break;
+        case 'T':
+            program_args->time_limit = strtod(optarg, NULL);
+            if (errno || program_args->time_limit <= 0) {
+                fprintf(stderr, "Time limit must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'e':
+            if (!strcmp(optarg, "dfs")) {
+                program_args->engine = ENGINE_DFS;
+            } else if (!strcmp(optarg, "profile")) {
+                program_args->engine = ENGINE_PROFILE;
+            } else if (!strcmp(optarg, "join")) {
+                program_args->engine = ENGINE_JOIN;
+            } else {
+                fprintf(stderr, "Engine must be one of dfs, profile or "
+                        "join.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'r':
+            program_args->trace = optarg;
+            break;
+        case 'O':
+            program_args->output = optarg;
+            break;
+        case 's':
+            if (sscanf(optarg, "%d/%d", &program_args->shard,
+                        &program_args->num_shards) != 2 ||
+                program_args->num_shards <= 0 || program_args->shard < 0 ||
+                program_args->shard >= program_args->num_shards) {
+                fprintf(stderr, "Shard must be i/n with 0 <= i < n.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'S':
+            program_args->shard_depth = strtol(optarg, NULL, 0);
+            if (errno || program_args->shard_depth <= 0) {
+                fprintf(stderr, "Shard depth must be larger than 0.\n");
+                return EXIT_ARGS_INVALID;
+            }
+            break;
+        case 'c':
+            program_args->orbits = 1;
+            break;
+        case 'P':
+#ifdef AQ_PERF
+            program_args->perf = 1;
+            break;
+#else
+            fprintf(stderr, "--perf needs a build with configure "
+                    "--enable-perf.\n");
+            return EXIT_ARGS_INVALID;
+#endif
+        default:
+            return EXIT_ARGS_INVALID;
+        }
+    }
+
+    // Queries come and go, so there is no end to report the counts at.
+    if (program_args->daemon && program_args->perf) {
+        fprintf(stderr, "--perf cannot be used with --daemon.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    // The instances come from the queries.
+    if (program_args->daemon && argc == optind) {
+        return EXIT_OK;
+    }
+
+    if (argc - optind + 1 != NUM_REQUIRED_ARGS) {
+        fprintf(stderr, "%s: Exactly %d arguments (N, k, l, w) are required.\n",
+                argv[0], NUM_REQUIRED_ARGS);
+        return EXIT_NUM_ARGS_INCORRECT;
+    }
+
+    // Set variable names.
+    argv += optind - 1;
+    program_args->N = strtol(argv[1], NULL, 0);
+    if (errno) {
+        fprintf(stderr, "Error converting 1st argument: %s\n", strerror(errno));
+        return EXIT_ARGS_INVALID;
+    }
+
+    program_args->k = strtol(argv[2], NULL, 0);
+    if (errno) {
+        fprintf(stderr, "Error converting 2nd argument: %s\n", strerror(errno));
+        return EXIT_ARGS_INVALID;
+    }
+
+    program_args->l = strtol(argv[3], NULL, 0);
+    if (errno) {
+        fprintf(stderr, "Error converting 3rd argument: %s\n", strerror(errno));
+        return EXIT_ARGS_INVALID;
+    }
+
+    program_args->w = strtol(argv[4], NULL, 0);
+    if (errno) {
+        fprintf(stderr, "Error converting 4th argument: %s\n", strerror(errno));
+        return EXIT_ARGS_INVALID;
+    }
+
+    // Check if the values are sane.
+    if (program_args->N <= 1) {
+        fprintf(stderr, "N must be equal or larger than 3.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->k < 0) {
+        fprintf(stderr, "k must be equals to or larger than 0.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->target && program_args->probe) {
+        fprintf(stderr, "--target and --probe cannot be used together.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->all_k && (program_args->target || program_args->probe)) {
+        fprintf(stderr, "--all-k cannot be used with --target or --probe.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->anneal && program_args->target) {
+        fprintf(stderr, "--anneal cannot be used with --target.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->quick && (program_args->target ||
+                program_args->probe || program_args->all_k)) {
+        fprintf(stderr, "--quick cannot be used with --target, --probe or "
+                "--all-k.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->time_limit && (program_args->target ||
+                program_args->probe || program_args->quick)) {
+        fprintf(stderr, "--time-limit cannot be used with --target, --probe "
+                "or --quick.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->output && (program_args->target ||
+                program_args->probe || program_args->quick)) {
+        fprintf(stderr, "--output cannot be used with --target, --probe or "
+                "--quick.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->num_shards && (program_args->target ||
+                program_args->probe || program_args->quick ||
+                program_args->anneal || program_args->time_limit ||
+                program_args->heartbeat || program_args->daemon)) {
+        fprintf(stderr, "--shard cannot be used with --target, --probe, "
+                "--quick, --anneal, --time-limit, --heartbeat or --daemon.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->orbits && (program_args->target ||
+                program_args->probe || program_args->num_shards)) {
+        fprintf(stderr, "--orbits cannot be used with --target, --probe or "
+                "--shard, but findAQ merge takes it.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    // On a normal board, the search of aq.h does not reach every image of a
+    // solution, so its solutions do not make up whole orbits.
+    if (program_args->orbits && !program_args->w &&
+        program_args->engine == ENGINE_DFS) {
+        fprintf(stderr, "--orbits needs w, or --engine profile or join.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->perf && program_args->num_shards) {
+        fprintf(stderr, "--perf cannot be used with --shard.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->num_shards && !program_args->output) {
+        fprintf(stderr, "--shard needs --output for its partial result.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->shard_depth && (!program_args->num_shards ||
+                program_args->engine != ENGINE_DFS)) {
+        fprintf(stderr, "--shard-depth needs --shard, and cannot be used "
+                "with --engine profile or join.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->engine != ENGINE_DFS && (program_args->w ||
+                program_args->target || program_args->probe ||
+                program_args->quick || program_args->anneal ||
+                program_args->heartbeat || program_args->time_limit)) {
+        fprintf(stderr, "--engine profile or join cannot be used with w, "
+                "--target, --probe, --quick, --anneal, --heartbeat or "
+                "--time-limit.\n");
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->engine == ENGINE_PROFILE &&
+        program_args->N > AQ_PROFILE_MAX_SIZE) {
+        fprintf(stderr, "--engine profile takes N up to %d.\n",
+                AQ_PROFILE_MAX_SIZE);
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->engine == ENGINE_JOIN &&
+        program_args->N > AQ_JOIN_MAX_SIZE) {
+        fprintf(stderr, "--engine join takes N up to %d.\n",
+                AQ_JOIN_MAX_SIZE);
+        return EXIT_ARGS_INVALID;
+    }
+
+    if (program_args->quick && !program_args->anneal) {
+        program_args->anneal = AQ_ANNEAL_SECONDS;
+    }
+
+    return EXIT_OK;
+}
+
+/**
+ * Formats arguments back into a command line, giving the options that differ
+ * from their defaults in a fixed order, so that the same instance always
+ * gives the same line. Returns the length of the line, as snprintf.
+ */
+int formatProgramArgs(struct program_args *args, char *line, size_t size) {
+    char options[256] = "";
+    size_t length = 0;
+
+    if (args->target) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--target %d ", args->target);
+    }
+
+    if (args->probe) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--probe ");
+    }
+
+    if (args->balance) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--balance %d ", args->balance);
+    }
+
+    if (args->memory) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--memory %ld ", args->memory / (1024L * 1024L));
+    }
+
+    if (args->heartbeat) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--heartbeat %d ", args->heartbeat);
+    }
+
+    if (args->all_k) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--all-k ");
+    }
+
+    if (args->order != AQ_ORDER_ROW_MAJOR) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--order %s ", aq_order_name(args->order));
+    }
+
+    if (args->anneal) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--anneal %g ", args->anneal);
+    }
+
+    if (args->quick) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--quick ");
+    }
+
+    if (args->time_limit) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--time-limit %g ", args->time_limit);
+    }
+
+    if (args->engine != ENGINE_DFS) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--engine %s ", args->engine == ENGINE_JOIN ? "join" :
+                "profile");
+    }
+
+    if (args->orbits) {
+        length += snprintf(options + length, sizeof(options) - length,
+                "--orbits ");
+    }
+
+    return snprintf(line, size, "%s%d %d %d %d", options, args->N, args->k,
+            args->l, args->w);
+}
+
+/**
+ * Formats the line of a single solution into line, which must have room for
+ * SOLUTION_LINE_MAX characters. Returns the length of the line.
+ */
+static
+int formatSolution(char *line, struct aq_board *solution,
+        struct aq_geometry *geometry, int max_queens,
+        struct program_args *args) {
+    int length;
+
+    length = sprintf(line, "%d,%d:%d:", args->N, args->k, max_queens);
+    for (int j = 0; j < args->N; ++j) {
+        for (int k = 0; k < args->N; ++k) {
+            if (board_is_occupied(solution, geometry, j, k)) {
+                length += sprintf(line + length, "%d,", j * args->N + k);
+            }
+        }
+    }
+
+    line[length++] = '\n';
+    line[length] = '\0';
+    return length;
+}
+
+/**
+ * Formats the line of an orbit of num_images solutions into line, which
+ * must have room for SOLUTION_LINE_MAX characters. Returns the length of the
+ * line.
+ */
+static
+int formatOrbit(char *line, struct aq_board *representative,
+        struct aq_geometry *geometry, int num_images, int max_queens,
+        struct program_args *args) {
+    static const char DIGITS[] = "0123456789abcdef";
+    int num_cells = args->N * args->N;
+    int length;
+    int digit;
+
+    length = sprintf(line, "%d,%d:%d:%d,%d:", args->N, args->k, max_queens,
+            num_images, args->w);
+    for (int i = 0; i < num_cells; i += 4) {
+        digit = 0;
+        for (int j = i; j < i + 4 && j < num_cells; ++j) {
+            if (board_is_occupied(representative, geometry, j / args->N,
+                        j % args->N)) {
+                digit |= 1 << (j - i);
+            }
+        }
+
+        line[length++] = DIGITS[digit];
+    }
+
+    line[length++] = '\n';
+    line[length] = '\0';
+    return length;
+}
+
+/**
+ * Reads a line written with --orbits into representative, and the numbers
+ * of the instance it belongs to into args. Returns 0, or -1 if line is not
+ * such a line.
+ */
+int parseOrbit(const char *line, struct aq_board *representative,
+        struct program_args *args, int *max_queens, int *num_images) {
+    struct aq_geometry geometry;
+    int num_cells;
+    int offset = 0;
+    int digit;
+
+    if (sscanf(line, "%d,%d:%d:%d,%d:%n", &args->N, &args->k, max_queens,
+                num_images, &args->w, &offset) != 5 || !offset ||
+        args->N < 1 || args->N * args->N > AQ_BOARD_MAX_CELLS ||
+        (args->w != 0 && args->w != 1)) {
+        return -1;
+    }
+
+    num_cells = args->N * args->N;
+    board_geometry_init(&geometry, args->N);
+    *representative = board_new();
+    for (int i = 0; i < num_cells; i += 4) {
+        if (!isxdigit((unsigned char) line[offset])) {
+            return -1;
+        }
+
+        digit = isdigit((unsigned char) line[offset]) ? line[offset] - '0' :
+            tolower((unsigned char) line[offset]) - 'a' + 10;
+        offset++;
+        for (int j = i; j < i + 4 && j < num_cells; ++j) {
+            if (digit >> (j - i) & 1) {
+                board_set_occupied(representative, &geometry, j / args->N,
+                        j % args->N);
+            }
+        }
+    }
+
+    return line[offset] == '\n' || line[offset] == '\0' ? 0 : -1;
+}
+
+/**
+ * Formats the lines of every solution of a store, handing them one at a
+ * time to emit along with user.
+ *
+ * Solutions on a wrap-around board are only kept in their canonical form, so
+ * they are expanded back into their orbits here. With --orbits, only the
+ * canonical form of every orbit gets a line instead. The profile and join
+ * engines find every image of a normal board, possibly spread over
+ * processes, so the other images are skipped.
+ */
+void formatSolutions(struct aq_store *solutions, int max_queens,
+        struct program_args *args,
+        void (*emit)(void*, const char*, int), void *user) {
+    struct aq_geometry geometry;
+    struct aq_board solution;
+    struct aq_board orbit[AQ_SYMMETRY_MAX_ORBIT];
+    char line[SOLUTION_LINE_MAX];
+    int num_images;
+
+    board_geometry_init(&geometry, args->N);
+
+    for (size_t i = 0; i < store_count(solutions); ++i) {
+        solution = store_get(solutions, i);
+        if (args->orbits) {
+            num_images = symmetry_orbit(&solution, &geometry, args->w, orbit);
+            if (boards_are_equal(&orbit[0], &solution, &geometry)) {
+                emit(user, line, formatOrbit(line, &solution, &geometry,
+                            num_images, max_queens, args));
+            }
+
+            continue;
+        }
+
+        if (args->w) {
+            num_images = symmetry_orbit(&solution, &geometry, 1, orbit);
+        } else {
+            orbit[0] = solution;
+            num_images = 1;
+        }
+
+        for (int m = 0; m < num_images; ++m) {
+            emit(user, line, formatSolution(line, &orbit[m], &geometry,
+                        max_queens, args));
+        }
+    }
+}
+
+/**
+ * Prints a line to stdout, for formatSolutions.
+ */
+static
+void printLine(void *user, const char *line, int length) {
+    fwrite(line, 1, length, stdout);
+}
+
+/**
+ * Prints the solutions of a run, which must already be free of duplicates.
+ */
+void printSolutions(struct aq_store *solutions, int max_queens,
+        struct program_args *args) {
+    if (!args->l || store_count(solutions) == 0) {
+        printf("%d,%d:%d:\n", args->N, args->k, max_queens);
+        return;
+    }
+
+    formatSolutions(solutions, max_queens, args, printLine, NULL);
+}
+
+/**
+ * Prints the result of a target or probe run.
+ *
+ * A missing witness for a target q is printed as "<q" in place of the number
+ * of queens.
+ */
+void printWitness(int num_queens, struct aq_board *witness,
+        struct program_args *args) {
+    if (!num_queens && args->target) {
+        printf("%d,%d:<%d:\n", args->N, args->k, args->target);
+        return;
+    }
+
+    printf("%d,%d:%d:", args->N, args->k, num_queens);
+    if (args->l && num_queens) {
+        struct aq_geometry geometry;
+        board_geometry_init(&geometry, args->N);
+
+        for (int j = 0; j < args->N; ++j) {
+            for (int k = 0; k < args->N; ++k) {
+                if (board_is_occupied(witness, &geometry, j, k)) {
+                    printf("%d,", j * args->N + k);
+                }
+            }
+        }
+    }
+
+    printf("\n");
+}
+
+/**
+ * Prints what a search stopped by --time-limit has proven, after its
+ * solutions: the number of queens found, an upper bound on the maximum, and
+ * whether the two meet.
+ */
+void printBound(int max_queens, int upper_bound, struct program_args *args) {
+    char line[SOLUTION_LINE_MAX];
+
+    formatBound(line, max_queens, upper_bound, args);
+    fputs(line, stdout);
+}
+
+/**
+ * Formats the line printBound prints into line, which must have room for
+ * SOLUTION_LINE_MAX characters. Returns the length of the line.
+ */
+int formatBound(char *line, int max_queens, int upper_bound,
+        struct program_args *args) {
+    if (upper_bound < max_queens) {
+        upper_bound = max_queens;
+    }
+
+    return sprintf(line, "%d,%d:%d:bound %d:%s\n", args->N, args->k,
+            max_queens, upper_bound,
+            upper_bound == max_queens ? "optimal" : "unproven");
+}
+
+/**
+ * Prints a one-line summary of the heartbeats of every solver instance to
+ * stderr.
+ *
+ * pending is the number of tasks not handed to any instance yet. An instance
+ * that has not reported yet has tasks_remaining set to -1, in which case
+ * the number of tasks left is only a lower bound. The estimated time left
+ * assumes the remaining tasks take as long on average as those already
+ * finished. The slowest instance is the one with the most tasks left.
+ */
+void printHeartbeat(struct heartbeat *beats, int num_beats, double elapsed,
+        int num_tasks, int pending) {
+    double rate = 0;
+    long nodes = 0;
+    int tasks_remaining = pending;
+    int max_queens = 0;
+    int running = 0;
+    int slowest = 0;
+    int unknown = 0;
+    int finished;
+
+    for (int i = 0; i < num_beats; ++i) {
+        if (beats[i].tasks_remaining < 0) {
+            unknown++;
+            running++;
+            continue;
+        }
+
+        rate += beats[i].done ? 0 : beats[i].rate;
+        nodes += beats[i].nodes;
+        tasks_remaining += beats[i].tasks_remaining;
+        running += !beats[i].done;
+        if (beats[i].max_queens > max_queens) {
+            max_queens = beats[i].max_queens;
+        }
+
+        if (beats[i].tasks_remaining > beats[slowest].tasks_remaining) {
+            slowest = i;
+        }
+    }
+
+    finished = num_tasks - tasks_remaining;
+    fprintf(stderr, "[%8.1fs] %ld nodes, %.3g nodes/s, %d%s/%d tasks left, "
+            "%d/%d running, max %d queens, slowest %d (%d tasks, depth %d), ",
+            elapsed, nodes, rate, tasks_remaining, unknown ? "+" : "",
+            num_tasks, running, num_beats, max_queens, slowest,
+            beats[slowest].tasks_remaining, beats[slowest].depth);
+    if (finished > 0 && !unknown) {
+        fprintf(stderr, "ETA %.0fs\n", elapsed * tasks_remaining / finished);
+    } else {
+        fprintf(stderr, "ETA unknown\n");
+    }
+}
+
+/**
+ * Prints the counts of a process or thread, named who, to stderr: a line for
+ * every phase, then one for the whole run, e.g.
+ *
+ *     perf 0 moves cycles=... instructions=... ipc=1.52 ...
+ *
+ * Counters that were not counted are printed as "-". If the kernel
+ * multiplexed the counters, a last line tells for what share of the time
+ * they actually ran.
+ */
+void printPerf(const char *who, struct perf_counts *counts) {
+    uint64_t total[PERF_NUM_COUNTERS] = { 0 };
+    const uint64_t *values;
+
+    for (int i = 0; i <= PERF_NUM_PHASES; ++i) {
+        if (i < PERF_NUM_PHASES) {
+            values = counts->values[i];
+            for (int j = 0; j < PERF_NUM_COUNTERS; ++j) {
+                total[j] += values[j];
+            }
+        } else {
+            values = total;
+        }
+
+        fprintf(stderr, "perf %s %s", who,
+                i < PERF_NUM_PHASES ? PERF_PHASE_NAMES[i] : "total");
+        for (int j = 0; j < PERF_NUM_COUNTERS; ++j) {
+            if (counts->available & 1ULL << j) {
+                fprintf(stderr, " %s=%llu", PERF_COUNTER_NAMES[j],
+                        (unsigned long long) values[j]);
+            } else {
+                fprintf(stderr, " %s=-", PERF_COUNTER_NAMES[j]);
+            }
+
+            if (j == PERF_INSTRUCTIONS) {
+                if (values[PERF_CYCLES]) {
+                    fprintf(stderr, " ipc=%.2f", (double)
+                            values[PERF_INSTRUCTIONS] / values[PERF_CYCLES]);
+                } else {
+                    fprintf(stderr, " ipc=-");
+                }
+            }
+        }
+
+        fprintf(stderr, "\n");
+    }
+
+    if (counts->time_running < counts->time_enabled) {
+        fprintf(stderr, "perf %s multiplexed: the counters ran %.1f%% of "
+                "the time, and their counts are not scaled\n", who,
+                100.0 * counts->time_running / counts->time_enabled);
+    }
+}
+
+/* vim: set ts=4 sw=4 et: */
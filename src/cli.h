@@ -0,0 +1,94 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Command line handling shared by every findAQ driver.
+ */
+
+#ifndef AQ_CLI_H_
+#define AQ_CLI_H_
+
+#include "board.h"
+#include "perf.h"
+#include "store.h"
+
+static const int NUM_REQUIRED_ARGS = 5;
+
+static const int EXIT_OK = 0;
+static const int EXIT_NUM_ARGS_INCORRECT = 1;
+static const int EXIT_ARGS_INVALID = 2;
+static const int EXIT_UNKNOWN = 3;
+
+static const int ENGINE_DFS = 0;
+static const int ENGINE_PROFILE = 1;
+static const int ENGINE_JOIN = 2;
+
+/**
+ * Longest line of output for a solution, including its newline: the
+ * numbers of the instance, and every cell of the largest board.
+ */
+#define SOLUTION_LINE_MAX 2048
+
+/**
+ * A structure that stores program arguments. A new scalar field must also be
+ * added to broadcastQuery in findAQ.c.
+ */
+struct program_args {
+    int N;
+    int k;
+    int l;
+    int w;
+    int target;
+    int probe;
+    int balance;
+    long memory;
+    int heartbeat;
+    int all_k;
+    int order;
+    double anneal;
+    int quick;
+    double time_limit;
+    const char *daemon;
+    int engine;
+    const char *trace;
+    const char *output;
+    int shard;
+    int num_shards;
+    int shard_depth;
+    int orbits;
+    int perf;
+};
+
+/**
+ * A progress report of one solver instance, sent every heartbeat. rate is
+ * the number of nodes per second since the previous report.
+ */
+struct heartbeat {
+    long nodes;
+    double rate;
+    int depth;
+    int tasks_remaining;
+    int max_queens;
+    int done;
+};
+
+/**
+ * Function prototypes.
+ */
+void expandStackSize();
+int readProgramArgs(int, char**, struct program_args*);
+void formatSolutions(struct aq_store*, int, struct program_args*,
+        void (*)(void*, const char*, int), void*);
+void printSolutions(struct aq_store*, int, struct program_args*);
+int parseOrbit(const char*, struct aq_board*, struct program_args*, int*,
+        int*);
+void printWitness(int, struct aq_board*, struct program_args*);
+void printBound(int, int, struct program_args*);
+int formatBound(char*, int, int, struct program_args*);
+int formatProgramArgs(struct program_args*, char*, size_t);
+void printHeartbeat(struct heartbeat*, int, double, int, int);
+void printPerf(const char*, struct perf_counts*);
+
+#endif /* AQ_CLI_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,516 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A query server shared by every findAQ driver.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "trace.h"
+
+/**
+ * Appends text to a buffer. Returns 0, or -1 with errno set.
+ */
+static
+int daemonAppend(struct daemon_text *buffer, const char *text,
+        size_t length) {
+    size_t capacity = buffer->capacity ? buffer->capacity : DAEMON_LINE_MAX;
+    char *grown;
+
+    while (capacity < buffer->length + length) {
+        capacity *= 2;
+    }
+
+    if (capacity != buffer->capacity) {
+        grown = realloc(buffer->text, capacity);
+        if (grown == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        buffer->text = grown;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+    return 0;
+}
+
+/**
+ * Sends as much of the output queued for a client as it takes without
+ * waiting. Returns -1 once it has left.
+ */
+static
+int daemonFlush(struct daemon_client *client) {
+    ssize_t sent;
+
+    while (client->sent < client->output.length) {
+        sent = send(client->fd, client->output.text + client->sent,
+                client->output.length - client->sent,
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == -1) {
+            return errno == EAGAIN || errno == EWOULDBLOCK ||
+                   errno == EINTR ? 0 : -1;
+        }
+
+        client->sent += sent;
+    }
+
+    client->output.length = 0;
+    client->sent = 0;
+    return 0;
+}
+
+/**
+ * Queues text for a client, if it is still connected, and sends what it
+ * takes right away. A client whose output cannot be queued is dropped.
+ */
+static
+void daemonSend(struct daemon_state *daemon, long id, const char *text,
+        size_t length) {
+    struct daemon_client *client;
+
+    for (int i = 0; i < daemon->num_clients; ++i) {
+        client = &daemon->clients[i];
+        if (client->id != id) {
+            continue;
+        }
+
+        if (!client->failed &&
+            (daemonAppend(&client->output, text, length) == -1 ||
+             daemonFlush(client) == -1)) {
+            client->failed = 1;
+        }
+
+        return;
+    }
+}
+
+/**
+ * Disconnects the i-th client.
+ */
+static
+void daemonDrop(struct daemon_state *daemon, int i) {
+    close(daemon->clients[i].fd);
+    free(daemon->clients[i].output.text);
+    daemon->clients[i] = daemon->clients[--daemon->num_clients];
+}
+
+/**
+ * Returns the answer kept for a query, or NULL.
+ */
+static
+struct daemon_answer *daemonFindAnswer(struct daemon_state *daemon,
+        const char *key) {
+    for (struct daemon_answer *answer = daemon->answers; answer != NULL;
+            answer = answer->next) {
+        if (!strcmp(answer->key, key)) {
+            return answer;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Sends a client the answer to a query that is not solved: a header with the
+ * query as it was sent, then the reason.
+ */
+static
+void daemonReject(struct daemon_state *daemon, long id, const char *line,
+        const char *reason, size_t length) {
+    char header[DAEMON_LINE_MAX + 3];
+    int header_length;
+
+    header_length = snprintf(header, sizeof(header), "> %s\n", line);
+    daemonSend(daemon, id, header, header_length);
+    daemonSend(daemon, id, reason, length);
+}
+
+/**
+ * Parses a query line into arguments, leaving any error message in message.
+ * Returns EXIT_OK if the arguments are valid.
+ */
+static
+int daemonParse(char *line, struct program_args *args, char **message,
+        size_t *size) {
+    char *argv[DAEMON_MAX_ARGS + 1];
+    char program[] = "findAQ";
+    FILE *saved_stderr = stderr;
+    int argc = 0;
+    int retval;
+
+    argv[argc++] = program;
+    for (char *token = strtok(line, " \t\r"); token != NULL;
+            token = strtok(NULL, " \t\r")) {
+        if (argc == DAEMON_MAX_ARGS) {
+            argc++;
+            break;
+        }
+
+        argv[argc++] = token;
+    }
+
+    // Errors are printed to stderr, so catch them for the client. Setting
+    // optind to zero makes GNU getopt start over.
+    stderr = open_memstream(message, size);
+    if (stderr == NULL) {
+        stderr = saved_stderr;
+        return EXIT_UNKNOWN;
+    }
+
+    if (argc > DAEMON_MAX_ARGS) {
+        fprintf(stderr, "A query takes at most %d arguments.\n",
+                DAEMON_MAX_ARGS - 1);
+        fclose(stderr);
+        stderr = saved_stderr;
+        return EXIT_NUM_ARGS_INCORRECT;
+    }
+
+    argv[argc] = NULL;
+    optind = 0;
+    retval = readProgramArgs(argc, argv, args);
+    if (retval == EXIT_OK && (args->daemon || args->trace || args->output ||
+                args->perf)) {
+        fprintf(stderr, "--daemon, --trace, --output and --perf cannot be "
+                "used in a query.\n");
+        retval = EXIT_ARGS_INVALID;
+    }
+
+    fclose(stderr);
+    stderr = saved_stderr;
+    return retval;
+}
+
+/**
+ * Handles one line from a client: answers it from the kept answers, adds
+ * the client to a pending query that is the same, or queues a new query.
+ */
+static
+void daemonHandleLine(struct daemon_state *daemon,
+        struct daemon_client *client, char *line) {
+    struct program_args args;
+    struct daemon_answer *answer;
+    struct daemon_query *query;
+    char key[DAEMON_LINE_MAX];
+    char sent[DAEMON_LINE_MAX];
+    char *message = NULL;
+    size_t size = 0;
+
+    line[strcspn(line, "\r")] = '\0';
+    if (line[strspn(line, " \t")] == '\0') {
+        return;
+    }
+
+    if (!strcmp(line, "shutdown")) {
+        daemon->stopping = 1;
+        return;
+    }
+
+    // Parsing splits the line, so keep it whole for a rejection.
+    strcpy(sent, line);
+    if (daemonParse(line, &args, &message, &size) != EXIT_OK) {
+        daemonReject(daemon, client->id, sent, message, size);
+        free(message);
+        return;
+    }
+
+    free(message);
+    formatProgramArgs(&args, key, sizeof(key));
+
+    answer = daemonFindAnswer(daemon, key);
+    if (answer != NULL) {
+        TRACE_INFO(DAEMON_QUERY, AQ_TRACE_QUERY_MEMORY, daemon->num_pending);
+        daemonSend(daemon, client->id, answer->text, answer->length);
+        return;
+    }
+
+    for (int i = 0; i < daemon->num_pending; ++i) {
+        query = &daemon->pending[i];
+        if (!strcmp(query->key, key) &&
+            query->num_waiting < DAEMON_MAX_CLIENTS) {
+            TRACE_INFO(DAEMON_QUERY, AQ_TRACE_QUERY_COALESCE,
+                    daemon->num_pending);
+            query->waiting[query->num_waiting++] = client->id;
+            return;
+        }
+    }
+
+    if (daemon->num_pending == DAEMON_MAX_PENDING) {
+        message = "Too many queries pending.\n";
+        daemonReject(daemon, client->id, key, message, strlen(message));
+        return;
+    }
+
+    query = &daemon->pending[daemon->num_pending++];
+    strcpy(query->key, key);
+    query->args = args;
+    query->waiting[0] = client->id;
+    query->num_waiting = 1;
+}
+
+/**
+ * Reads what a client sent, handling every complete line. Returns -1 once
+ * the client has left.
+ */
+static
+int daemonRead(struct daemon_state *daemon, struct daemon_client *client) {
+    ssize_t received;
+    char *end;
+
+    received = recv(client->fd, client->line + client->length,
+            DAEMON_LINE_MAX - 1 - client->length, 0);
+    if (received <= 0) {
+        return received == -1 && errno == EINTR ? 0 : -1;
+    }
+
+    client->length += received;
+    client->line[client->length] = '\0';
+    while ((end = strchr(client->line, '\n')) != NULL) {
+        *end = '\0';
+        daemonHandleLine(daemon, client, client->line);
+        client->length -= end + 1 - client->line;
+        memmove(client->line, end + 1, client->length + 1);
+    }
+
+    // A line that fills the whole buffer can never be completed.
+    return client->length == DAEMON_LINE_MAX - 1 ? -1 : 0;
+}
+
+/**
+ * Starts listening on a Unix-domain socket at path. Returns 0, or -1 with
+ * errno set.
+ */
+int daemonOpen(struct daemon_state *daemon, const char *path) {
+    struct sockaddr_un address;
+
+    memset(daemon, 0, sizeof(*daemon));
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    strcpy(daemon->path, path);
+
+    daemon->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (daemon->fd == -1) {
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(daemon->fd, (struct sockaddr*) &address, sizeof(address)) == -1 ||
+        listen(daemon->fd, DAEMON_MAX_CLIENTS) == -1) {
+        close(daemon->fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Waits for a query that has to be solved, serving every client in the
+ * meantime. The query is stored in args.
+ *
+ * Returns 1 with a query, or 0 once the server is shutting down and has no
+ * query left.
+ */
+int daemonNextQuery(struct daemon_state *daemon, struct program_args *args) {
+    struct pollfd fds[DAEMON_MAX_CLIENTS + 1];
+    struct daemon_client *client;
+    int fd;
+
+    for (;;) {
+        if (daemon->num_pending > 0) {
+            daemon->current = daemon->pending[0];
+            daemon->num_pending--;
+            memmove(daemon->pending, daemon->pending + 1,
+                    daemon->num_pending * sizeof(struct daemon_query));
+            *args = daemon->current.args;
+            TRACE_INFO(DAEMON_QUERY, AQ_TRACE_QUERY_SOLVE,
+                    daemon->num_pending);
+            return 1;
+        }
+
+        if (daemon->stopping) {
+            return 0;
+        }
+
+        for (int i = daemon->num_clients - 1; i >= 0; --i) {
+            if (daemon->clients[i].failed) {
+                daemonDrop(daemon, i);
+            }
+        }
+
+        fds[0].fd = daemon->fd;
+        fds[0].events = daemon->num_clients < DAEMON_MAX_CLIENTS ? POLLIN : 0;
+        for (int i = 0; i < daemon->num_clients; ++i) {
+            fds[i + 1].fd = daemon->clients[i].fd;
+            fds[i + 1].events = POLLIN;
+            if (daemon->clients[i].output.length) {
+                fds[i + 1].events |= POLLOUT;
+            }
+        }
+
+        if (poll(fds, daemon->num_clients + 1, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return 0;
+        }
+
+        // Clients are read from the last, so that removing one does not
+        // move those not read yet.
+        for (int i = daemon->num_clients - 1; i >= 0; --i) {
+            client = &daemon->clients[i];
+            if ((fds[i + 1].revents & POLLOUT && daemonFlush(client) == -1) ||
+                (fds[i + 1].revents & ~POLLOUT &&
+                 daemonRead(daemon, client) == -1)) {
+                daemonDrop(daemon, i);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            fd = accept(daemon->fd, NULL, NULL);
+            if (fd != -1) {
+                client = &daemon->clients[daemon->num_clients++];
+                memset(client, 0, sizeof(*client));
+                client->fd = fd;
+                client->id = daemon->next_id++;
+            }
+        }
+    }
+}
+
+/**
+ * Hands what is printed for the current query to every client waiting on
+ * it, and keeps it if it is to be kept. Returns length, or -1 with errno set
+ * if it cannot be kept.
+ */
+static
+ssize_t daemonWriteAnswer(void *cookie, const char *text, size_t length) {
+    struct daemon_state *daemon = cookie;
+
+    for (int i = 0; i < daemon->current.num_waiting; ++i) {
+        daemonSend(daemon, daemon->current.waiting[i], text, length);
+    }
+
+    if (daemon->keep && daemonAppend(&daemon->answer, text, length) == -1) {
+        daemon->keep = 0;
+    }
+
+    return length;
+}
+
+/**
+ * Starts handing everything printed for the current query to the clients
+ * waiting on it.
+ */
+void daemonBeginAnswer(struct daemon_state *daemon) {
+    static const cookie_io_functions_t functions = {
+        .write = daemonWriteAnswer
+    };
+    struct program_args *args = &daemon->current.args;
+
+    fflush(stdout);
+    fflush(stderr);
+    memset(&daemon->answer, 0, sizeof(daemon->answer));
+    // The local search and the time limit stop on the clock, and heartbeats
+    // report rates and times of this very run.
+    daemon->keep = !args->anneal && !args->time_limit && !args->heartbeat;
+    daemon->stream = fopencookie(daemon, "w", functions);
+    if (daemon->stream == NULL) {
+        return;
+    }
+
+    fprintf(daemon->stream, "> %s\n", daemon->current.key);
+    daemon->saved_stdout = stdout;
+    daemon->saved_stderr = stderr;
+    stdout = daemon->stream;
+    stderr = daemon->stream;
+}
+
+/**
+ * Sends the rest of the answer to the current query, and keeps it unless it
+ * depends on time.
+ */
+void daemonEndAnswer(struct daemon_state *daemon) {
+    struct daemon_answer *answer;
+
+    if (daemon->stream == NULL) {
+        return;
+    }
+
+    stdout = daemon->saved_stdout;
+    stderr = daemon->saved_stderr;
+    fclose(daemon->stream);
+    daemon->stream = NULL;
+
+    answer = malloc(sizeof(struct daemon_answer));
+    if (!daemon->keep || answer == NULL) {
+        free(answer);
+        free(daemon->answer.text);
+        return;
+    }
+
+    answer->key = strdup(daemon->current.key);
+    answer->text = daemon->answer.text;
+    answer->length = daemon->answer.length;
+    answer->next = daemon->answers;
+    daemon->answers = answer;
+}
+
+/**
+ * Disconnects every client and stops listening.
+ */
+void daemonClose(struct daemon_state *daemon) {
+    struct pollfd fds;
+    struct daemon_client *client;
+    struct daemon_answer *answer;
+
+    // What the clients have not taken yet is sent before they are
+    // disconnected, waiting for them if need be.
+    for (int i = daemon->num_clients - 1; i >= 0; --i) {
+        client = &daemon->clients[i];
+        fds.fd = client->fd;
+        fds.events = POLLOUT;
+        while (!client->failed && client->output.length) {
+            if (daemonFlush(client) == -1 ||
+                (poll(&fds, 1, -1) == -1 && errno != EINTR)) {
+                client->failed = 1;
+            }
+        }
+
+        daemonDrop(daemon, i);
+    }
+
+    while (daemon->answers != NULL) {
+        answer = daemon->answers;
+        daemon->answers = answer->next;
+        free(answer->key);
+        free(answer->text);
+        free(answer);
+    }
+
+    close(daemon->fd);
+    unlink(daemon->path);
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,126 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A query server shared by every findAQ driver.
+ *
+ * With --daemon path, findAQ starts once and answers queries over a
+ * Unix-domain socket at path instead. A query is one line holding the
+ * arguments of findAQ, and its answer is a line "> " followed by the query
+ * in canonical form (see formatProgramArgs), then exactly what findAQ would
+ * print for it. A query that is rejected gets the same header, with the
+ * query as it was sent if it cannot be parsed, followed by the reason.
+ * Answers are sent while they are printed, in the order the queries are
+ * solved, which need not be the order they came in. Output a client has not
+ * taken yet waits in a queue of its own, so a client that reads slowly never
+ * holds up the server. The line "shutdown" stops the
+ * server once the queries already received are answered.
+ *
+ * Queries that are the same in canonical form are solved once for every
+ * client waiting on them, and the answers are kept for later queries, unless
+ * they depend on the time they were given to run or report progress with
+ * --heartbeat.
+ */
+
+#ifndef AQ_DAEMON_H_
+#define AQ_DAEMON_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "cli.h"
+
+/**
+ * Limits of the server: clients connected at once, queries waiting to be
+ * solved, and the length of a query line and its number of arguments.
+ */
+#define DAEMON_MAX_CLIENTS 64
+#define DAEMON_MAX_PENDING 256
+#define DAEMON_LINE_MAX 1024
+#define DAEMON_MAX_ARGS 64
+
+/**
+ * A growable buffer of text.
+ */
+struct daemon_text {
+    char *text;
+    size_t length;
+    size_t capacity;
+};
+
+/**
+ * A connected client. id tells clients apart even when the file descriptor of
+ * one that left is reused. output holds what is still to be sent to it from
+ * offset sent on, and failed is set once it cannot be served any longer.
+ */
+struct daemon_client {
+    int fd;
+    long id;
+    int failed;
+    size_t length;
+    char line[DAEMON_LINE_MAX];
+    struct daemon_text output;
+    size_t sent;
+};
+
+/**
+ * A query waiting to be solved, along with every client waiting on it.
+ */
+struct daemon_query {
+    char key[DAEMON_LINE_MAX];
+    struct program_args args;
+    long waiting[DAEMON_MAX_CLIENTS];
+    int num_waiting;
+};
+
+/**
+ * A completed answer kept for later queries.
+ */
+struct daemon_answer {
+    char *key;
+    char *text;
+    size_t length;
+    struct daemon_answer *next;
+};
+
+/**
+ * The state of the server.
+ *
+ * While a query is answered, stdout and stderr are both redirected into
+ * stream, which hands what is printed to every client waiting on the query,
+ * and keeps it in answer unless the answer depends on time.
+ */
+struct daemon_state {
+    int fd;
+    char path[DAEMON_LINE_MAX];
+    int stopping;
+    long next_id;
+
+    struct daemon_client clients[DAEMON_MAX_CLIENTS];
+    int num_clients;
+
+    struct daemon_query pending[DAEMON_MAX_PENDING];
+    int num_pending;
+    struct daemon_query current;
+
+    struct daemon_answer *answers;
+
+    FILE *stream;
+    FILE *saved_stdout;
+    FILE *saved_stderr;
+    int keep;
+    struct daemon_text answer;
+};
+
+/**
+ * Function prototypes.
+ */
+int daemonOpen(struct daemon_state*, const char*);
+int daemonNextQuery(struct daemon_state*, struct program_args*);
+void daemonBeginAnswer(struct daemon_state*);
+void daemonEndAnswer(struct daemon_state*);
+void daemonClose(struct daemon_state*);
+
+#endif /* AQ_DAEMON_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -4,400 +4,1266 @@
  *
  * This is a parallel implementation of a solution to the Aggressive Queens
  * (AQ) problem.
+ *
+ * The search itself lives in the solver library (aq.h). This file only reads
+ * the arguments, runs one solver instance per MPI process and combines their
+ * results.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
 
-#include <sys/time.h>
-#include <sys/resource.h>
 #include <mpi.h>
 
-#include "stack.h"
+#include "aq.h"
+#include "anneal.h"
 #include "board.h"
-#include "move.h"
+#include "cli.h"
+#include "daemon.h"
+#include "perf.h"
+#include "join.h"
+#include "profile.h"
+#include "shard.h"
+#include "symmetry.h"
+#include "trace.h"
+
+/**
+ * In target mode, processes check for a witness found elsewhere once every
+ * this many nodes.
+ */
+static const int WITNESS_POLL_INTERVAL = 1024;
+static const int TAG_WITNESS = 1;
+static const int TAG_LINES = 2;
+static const int TAG_HEARTBEAT = 3;
+
+/**
+ * Number of solutions every process sends to every other in one round of
+ * partitionSolutions.
+ */
+static const int SOLUTIONS_PER_MESSAGE = 4096;
+
+/**
+ * Number of bytes every process writes in one collective call with
+ * --output, or sends to the root process in one message otherwise.
+ */
+static const int OUTPUT_CHUNK = 1 << 20;
+
+/**
+ * The state of the heartbeat of this process. latest is the last heartbeat
+ * of this process, and beat the buffer of the one in flight: every process
+ * keeps at most one heartbeat in flight to the root process, which collects
+ * the latest one of every process in beats.
+ */
+struct heartbeat_state {
+    int interval;
+    int num_tasks;
+    double start;
+    double last;
+    long last_nodes;
 
-static const int NUM_REQUIRED_ARGS = 5;
-static const int MAX_SOLUTION_SET_SIZE = 4096;
-static const int MAX_MPI_PROCS = 64;
+    struct heartbeat latest;
+    struct heartbeat beat;
+    MPI_Request request;
 
-static const int EXIT_OK = 0;
-static const int EXIT_NUM_ARGS_INCORRECT = 1;
-static const int EXIT_ARGS_INVALID = 2;
-static const int EXIT_UNKNOWN = 3;
+    struct heartbeat *beats;
+    int num_done;
+};
 
 /**
- * A structure that stores program arguments.
+ * The results reported by the solver instance of this process.
  */
-struct program_args {
-    int N;
-    int k;
-    int l;
-    int w;
+struct solver_results {
+    struct aq_store solutions[AQ_MAX_ATTACKS + 1];
+    int max_queens[AQ_MAX_ATTACKS + 1];
+
+    struct aq_board witness;
+    int found;
+    int target;
+    MPI_Request *witness_requests;
+
+    double deadline;
+    int open_bound[AQ_MAX_ATTACKS + 1];
+
+    struct heartbeat_state heartbeat;
+};
+
+/**
+ * The file of --output, shared by every process.
+ *
+ * base is where the results of the next k go. Each process formats its
+ * lines twice: once only to count their bytes, which places its share of
+ * the results at offset, and once more into buffer, which is written out
+ * every time it holds a whole chunk.
+ */
+struct output_state {
+    MPI_File file;
+    MPI_Offset base;
+    MPI_Offset offset;
+    MPI_Offset size;
+    int counting;
+
+    char *buffer;
+    int length;
+    long chunks;
+};
+
+/**
+ * The lines of a process on their way to the root process, which prints
+ * them. Every chunk but the last is full, so a short chunk, even an empty
+ * one, ends the lines of a process.
+ */
+struct line_stream {
+    char *buffer;
+    int length;
 };
 
 /**
  * Function prototypes.
  */
-void expandStackSize();
-int readProgramArgs(int, char**, struct program_args*);
-static inline void godFunction(struct program_args*);
-static inline void gatherResults(int, int, struct aq_board*,
+static inline int godFunction(struct program_args*, struct aq_board*);
+static inline void gatherResults(struct aq_store*, int, int,
+        struct program_args*);
+static inline void writeResults(struct output_state*, struct aq_store*, int,
+        int, struct program_args*);
+static inline int gatherWitness(int, struct aq_board*, MPI_Request*,
         struct program_args*);
+static inline int annealWitness(struct program_args*, int, double,
+        struct aq_board*);
 
 /**
- * We need more stack size than the default.
+ * Ends every process after a failure, keeping the trace of this one.
  */
-void expandStackSize() {
-    // Set to 64MB.
-    const rlim_t stack_size = 64L * 1024L * 1024L;
-    struct rlimit rl;
-    int result;
+static inline
+void abortAll() {
+    trace_dump();
+    MPI_Abort(MPI_COMM_WORLD, EXIT_UNKNOWN);
+}
+
+/**
+ * Moves every solution to the process that owns it, so that each solution
+ * ends up on exactly one process and the processes get about as many each.
+ * The owner is picked by the high bits of the hash of a solution, which the
+ * store of the owner does not use for its own index.
+ *
+ * Solutions go out in rounds of at most SOLUTIONS_PER_MESSAGE per process,
+ * so that no process needs room for more than its own store and those of a
+ * round.
+ */
+static inline
+void partitionSolutions(struct aq_store *solutions,
+        struct program_args *args) {
+    struct aq_store owned;
+    uint64_t *send;
+    uint64_t *receive;
+    int *counts;
+    size_t next = 0;
+    int width = solutions->width;
+    int remaining;
+    int chunk;
+    int owner;
+
+    // MPI information.
+    int mpi_nprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
+    if (mpi_nprocs == 1) {
+        return;
+    }
+
+    store_init(&owned, args->N, args->memory);
+    send = malloc(SOLUTIONS_PER_MESSAGE * width * sizeof(uint64_t));
+    receive = malloc((size_t) SOLUTIONS_PER_MESSAGE * mpi_nprocs * width *
+            sizeof(uint64_t));
+    counts = malloc(5 * mpi_nprocs * sizeof(int));
+    if (send == NULL || receive == NULL || counts == NULL) {
+        fprintf(stderr, "%s: Failed to allocate buffers\n",
+                "partitionSolutions");
+        abortAll();
+    }
+
+    // Counts and displacements, of the solutions sent and received, and
+    // where the next solution for each process goes.
+    int *send_counts = counts;
+    int *send_displs = counts + mpi_nprocs;
+    int *receive_counts = counts + 2 * mpi_nprocs;
+    int *receive_displs = counts + 3 * mpi_nprocs;
+    int *positions = counts + 4 * mpi_nprocs;
+
+    do {
+        chunk = store_count(solutions) - next < SOLUTIONS_PER_MESSAGE ?
+            store_count(solutions) - next : SOLUTIONS_PER_MESSAGE;
+        memset(send_counts, 0, mpi_nprocs * sizeof(int));
+        for (int i = 0; i < chunk; ++i) {
+            owner = (store_hash(store_slices(solutions, next + i), width) >>
+                    32) % mpi_nprocs;
+            send_counts[owner] += width;
+        }
+
+        for (int i = 0; i < mpi_nprocs; ++i) {
+            send_displs[i] = i ? send_displs[i - 1] + send_counts[i - 1] : 0;
+            positions[i] = send_displs[i];
+        }
+
+        for (int i = 0; i < chunk; ++i) {
+            const uint64_t *slices = store_slices(solutions, next + i);
+            owner = (store_hash(slices, width) >> 32) % mpi_nprocs;
+            memcpy(send + positions[owner], slices, width * sizeof(uint64_t));
+            positions[owner] += width;
+        }
+
+        MPI_Alltoall(send_counts, 1, MPI_INT, receive_counts, 1, MPI_INT,
+                MPI_COMM_WORLD);
+        for (int i = 0; i < mpi_nprocs; ++i) {
+            receive_displs[i] = i ? receive_displs[i - 1] +
+                receive_counts[i - 1] : 0;
+        }
 
-    result = getrlimit(RLIMIT_STACK, &rl);
-    if (result == 0) {
-        if (rl.rlim_cur < stack_size) {
-            rl.rlim_cur = stack_size;
-            result = setrlimit(RLIMIT_STACK, &rl);
-            if (result != 0) {
-                fprintf(stderr, "%s: Failed to increase stack size (errno %d)\n",
-                        "expandStackSize", result);
+        MPI_Alltoallv(send, send_counts, send_displs, MPI_UINT64_T, receive,
+                receive_counts, receive_displs, MPI_UINT64_T,
+                MPI_COMM_WORLD);
+
+        // The store drops the duplicates.
+        for (int i = 0; i < receive_displs[mpi_nprocs - 1] +
+                receive_counts[mpi_nprocs - 1]; i += width) {
+            if (store_insert_slices(&owned, receive + i) == -1) {
+                fprintf(stderr, "%s: Failed to store solutions (errno %d)\n",
+                        "partitionSolutions", errno);
+                abortAll();
             }
         }
-    } else {
-        fprintf(stderr, "%s: Failed to increase stack size (errno %d)\n",
-                "expandStackSize", result);
+
+        next += chunk;
+        remaining = next < store_count(solutions);
+        MPI_Allreduce(MPI_IN_PLACE, &remaining, 1, MPI_INT, MPI_LOR,
+                MPI_COMM_WORLD);
+    } while (remaining);
+
+    free(send);
+    free(receive);
+    free(counts);
+    store_free(solutions);
+    *solutions = owned;
+}
+
+/**
+ * Agrees with every other process on the maximum number of queens, and on
+ * the bound proven with --time-limit. The solutions of this process that
+ * fall short of the maximum are dropped, and with l, those left are spread
+ * over the processes by partitionSolutions, so that each holds a share free
+ * of duplicates. Without l, the solutions are never printed, so they stay
+ * where they are.
+ */
+static inline
+void shareResults(struct aq_store *solutions, int *max_queens,
+        int *open_bound, struct program_args *args) {
+    int all_max_queens;
+
+    MPI_Allreduce(max_queens, &all_max_queens, 1, MPI_INT, MPI_MAX,
+            MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, open_bound, 1, MPI_INT, MPI_MAX,
+            MPI_COMM_WORLD);
+    if (*max_queens != all_max_queens) {
+        store_clear(solutions);
+    }
+
+    *max_queens = all_max_queens;
+    if (args->l) {
+        partitionSolutions(solutions, args);
     }
 }
 
 /**
- * Reads the arguments for the program.
+ * Prints a line to stdout, for formatSolutions.
  */
-int readProgramArgs(int argc, char* argv[], struct program_args* program_args) {
-    assert(program_args != NULL);
-    errno = 0;
+static
+void printLine(void *user, const char *line, int length) {
+    fwrite(line, 1, length, stdout);
+}
 
-    if (argc != NUM_REQUIRED_ARGS) {
-        fprintf(stderr, "%s: Exactly %d arguments (N, k, l, w) are required.\n",
-                argv[0], NUM_REQUIRED_ARGS);
-        return EXIT_NUM_ARGS_INCORRECT;
+/**
+ * Sends the full chunk of a line stream to the root process, or the last
+ * one, however short.
+ */
+static inline
+void sendChunk(struct line_stream *stream) {
+    MPI_Send(stream->buffer, stream->length, MPI_CHAR, 0, TAG_LINES,
+            MPI_COMM_WORLD);
+    stream->length = 0;
+}
+
+/**
+ * Adds a line to a line stream, for formatSolutions.
+ */
+static
+void sendLine(void *user, const char *line, int length) {
+    struct line_stream *stream = user;
+    int part;
+
+    while (length > 0) {
+        part = OUTPUT_CHUNK - stream->length < length ?
+            OUTPUT_CHUNK - stream->length : length;
+        memcpy(stream->buffer + stream->length, line, part);
+        stream->length += part;
+        line += part;
+        length -= part;
+        if (stream->length == OUTPUT_CHUNK) {
+            sendChunk(stream);
+        }
     }
+}
+
+/**
+ * Prints the lines another process streams to the root process.
+ */
+static inline
+void receiveLines(char *buffer, int source) {
+    MPI_Status status;
+    int length;
+
+    do {
+        MPI_Recv(buffer, OUTPUT_CHUNK, MPI_CHAR, source, TAG_LINES,
+                MPI_COMM_WORLD, &status);
+        MPI_Get_count(&status, MPI_CHAR, &length);
+        fwrite(buffer, 1, length, stdout);
+    } while (length == OUTPUT_CHUNK);
+}
 
-    // Set variable names.
-    program_args->N = strtol(argv[1], NULL, 0);
-    if (errno) {
-        fprintf(stderr, "Error converting 1st argument: %s\n", strerror(errno));
-        return EXIT_ARGS_INVALID;
+/**
+ * Gathers results of the computation.
+ *
+ * Duplicates are dropped where the solutions end up after shareResults, so
+ * the root process never holds more than its own share. Every process then
+ * formats the lines of its share and streams them to the root process a
+ * chunk at a time, which prints them as they come, one process after the
+ * other. Only the number of solutions of each process is gathered.
+ *
+ * With --time-limit, the bound proven by the search follows the solutions.
+ */
+static inline
+void gatherResults(struct aq_store *solutions, int max_queens,
+        int open_bound, struct program_args *args) {
+    struct line_stream stream;
+    long *counts = NULL;
+    long count;
+    long total = 0;
+
+    // MPI information.
+    int mpi_rank;
+    int mpi_nprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
+
+    shareResults(solutions, &max_queens, &open_bound, args);
+
+    stream.buffer = malloc(OUTPUT_CHUNK);
+    stream.length = 0;
+    if (mpi_rank == 0) {
+        counts = malloc(mpi_nprocs * sizeof(long));
     }
 
-    program_args->k = strtol(argv[2], NULL, 0);
-    if (errno) {
-        fprintf(stderr, "Error converting 2nd argument: %s\n", strerror(errno));
-        return EXIT_ARGS_INVALID;
+    if (stream.buffer == NULL || (mpi_rank == 0 && counts == NULL)) {
+        fprintf(stderr, "%s: Failed to allocate buffers\n", "gatherResults");
+        abortAll();
     }
 
-    program_args->l = strtol(argv[3], NULL, 0);
-    if (errno) {
-        fprintf(stderr, "Error converting 3rd argument: %s\n", strerror(errno));
-        return EXIT_ARGS_INVALID;
+    count = store_count(solutions);
+    MPI_Gather(&count, 1, MPI_LONG, counts, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+    for (int i = 0; mpi_rank == 0 && i < mpi_nprocs; ++i) {
+        TRACE_INFO(GATHER_SOURCE, i, counts[i], max_queens);
+        total += counts[i];
+    }
+
+    MPI_Bcast(&total, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    if (!args->l || total == 0) {
+        if (mpi_rank == 0) {
+            printf("%d,%d:%d:\n", args->N, args->k, max_queens);
+        }
+    } else if (mpi_rank == 0) {
+        formatSolutions(solutions, max_queens, args, printLine, NULL);
+        for (int i = 1; i < mpi_nprocs; ++i) {
+            if (counts[i]) {
+                receiveLines(stream.buffer, i);
+            }
+        }
+    } else if (count) {
+        formatSolutions(solutions, max_queens, args, sendLine, &stream);
+        sendChunk(&stream);
     }
 
-    program_args->w = strtol(argv[4], NULL, 0);
-    if (errno) {
-        fprintf(stderr, "Error converting 4th argument: %s\n", strerror(errno));
-        return EXIT_ARGS_INVALID;
+    if (args->time_limit && mpi_rank == 0) {
+        printBound(max_queens, open_bound, args);
     }
 
-    // Check if the values are sane.
-    if (program_args->N <= 1) {
-        fprintf(stderr, "N must be equal or larger than 3.\n");
-        return EXIT_ARGS_INVALID;
+    TRACE_INFO(GATHER_END, args->k, max_queens, store_count(solutions));
+
+    free(stream.buffer);
+    free(counts);
+}
+
+/**
+ * Writes the chunk in the buffer of --output, however full, in a collective
+ * call.
+ */
+static inline
+void writeChunk(struct output_state *output) {
+    if (MPI_File_write_at_all(output->file, output->base + output->offset +
+                output->chunks * OUTPUT_CHUNK, output->buffer,
+                output->length, MPI_CHAR, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+        fprintf(stderr, "%s: Failed to write output\n", "writeChunk");
+        abortAll();
     }
 
-    if (program_args->k < 0) {
-        fprintf(stderr, "k must be equals to or larger than 0.\n");
-        return EXIT_ARGS_INVALID;
+    output->chunks++;
+    output->length = 0;
+}
+
+/**
+ * Counts or buffers a line of output, for formatSolutions.
+ */
+static
+void outputLine(void *user, const char *line, int length) {
+    struct output_state *output = user;
+    int part;
+
+    if (output->counting) {
+        output->size += length;
+        return;
     }
 
-    return EXIT_OK;
+    while (length > 0) {
+        part = OUTPUT_CHUNK - output->length < length ?
+            OUTPUT_CHUNK - output->length : length;
+        memcpy(output->buffer + output->length, line, part);
+        output->length += part;
+        line += part;
+        length -= part;
+        if (output->length == OUTPUT_CHUNK) {
+            writeChunk(output);
+        }
+    }
 }
 
 /**
- * Prepares the task stack based on board size.
+ * Formats the lines of this process for writeResults: its own solutions,
+ * the line of the root process when there are none to show, and the bound
+ * with --time-limit at the very end.
  */
 static inline
-struct aq_stack prepareTaskStack(int N) {
-    // Prepare a stack of initial moves.
-    struct aq_stack stack = stack_new();
-    struct aq_move initial_move;
+void outputResults(struct output_state *output, struct aq_store *solutions,
+        int max_queens, long count, int open_bound,
+        struct program_args *args) {
+    char line[SOLUTION_LINE_MAX];
+
+    // MPI information.
     int mpi_rank;
     int mpi_nprocs;
-    struct aq_move initial_moves[N * N];
-    int num_initial_moves = 0;
-
-    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
     MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
-    LOG("prepareTaskStack", "MPI_Comm_size=%d, MPI_Comm_rank=%d", mpi_nprocs,
-            mpi_rank);
-
-    // Optimization: we only need to find one half the board.
-    for (int i = 0; i < N; ++i) {
-        for (int j = 0; j < N - i; ++j) {
-            initial_move.row = i;
-            initial_move.col = j;
-            initial_move.applied = 0;
-            
-            initial_moves[num_initial_moves++] = initial_move;
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
+
+    if (!args->l || count == 0) {
+        if (mpi_rank == 0) {
+            outputLine(output, line, sprintf(line, "%d,%d:%d:\n", args->N,
+                        args->k, max_queens));
         }
+    } else {
+        formatSolutions(solutions, max_queens, args, outputLine, output);
+    }
+
+    if (args->time_limit && mpi_rank == mpi_nprocs - 1) {
+        outputLine(output, line, formatBound(line, max_queens, open_bound,
+                    args));
     }
+}
+
+/**
+ * Writes the results of the computation to the file of --output, in place of
+ * gatherResults.
+ *
+ * As for gatherResults, every process holds its own share of the solutions
+ * after shareResults. Every process then formats its share and writes it at
+ * its offset in the file, so the root process does no more than any other.
+ */
+static inline
+void writeResults(struct output_state *output, struct aq_store *solutions,
+        int max_queens, int open_bound, struct program_args *args) {
+    long count;
+    long chunks;
+    MPI_Offset total;
+
+    // MPI information.
+    int mpi_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+
+    shareResults(solutions, &max_queens, &open_bound, args);
+
+    count = store_count(solutions);
+    MPI_Allreduce(MPI_IN_PLACE, &count, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    // Place the share of every process.
+    output->counting = 1;
+    output->size = 0;
+    outputResults(output, solutions, max_queens, count, open_bound, args);
+    MPI_Exscan(&output->size, &output->offset, 1, MPI_OFFSET, MPI_SUM,
+            MPI_COMM_WORLD);
+    if (mpi_rank == 0) {
+        output->offset = 0;
+    }
+
+    MPI_Allreduce(&output->size, &total, 1, MPI_OFFSET, MPI_SUM,
+            MPI_COMM_WORLD);
+    chunks = (output->size + OUTPUT_CHUNK - 1) / OUTPUT_CHUNK;
+    MPI_Allreduce(MPI_IN_PLACE, &chunks, 1, MPI_LONG, MPI_MAX,
+            MPI_COMM_WORLD);
+
+    // Every process takes part in as many collective writes as the one with
+    // the most chunks, the last ones empty.
+    output->counting = 0;
+    output->length = 0;
+    output->chunks = 0;
+    outputResults(output, solutions, max_queens, count, open_bound, args);
+    while (output->chunks < chunks) {
+        writeChunk(output);
+    }
+
+    output->base += total;
+    TRACE_INFO(GATHER_END, args->k, max_queens, store_count(solutions));
+}
+
+/**
+ * Tells every other process that a witness has been found.
+ */
+static inline
+void notifyWitness(MPI_Request *requests) {
+    int mpi_rank;
+    int mpi_nprocs;
+    static int found = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
 
-    for (int i = 0; i < num_initial_moves; ++i) {
-        int proc_id = i % mpi_nprocs;
-        if (proc_id == mpi_rank) {
-            stack_push(&stack, initial_moves[i]);
+    for (int i = 0; i < mpi_nprocs; ++i) {
+        if (i == mpi_rank) {
+            requests[i] = MPI_REQUEST_NULL;
+        } else {
+            MPI_Isend(&found, 1, MPI_INT, i, TAG_WITNESS, MPI_COMM_WORLD,
+                    &requests[i]);
         }
     }
-    
-    return stack;
 }
 
 /**
- * Gathers results of the computation.
+ * Agrees on a witness in target mode.
+ *
+ * Every process that found a witness has sent a notification to every other
+ * process, so each process knows exactly how many notifications to drain
+ * before the next search may start. Returns the number of queens in the
+ * witness, or zero if no process found one. The witness ends up on every
+ * process.
  */
 static inline
-void gatherResults(int num_solutions, int max_queens,
-        struct aq_board *solution_set, struct program_args *args) {
-    int i, j, k;
-    int has_existing_solutions;
+int gatherWitness(int found, struct aq_board *witness, MPI_Request *requests,
+        struct program_args *args) {
+    int mpi_rank;
+    int mpi_nprocs;
+    int num_found;
+    int owner;
+    int notification;
+    int num_queens = 0;
+    struct aq_geometry geometry;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
 
-    struct aq_board all_solution_set[MAX_SOLUTION_SET_SIZE];
-    int all_num_solutions;
-    int all_max_queens;
+    MPI_Allreduce(&found, &num_found, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    for (int i = 0; i < num_found - found; ++i) {
+        MPI_Recv(&notification, 1, MPI_INT, MPI_ANY_SOURCE, TAG_WITNESS,
+                MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
 
-    struct aq_board gathered_solution_set[MAX_MPI_PROCS][MAX_SOLUTION_SET_SIZE];
-    int gathered_num_solutions[MAX_MPI_PROCS];
-    int gathered_max_queens[MAX_MPI_PROCS];
+    if (found) {
+        MPI_Waitall(mpi_nprocs, requests, MPI_STATUSES_IGNORE);
+    }
 
-    // MPI information.
+    if (!num_found) {
+        return 0;
+    }
+
+    // The lowest ranked process with a witness gets to share it.
+    owner = found ? mpi_rank : mpi_nprocs;
+    MPI_Allreduce(MPI_IN_PLACE, &owner, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+    // A board is nothing but its slices.
+    MPI_Bcast(witness->slices, AQ_BOARD_SLICES, MPI_UINT64_T, owner,
+            MPI_COMM_WORLD);
+
+    board_geometry_init(&geometry, args->N);
+    num_queens = board_count_occupied(witness, &geometry);
+    TRACE_INFO(WITNESS, num_queens, args->target, owner);
+    return num_queens;
+}
+
+/**
+ * Runs the local search for k on every process for the given number of
+ * seconds, each with its own seed.
+ *
+ * Returns the largest number of queens found by any process, or zero. The
+ * board of the lowest ranked process that found it ends up in witness on
+ * every process.
+ */
+static inline
+int annealWitness(struct program_args *args, int k, double seconds,
+        struct aq_board *witness) {
     int mpi_rank;
     int mpi_nprocs;
+    int num_queens;
+    int all_num_queens;
+    int owner;
     MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
 
-#ifndef NDEBUG
-    assert(mpi_nprocs < MAX_MPI_PROCS &&
-           "Consider increasing MAX_MPI_PROCS");
-#endif
-
-    // Declare a new type to MPI.
-    struct aq_board mpi_board;
-    MPI_Datatype mpi_aq_board_type;
-    int mpi_aq_board_blocklen[4] = { AQ_BOARD_SLICES, 1, 1, 1 };
-    MPI_Datatype mpi_aq_board_blocktype[4] = {
-        MPI_UINT64_T,
-        MPI_INT,
-        MPI_INT,
-        MPI_INT
-    };
-    MPI_Aint mpi_aq_board_disp[4];
-    mpi_aq_board_disp[0] = (void*) &mpi_board.slices - (void*) &mpi_board;
-    mpi_aq_board_disp[1] = (void*) &mpi_board.size - (void*) &mpi_board;
-    mpi_aq_board_disp[2] = (void*) &mpi_board.bits_occupied - (void*) &mpi_board;
-    mpi_aq_board_disp[3] = (void*) &mpi_board.slices_occupied - (void*) &mpi_board;
-    MPI_Type_create_struct(4, mpi_aq_board_blocklen, mpi_aq_board_disp, 
-            mpi_aq_board_blocktype, &mpi_aq_board_type);
-    MPI_Type_commit(&mpi_aq_board_type);
-
-    // Send the solution set over.
-    MPI_Gather(&num_solutions, 1, MPI_INT, &gathered_num_solutions, 1, MPI_INT, 0,
+    num_queens = anneal_run(args->N, k, args->w, seconds,
+            0x9E3779B97F4A7C15ULL * (mpi_rank + 1), witness);
+    MPI_Allreduce(&num_queens, &all_num_queens, 1, MPI_INT, MPI_MAX,
             MPI_COMM_WORLD);
-    MPI_Gather(&max_queens, 1, MPI_INT, &gathered_max_queens, 1, MPI_INT, 0,
+
+    owner = num_queens == all_num_queens ? mpi_rank : mpi_nprocs;
+    MPI_Allreduce(MPI_IN_PLACE, &owner, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Bcast(witness->slices, AQ_BOARD_SLICES, MPI_UINT64_T, owner,
             MPI_COMM_WORLD);
-    MPI_Gather(solution_set, MAX_SOLUTION_SET_SIZE, mpi_aq_board_type,
-            &gathered_solution_set[mpi_rank], MAX_SOLUTION_SET_SIZE,
-            mpi_aq_board_type, 0,
+
+    TRACE_INFO(ANNEAL, all_num_queens, k, owner);
+    return all_num_queens;
+}
+
+/**
+ * Seeds the results of the exact search with the local search, splitting
+ * args->anneal seconds evenly over every k.
+ *
+ * Only the number of queens found is kept, as the starting maximum of every
+ * process, so that the exact search cuts every branch that cannot reach it.
+ * The board itself is not stored: it need not be one that the exact search
+ * can reach, and the results must be those of a search without a seed.
+ */
+static inline
+void seedResults(struct solver_results *results, struct program_args *args,
+        int num_k) {
+    struct aq_board seed;
+    int first_k = args->all_k ? 0 : args->k;
+
+    for (int i = 0; i < num_k; ++i) {
+        results->max_queens[i] = annealWitness(args, first_k + i,
+                args->anneal / num_k, &seed);
+    }
+}
+
+/**
+ * Returns non-zero if a seed was not reached: the search ran to the end, yet
+ * no process found a solution for a k with a non-zero maximum. The exact
+ * search only misses a seed that has more queens than any board it can
+ * reach.
+ */
+static inline
+int seedMissed(struct solver_results *results, int num_k) {
+    long counts[AQ_MAX_ATTACKS + 1];
+    int max_queens[AQ_MAX_ATTACKS + 1];
+    int open_bound[AQ_MAX_ATTACKS + 1];
+    int open = 0;
+    int missed = 0;
+
+    for (int i = 0; i < num_k; ++i) {
+        counts[i] = store_count(&results->solutions[i]);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, counts, num_k, MPI_LONG, MPI_SUM,
+            MPI_COMM_WORLD);
+    MPI_Allreduce(results->max_queens, max_queens, num_k, MPI_INT, MPI_MAX,
             MPI_COMM_WORLD);
-    MPI_Reduce(&max_queens, &all_max_queens, 1, MPI_INT, MPI_MAX, 0,
+    MPI_Allreduce(results->open_bound, open_bound, num_k, MPI_INT, MPI_MAX,
             MPI_COMM_WORLD);
 
-    // Integrate all the solutions.
+    for (int i = 0; i < num_k; ++i) {
+        missed |= max_queens[i] && !counts[i];
+        open |= open_bound[i];
+    }
+
+    return missed && !open;
+}
+
+/**
+ * Collects the witness reported by the solver in target mode, and tells
+ * every other process to stop.
+ */
+static
+void collectWitness(void *user, struct aq_board *board, int num_queens) {
+    struct solver_results *results = user;
+
+    results->witness = *board;
+    results->found = 1;
+    notifyWitness(results->witness_requests);
+}
+
+/**
+ * Stops the solver once another process has found a witness.
+ */
+static
+int pollWitness(void *user, struct aq_progress *progress) {
+    int notified = 0;
+    MPI_Iprobe(MPI_ANY_SOURCE, TAG_WITNESS, MPI_COMM_WORLD, &notified,
+            MPI_STATUS_IGNORE);
+    return notified;
+}
+
+/**
+ * Stores a heartbeat received by the root process.
+ */
+static inline
+void storeHeartbeat(struct heartbeat_state *state, struct heartbeat *beat,
+        int source) {
+    state->beats[source] = *beat;
+    state->num_done += beat->done;
+}
+
+/**
+ * Sends the heartbeat of this process to the root process. Unless it is the
+ * last one, it is skipped while the previous one is still in flight, so
+ * that a busy root process never holds up the search.
+ */
+static inline
+void sendHeartbeat(struct heartbeat_state *state, struct heartbeat *beat,
+        int mpi_rank) {
+    int completed = 1;
+
     if (mpi_rank == 0) {
-        for (i = 0; i < mpi_nprocs; ++i) {
-            LOG("gatherResults", "Number of solutions from %d: %d", i,
-                    gathered_num_solutions[i]);
+        storeHeartbeat(state, beat, 0);
+        return;
+    }
+
+    if (beat->done) {
+        MPI_Wait(&state->request, MPI_STATUS_IGNORE);
+    } else {
+        MPI_Test(&state->request, &completed, MPI_STATUS_IGNORE);
+    }
+
+    // The buffer of the previous heartbeat may only be reused once it has
+    // been sent.
+    if (completed) {
+        state->beat = *beat;
+        MPI_Isend(&state->beat, sizeof(struct heartbeat), MPI_BYTE, 0,
+                TAG_HEARTBEAT, MPI_COMM_WORLD, &state->request);
+    }
+}
+
+/**
+ * Receives every heartbeat that has arrived at the root process, waiting for
+ * one if block is set.
+ */
+static inline
+void receiveHeartbeats(struct heartbeat_state *state, int block) {
+    struct heartbeat beat;
+    MPI_Status status;
+    int arrived = block;
+
+    if (!block) {
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_HEARTBEAT, MPI_COMM_WORLD, &arrived,
+                MPI_STATUS_IGNORE);
+    }
+
+    while (arrived) {
+        MPI_Recv(&beat, sizeof(struct heartbeat), MPI_BYTE, MPI_ANY_SOURCE,
+                TAG_HEARTBEAT, MPI_COMM_WORLD, &status);
+        storeHeartbeat(state, &beat, status.MPI_SOURCE);
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_HEARTBEAT, MPI_COMM_WORLD, &arrived,
+                MPI_STATUS_IGNORE);
+    }
+}
+
+/**
+ * Sends a heartbeat once every interval, and on the root process prints the
+ * summary of the latest heartbeats of every process.
+ */
+static
+void beatHeart(struct heartbeat_state *state, struct aq_progress *progress) {
+    struct heartbeat beat;
+    double now = MPI_Wtime();
+    int mpi_rank;
+    int mpi_nprocs;
+
+    if (now - state->last < state->interval) {
+        return;
+    }
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
+
+    beat.nodes = progress->nodes;
+    beat.rate = (progress->nodes - state->last_nodes) / (now - state->last);
+    beat.depth = progress->depth;
+    beat.tasks_remaining = progress->tasks_remaining;
+    beat.max_queens = progress->max_queens;
+    beat.done = 0;
+    state->last = now;
+    state->last_nodes = progress->nodes;
+    state->latest = beat;
+    sendHeartbeat(state, &beat, mpi_rank);
+
+    if (mpi_rank == 0) {
+        receiveHeartbeats(state, 0);
+        printHeartbeat(state->beats, mpi_nprocs, now - state->start,
+                state->num_tasks, 0);
+    }
+}
+
+/**
+ * Reports progress while the solver runs.
+ */
+static
+int reportProgress(void *user, struct aq_progress *progress) {
+    struct solver_results *results = user;
+
+    if (results->heartbeat.interval) {
+        beatHeart(&results->heartbeat, progress);
+    }
+
+    // Every process watches its own deadline, so stopping on time takes no
+    // messages at all.
+    if (results->deadline && MPI_Wtime() >= results->deadline) {
+        return 1;
+    }
+
+    return results->target ? pollWitness(user, progress) : 0;
+}
+
+/**
+ * Starts the heartbeat of this process.
+ */
+static inline
+void startHeartbeat(struct heartbeat_state *state, struct program_args *args,
+        struct aq_params *params) {
+    state->interval = args->heartbeat;
+    state->num_tasks = aq_num_tasks(params);
+    state->start = MPI_Wtime();
+    state->last = state->start;
+    state->last_nodes = 0;
+    state->request = MPI_REQUEST_NULL;
+    state->beats = NULL;
+    state->num_done = 0;
+    memset(&state->latest, 0, sizeof(struct heartbeat));
+
+    if (params->rank == 0) {
+        state->beats = calloc(params->nprocs, sizeof(struct heartbeat));
+        if (state->beats == NULL) {
+            fprintf(stderr, "%s: Failed to allocate heartbeats\n",
+                    "startHeartbeat");
+            abortAll();
         }
 
-        // Remove the duplicates.
-        all_num_solutions = 0;
-        for (i = 0; i < mpi_nprocs; ++i) {
-            for (j = 0; j < gathered_num_solutions[i] &&
-                            gathered_max_queens[i] == all_max_queens; ++j) {
-                has_existing_solutions = 0;
-                for (k = 0; k < all_num_solutions; ++k) {
-                    if (boards_are_equal(&gathered_solution_set[i][j], &all_solution_set[k])) {
-                        has_existing_solutions++;
-                        break;
-                    }
-                }
-
-                if (!has_existing_solutions) {
-                    all_solution_set[all_num_solutions] = gathered_solution_set[i][j];
-                    all_num_solutions++;
-                }
-            }
+        for (int i = 0; i < params->nprocs; ++i) {
+            state->beats[i].tasks_remaining = -1;
         }
+    }
+}
 
-        if (args->l && all_num_solutions > 0) {
-            for (i = 0; i < all_num_solutions; ++i) {
-                printf("%d,%d:%d:", args->N, args->k, all_max_queens);
+/**
+ * Sends the last heartbeat of this process, and waits until it is sent, since
+ * its buffer in state goes away with the search. The root process keeps
+ * printing summaries until every process is done, so that stragglers can
+ * still be followed once its own share is finished.
+ */
+static inline
+void stopHeartbeat(struct heartbeat_state *state, struct aq_params *params,
+        int max_queens) {
+    struct heartbeat beat = state->latest;
+    double now;
 
-                for (j = 0; j < args->N; ++j) {
-                    for (k = 0; k < args->N; ++k) {
-                        if (board_is_occupied(&all_solution_set[i], j, k)) {
-                            printf("%d,", j * args->N + k);
-                        }
-                    }   
-                }
+    beat.rate = 0;
+    beat.tasks_remaining = 0;
+    beat.max_queens = max_queens;
+    beat.done = 1;
+    sendHeartbeat(state, &beat, params->rank);
+    MPI_Wait(&state->request, MPI_STATUS_IGNORE);
 
-                printf("\n");
+    if (params->rank == 0) {
+        while (state->num_done < params->nprocs) {
+            receiveHeartbeats(state, 1);
+            now = MPI_Wtime();
+            if (now - state->last >= state->interval) {
+                printHeartbeat(state->beats, params->nprocs,
+                        now - state->start, state->num_tasks, 0);
+                state->last = now;
             }
+        }
 
-        } else {
-            printf("%d,%d:%d:\n", args->N, args->k, all_max_queens);
+        free(state->beats);
+    }
+}
+
+/**
+ * Runs the Aggressive Queens algorithm.
+ *
+ * In target mode (args->target non-zero), the search stops on every process
+ * as soon as any of them finds a solution with at least args->target queens.
+ * That solution is stored in witness and its number of queens is returned.
+ * Otherwise, the results are gathered and printed, and the return value is
+ * zero. With --all-k, the results of every k up to args->k are gathered and
+ * printed in turn.
+ */
+static inline
+int godFunction(struct program_args *args, struct aq_board *witness) {
+    struct solver_results results;
+    struct aq_params params;
+    struct aq_callbacks callbacks;
+    struct program_args args_k = *args;
+    struct aq_store no_solutions;
+    struct output_state output;
+    int retval;
+    int num_k;
+    int first_k;
+
+    params.N = args->N;
+    params.k = args->k;
+    params.w = args->w;
+    params.target = args->target;
+    params.balance = args->balance;
+    params.multi = args->all_k;
+    params.order = args->order;
+    params.split_depth = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &params.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &params.nprocs);
+    TRACE_INFO(SOLVE_START, args->N, args->k, args->w, params.nprocs,
+            args->engine);
+
+    num_k = aq_num_k(&params);
+    for (int i = 0; i < num_k; ++i) {
+        store_init(&results.solutions[i], args->N, args->memory);
+        results.max_queens[i] = 0;
+    }
+
+    if (args->anneal && !args->target) {
+        seedResults(&results, args, num_k);
+    }
+
+    // A process that finds a witness notifies every process, so there is a
+    // request for each of them.
+    results.found = 0;
+    results.target = args->target;
+    results.witness_requests = NULL;
+    if (args->target) {
+        results.witness_requests = malloc(params.nprocs * sizeof(MPI_Request));
+        if (results.witness_requests == NULL) {
+            fprintf(stderr, "%s: Failed to allocate requests\n",
+                    "godFunction");
+            abortAll();
+        }
+    }
+
+    results.deadline = args->time_limit ? MPI_Wtime() + args->time_limit : 0;
+    for (int i = 0; i < num_k; ++i) {
+        results.open_bound[i] = 0;
+    }
+
+    results.heartbeat.interval = 0;
+    if (args->heartbeat) {
+        startHeartbeat(&results.heartbeat, args, &params);
+    }
+
+    // Without a heartbeat, a target or a time limit, the solver is not
+    // interrupted at all.
+    callbacks.solution = collectWitness;
+    callbacks.progress = args->target || args->heartbeat || args->time_limit ?
+        reportProgress : NULL;
+    callbacks.next_task = NULL;
+    callbacks.progress_interval = WITNESS_POLL_INTERVAL;
+    callbacks.user = &results;
+
+    if (args->engine == ENGINE_PROFILE) {
+        retval = profile_solve_multi(&params, results.solutions,
+                results.max_queens);
+    } else if (args->engine == ENGINE_JOIN) {
+        retval = join_solve_multi(&params, results.solutions,
+                results.max_queens);
+    } else {
+        retval = aq_solve_multi(&params, &callbacks, results.solutions,
+                results.max_queens, results.open_bound);
+    }
+
+    // A seed the exact search cannot reach leaves it without solutions, so
+    // it runs again without one.
+    if (retval == 0 && args->anneal && !args->target &&
+        seedMissed(&results, num_k)) {
+        for (int i = 0; i < num_k; ++i) {
+            store_clear(&results.solutions[i]);
+            results.max_queens[i] = 0;
+        }
+
+        retval = aq_solve_multi(&params, &callbacks, results.solutions,
+                results.max_queens, results.open_bound);
+    }
+
+    if (retval == -1) {
+        fprintf(stderr, "%s: Solver failed (errno %d)\n", "godFunction",
+                errno);
+        abortAll();
+    }
+
+    first_k = args->all_k ? 0 : args->k;
+    for (int i = 0; i < num_k; ++i) {
+        TRACE_INFO(SOLVE_END, first_k + i, results.max_queens[i],
+                store_count(&results.solutions[i]), results.open_bound[i]);
+    }
+
+    if (args->heartbeat) {
+        stopHeartbeat(&results.heartbeat, &params,
+                results.max_queens[num_k - 1]);
+    }
+
+    if (args->target) {
+        store_free(&results.solutions[0]);
+        *witness = results.witness;
+        retval = gatherWitness(results.found, witness,
+                results.witness_requests, args);
+        free(results.witness_requests);
+        return retval;
+    }
+
+    if (args->output) {
+        output.base = 0;
+        output.buffer = malloc(OUTPUT_CHUNK);
+        if (output.buffer == NULL ||
+            MPI_File_open(MPI_COMM_WORLD, (char*) args->output,
+                MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                &output.file) != MPI_SUCCESS ||
+            MPI_File_set_size(output.file, 0) != MPI_SUCCESS) {
+            fprintf(stderr, "%s: Failed to open %s\n", "godFunction",
+                    args->output);
+            abortAll();
         }
+    }
 
-        /*
-        printf("Number of solutions: %d\n", all_num_solutions);
-        printf("Maximum number of queens: %d\n", all_max_queens);
-        
-        for (i = 0; i < all_num_solutions; ++i) {
-            board_print(&all_solution_set[i]);
+    // No queen is attacked more than AQ_MAX_ATTACKS times, so any larger k
+    // has no solutions.
+    store_init(&no_solutions, args->N, 0);
+    PERF_PHASE(GATHER);
+    for (int i = 0; first_k + i <= args->k; ++i) {
+        args_k.k = first_k + i;
+        if (i < num_k && args->output) {
+            writeResults(&output, &results.solutions[i],
+                    results.max_queens[i], results.open_bound[i], &args_k);
+        } else if (i < num_k) {
+            gatherResults(&results.solutions[i], results.max_queens[i],
+                    results.open_bound[i], &args_k);
+        } else if (args->output) {
+            writeResults(&output, &no_solutions, 0, 0, &args_k);
+        } else {
+            gatherResults(&no_solutions, 0, 0, &args_k);
         }
-        */
     }
+
+    PERF_PHASE(OTHER);
+
+    if (args->output) {
+        MPI_File_close(&output.file);
+        free(output.buffer);
+    }
+
+    for (int i = 0; i < num_k; ++i) {
+        store_free(&results.solutions[i]);
+    }
+
+    return 0;
 }
 
 /**
- * Runs the Aggressive Queens algorithm.
+ * Runs a single instance and prints its result.
  */
 static inline
-void godFunction(struct program_args *args) {
-    // Use a simple integer for the board - we abuse the bits for queen
-    // positioning.
-    struct aq_board board = board_new(args->N);
-
-    // Prepare the task stack.
-    struct aq_stack stack = prepareTaskStack(args->N);
-    struct aq_stack stack_applied = stack_new();
-    struct aq_board solution_set[MAX_SOLUTION_SET_SIZE];
-    struct aq_move move;
-    struct aq_move next_move;
-    struct aq_move* undo_move_ptr;
-    struct aq_move undo_move;
-    int num_solutions = 0;
+void runQuery(struct program_args *args) {
+    struct aq_board witness;
+    struct aq_board seed;
+    struct aq_params params;
     int num_queens = 0;
-    int max_queens = 0;
-    int num_attacks = 0;
-    int moves_generated = 0;
-    int has_existing_solutions = 0;
-    int depth = 0;
-    int i = 0;
-    int j = 0;
-
-    // Perform a depth first search.
-    while (!stack_empty(&stack)) {
-        move = stack_pop(&stack);
-
-        // Discard impossible moves.
-        while (!stack_empty(&stack_applied)) {
-            undo_move_ptr = stack_peek_ptr(&stack_applied);
-            if (undo_move_ptr->depth >= move.depth) {
-                stack_pop(&stack_applied);
-                move_undo(&board, undo_move_ptr);
-                LOG("godFunction", "Undoing move %d, %d, depth=%d",
-                        undo_move_ptr->row, undo_move_ptr->col, depth);
-            } else {
-                depth--;
+    int lower_bound = 0;
+    int mpi_rank;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+
+    if (args->probe) {
+        params.N = args->N;
+        params.k = args->k;
+        params.w = args->w;
+        if (args->anneal) {
+            lower_bound = annealWitness(args, args->k, args->anneal, &seed);
+        }
+
+        // Each failed probe proves that no larger solution exists, so the
+        // first target that succeeds is the maximum. Targets the local
+        // search already reached need no probe.
+        for (args->target = aq_upper_bound(&params);
+                args->target > lower_bound; --args->target) {
+            num_queens = godFunction(args, &witness);
+            if (num_queens) {
                 break;
             }
         }
-        
-        // We only apply if we won't get attacked.
-        LOG("godFunction", "Applying move %d, %d, depth=%d, move.depth=%d",
-                move.row, move.col, depth, move.depth);
-        move_apply(&board, &move, move.depth);
-        stack_push(&stack_applied, move);
-        depth = move.depth;
-        //board_print(&board);
-        
-        // Accumate solutions.
-        num_queens = board_count_occupied(&board);
-        if (num_queens >= max_queens &&
-            board_max_attacks(&board) == args->k &&
-            board_all_has_same_attacks(&board)) {
-            LOG("godFunction", " ^ this is a solution");
-            if (num_queens > max_queens) {
-                num_solutions = 1;
-                solution_set[0] = board;
-                max_queens = num_queens;
-            } else {
-                has_existing_solutions = 0;
-                for (i = 0; i < num_solutions; ++i) {
-                    if (boards_are_equal(&solution_set[i], &board)) {
-                        has_existing_solutions = 1;
-                    }
-                }
-
-                if (!has_existing_solutions) {
-                    solution_set[num_solutions] = board;
-                    num_solutions++;
-                }
-            }
+
+        if (!num_queens && lower_bound) {
+            num_queens = lower_bound;
+            witness = seed;
         }
 
-        // Generate moves.
-        moves_generated = 0;
-        for (i = 0; i < args->N; ++i) {
-            for (j = 0; j < args->N; ++j) {
-                // Even though some of these conditions imply each other,
-                // they are included for performance reasons.
-                if (move.row != i && move.col != j &&
-                    !board_is_occupied(&board, i, j)) {
-                    num_attacks = args->w ?
-                        board_cell_count_attacks_wrap(&board, i, j) :
-                        board_cell_count_attacks(&board, i, j);
-                    if (num_attacks != -1 && num_attacks <= args->k &&
-                        board_simulate_max_attacks(&board, i, j) <= args->k) {
-                        next_move.row = i;
-                        next_move.col = j;
-                        next_move.applied = 0;
-                        next_move.depth = depth + 1;
-
-                        LOG("godFunction", "Generating move %d, %d, depth=%d", i, j, next_move.depth);
-                        stack_push(&stack, next_move);
-                        moves_generated++;
-                    }
-                }
-            }
+        args->target = 0;
+        if (mpi_rank == 0) {
+            printWitness(num_queens, &witness, args);
+        }
+    } else if (args->target) {
+        num_queens = godFunction(args, &witness);
+        if (mpi_rank == 0) {
+            printWitness(num_queens, &witness, args);
         }
+    } else if (args->quick) {
+        num_queens = annealWitness(args, args->k, args->anneal, &witness);
+        if (mpi_rank == 0) {
+            printWitness(num_queens, &witness, args);
+        }
+    } else {
+        godFunction(args, NULL);
+    }
 
-        // No more moves can be generated. Let's backtrack!
-        if (!moves_generated) {
-            undo_move = stack_pop(&stack_applied);
-            move_undo(&board, &undo_move);
-            LOG("godFunction", "No more moves, undoing move %d, %d, depth=%d",
-                    undo_move.row, undo_move.col, depth);
-        } else {
-            depth++;
+    fflush(stdout);
+}
+
+/**
+ * Hands a query from the root process to every other process.
+ *
+ * Only the scalar fields are sent: a string of the root process is a pointer
+ * into its own memory, so every other process gets NULL for them. Queries
+ * never carry strings anyway (see daemonParse), and the fields listed here
+ * must follow struct program_args.
+ */
+static inline
+void broadcastQuery(struct program_args *query) {
+    const int lengths[] = { 7, 1, 3, 1, 1, 1, 1, 5 };
+    const MPI_Aint offsets[] = {
+        offsetof(struct program_args, N),
+        offsetof(struct program_args, memory),
+        offsetof(struct program_args, heartbeat),
+        offsetof(struct program_args, anneal),
+        offsetof(struct program_args, quick),
+        offsetof(struct program_args, time_limit),
+        offsetof(struct program_args, engine),
+        offsetof(struct program_args, shard)
+    };
+    const MPI_Datatype types[] = {
+        MPI_INT, MPI_LONG, MPI_INT, MPI_DOUBLE, MPI_INT, MPI_DOUBLE, MPI_INT,
+        MPI_INT
+    };
+    MPI_Datatype query_type;
+    int mpi_rank;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    if (mpi_rank != 0) {
+        memset(query, 0, sizeof(struct program_args));
+    }
+
+    MPI_Type_create_struct(8, lengths, offsets, types, &query_type);
+    MPI_Type_commit(&query_type);
+    MPI_Bcast(query, 1, query_type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&query_type);
+}
+
+/**
+ * Serves queries over the socket given with --daemon, until one asks for a
+ * shutdown.
+ *
+ * Every process stays up between queries, so a query costs no start-up at
+ * all. The root process takes the queries from the socket and hands each one
+ * to every other process, which wait for it in a broadcast.
+ */
+static inline
+void serveQueries(struct program_args *args) {
+    struct daemon_state *daemon = NULL;
+    struct program_args query;
+    int running = 1;
+    int mpi_rank;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    if (mpi_rank == 0) {
+        daemon = malloc(sizeof(struct daemon_state));
+        if (daemon == NULL || daemonOpen(daemon, args->daemon) == -1) {
+            fprintf(stderr, "%s: Failed to listen on %s (errno %d)\n",
+                    "serveQueries", args->daemon, errno);
+            abortAll();
+        }
+    }
+
+    while (running) {
+        if (mpi_rank == 0) {
+            running = daemonNextQuery(daemon, &query);
+        }
+
+        MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (!running) {
+            break;
+        }
+
+        broadcastQuery(&query);
+        if (mpi_rank == 0) {
+            daemonBeginAnswer(daemon);
         }
 
+        runQuery(&query);
+        if (mpi_rank == 0) {
+            daemonEndAnswer(daemon);
+        }
     }
 
-    gatherResults(num_solutions, max_queens, solution_set, args);
+    if (mpi_rank == 0) {
+        daemonClose(daemon);
+        free(daemon);
+    }
+}
+
+/**
+ * Prints what every process counted with --perf, and the total, on the root
+ * process.
+ */
+static inline
+void reportPerf() {
+    struct perf_counts counts;
+    struct perf_counts total;
+    struct perf_counts *all = NULL;
+    char who[16];
+    int mpi_rank;
+    int mpi_nprocs;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_nprocs);
+    perf_close(&counts);
+    if (mpi_rank == 0) {
+        all = malloc(mpi_nprocs * sizeof(struct perf_counts));
+        if (all == NULL) {
+            fprintf(stderr, "%s: Failed to allocate counts\n", "reportPerf");
+            abortAll();
+        }
+    }
+
+    MPI_Gather(&counts, sizeof(counts), MPI_BYTE, all, sizeof(counts),
+            MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (mpi_rank != 0) {
+        return;
+    }
+
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < mpi_nprocs; ++i) {
+        snprintf(who, sizeof(who), "%d", i);
+        printPerf(who, &all[i]);
+        perf_add(&total, &all[i]);
+    }
+
+    printPerf("all", &total);
+    free(all);
 }
 
 /**
@@ -412,31 +1278,72 @@ void godFunction(struct program_args *args) {
  * w denotes the mode of the board.
  *     If w is zero, a normal board is used. 
  *     If w is non-zero, a wrap-around board is used.
+ *
+ * With --target q, only one solution with at least q queens is searched for.
+ * With --probe, the maximum is found by a series of such searches. With
+ * --quick, only the local search runs. In these modes, at most one solution
+ * is displayed.
+ *
+ * With --daemon, the instances come from queries instead (see daemon.h).
+ * With --trace, the trace of every process is written once it is done, or
+ * before the processes are aborted. With --perf, the counts of every process
+ * are printed once all are done.
  */
 int main(int argc, char* argv[]) {
     struct program_args args;
     int retval;
+    int rank;
 
     // But first, let me expand the stack size.
     expandStackSize();
 
+    // Merging the partial results of shards solves nothing.
+    if (argc > 1 && !strcmp(argv[1], "merge")) {
+        return mergeShards(argc - 2, argv + 2);
+    }
+
     // Read our arguments!
     retval = readProgramArgs(argc, argv, &args);
     if (retval != EXIT_OK) {
         return retval;
     }
 
-    // We've got everything we need!
-    LOG(argv[0], "Received arguments: N = %d, k = %d, l = %d, w = %d", args.N,
-        args.k, args.l, args.w);
-    
+    // A shard runs on its own, so it needs no MPI.
+    if (args.num_shards) {
+        return runShard(&args);
+    }
+
     // Initialize MPI.
-    LOG(argv[0], "Initializing MPI...");
     MPI_Init(&argc, &argv);
-    
+
+    // Every process traces into a file of its own.
+    if (args.trace) {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if (trace_open(args.trace, rank) == -1) {
+            fprintf(stderr, "%s: Failed to open trace %s (errno %d)\n",
+                    "main", args.trace, errno);
+            abortAll();
+        }
+    }
+
+    // Every process counts in itself.
+    if (args.perf && perf_open() == -1) {
+        fprintf(stderr, "%s: Performance counters unavailable (errno %d)\n",
+                "main", errno);
+    }
+
     // Run the AQ solver.
-    godFunction(&args);
+    if (args.daemon) {
+        serveQueries(&args);
+    } else {
+        runQuery(&args);
+    }
+
+    if (args.perf) {
+        reportPerf();
+    }
 
+    trace_close();
     MPI_Finalize();
     return EXIT_OK;
 }
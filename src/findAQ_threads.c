@@ -0,0 +1,747 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * This is a shared-memory implementation of a solution to the Aggressive
+ * Queens (AQ) problem, built instead of the MPI one with --without-mpi.
+ *
+ * Every thread runs its own solver instance and takes tasks from a shared
+ * pool, so there is no start-up cost beyond creating the threads. Solutions
+ * are collected in a store per thread and merged once all threads have been
+ * joined, which needs no locking.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "aq.h"
+#include "anneal.h"
+#include "board.h"
+#include "cli.h"
+#include "daemon.h"
+#include "perf.h"
+#include "join.h"
+#include "profile.h"
+#include "shard.h"
+#include "symmetry.h"
+#include "trace.h"
+
+static const int MAX_THREADS = 64;
+
+/**
+ * What every thread counted with --perf over all searches of the process,
+ * or NULL without it.
+ */
+static struct perf_counts *thread_perf = NULL;
+
+/**
+ * Environment variable overriding the number of threads, which defaults to
+ * the number of online processors.
+ */
+static const char *NUM_THREADS_ENV = "AQ_NUM_THREADS";
+
+/**
+ * State shared by all threads.
+ *
+ * With a heartbeat, every thread writes its latest heartbeat to its slot of
+ * beats, and whichever thread finds the interval has passed prints the
+ * summary. Both happen under print_lock, so the summary never sees a slot
+ * half written.
+ */
+struct shared_state {
+    struct aq_params params;
+    int num_tasks;
+    int next_task;
+    int found;
+    double deadline;
+    int engine;
+
+    int heartbeat;
+    int num_threads;
+    double start;
+    double last_print;
+    struct heartbeat *beats;
+    pthread_mutex_t print_lock;
+};
+
+/**
+ * The results reported by the solver instance of a single thread.
+ */
+struct thread_results {
+    struct aq_store solutions[AQ_MAX_ATTACKS + 1];
+    int max_queens[AQ_MAX_ATTACKS + 1];
+
+    struct aq_board witness;
+    int found;
+    int open_bound[AQ_MAX_ATTACKS + 1];
+
+    int index;
+    double last;
+    long last_nodes;
+
+    struct shared_state *shared;
+    pthread_t thread;
+};
+
+/**
+ * Function prototypes.
+ */
+static inline int getNumThreads();
+static inline int godFunction(struct program_args*, struct aq_board*);
+static inline void mergeResults(struct thread_results*, int, int, int,
+        struct program_args*);
+static inline void seedResults(struct thread_results*, int,
+        struct program_args*, int);
+static inline int seedMissed(struct thread_results*, int, int);
+static inline void runThreads(struct thread_results*, int);
+
+/**
+ * Returns the time in seconds from an arbitrary starting point.
+ */
+static inline
+double getTime() {
+    return trace_clock(CLOCK_MONOTONIC) / 1e9;
+}
+
+/**
+ * Returns the number of threads to run.
+ */
+static inline
+int getNumThreads() {
+    int num_threads = 0;
+    const char *env = getenv(NUM_THREADS_ENV);
+
+    if (env != NULL) {
+        num_threads = strtol(env, NULL, 0);
+    }
+
+    if (num_threads <= 0) {
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    if (num_threads <= 0) {
+        num_threads = 1;
+    }
+
+    return num_threads < MAX_THREADS ? num_threads : MAX_THREADS;
+}
+
+/**
+ * Hands out the next task from the shared pool, starting from the last so
+ * that tasks are visited in the same order as by a single process.
+ */
+static
+int takeTask(void *user) {
+    struct thread_results *results = user;
+    struct shared_state *shared = results->shared;
+    int index = __sync_fetch_and_add(&shared->next_task, 1);
+
+    if (index >= shared->num_tasks) {
+        return -1;
+    }
+
+    return shared->num_tasks - 1 - index;
+}
+
+/**
+ * Collects the witness reported by the solver of a thread, and tells the
+ * other threads to stop.
+ */
+static
+void collectWitness(void *user, struct aq_board *board, int num_queens) {
+    struct thread_results *results = user;
+
+    results->witness = *board;
+    results->found = 1;
+    __sync_bool_compare_and_swap(&results->shared->found, 0, 1);
+}
+
+/**
+ * Stops the solver once another thread has found a witness.
+ */
+static
+int pollWitness(void *user, struct aq_progress *progress) {
+    struct thread_results *results = user;
+    return *(volatile int*) &results->shared->found;
+}
+
+/**
+ * Updates the heartbeat of a thread once every interval, and prints the
+ * summary of every thread if no other thread is doing so.
+ */
+static
+void beatHeart(struct thread_results *results, struct aq_progress *progress) {
+    struct shared_state *shared = results->shared;
+    struct heartbeat *beat = &shared->beats[results->index];
+    double now = getTime();
+    int pending;
+
+    if (now - results->last < shared->heartbeat) {
+        return;
+    }
+
+    // A thread only ever holds the task it is running.
+    pthread_mutex_lock(&shared->print_lock);
+    beat->nodes = progress->nodes;
+    beat->rate = (progress->nodes - results->last_nodes) /
+        (now - results->last);
+    beat->depth = progress->depth;
+    beat->tasks_remaining = 1;
+    beat->max_queens = progress->max_queens;
+    results->last = now;
+    results->last_nodes = progress->nodes;
+
+    if (now - shared->last_print >= shared->heartbeat) {
+        pending = shared->num_tasks - *(volatile int*) &shared->next_task;
+        printHeartbeat(shared->beats, shared->num_threads,
+                now - shared->start, shared->num_tasks,
+                pending > 0 ? pending : 0);
+        shared->last_print = now;
+    }
+
+    pthread_mutex_unlock(&shared->print_lock);
+}
+
+/**
+ * Reports progress while the solver of a thread runs.
+ */
+static
+int reportProgress(void *user, struct aq_progress *progress) {
+    struct thread_results *results = user;
+
+    if (results->shared->heartbeat) {
+        beatHeart(results, progress);
+    }
+
+    if (results->shared->deadline && getTime() >= results->shared->deadline) {
+        return 1;
+    }
+
+    return results->shared->params.target ? pollWitness(user, progress) : 0;
+}
+
+/**
+ * Runs the solver of a single thread.
+ */
+static
+void *runThread(void *user) {
+    struct thread_results *results = user;
+    struct aq_params params = results->shared->params;
+    struct aq_callbacks callbacks;
+    struct perf_counts counts;
+    int retval;
+
+    callbacks.solution = collectWitness;
+    callbacks.progress = results->shared->params.target ||
+                         results->shared->heartbeat ||
+                         results->shared->deadline ? reportProgress : NULL;
+    callbacks.next_task = takeTask;
+    callbacks.progress_interval = 0;
+    callbacks.user = results;
+    trace_thread = results->index;
+    if (thread_perf != NULL && perf_open() == -1) {
+        fprintf(stderr, "%s: Performance counters unavailable (errno %d)\n",
+                "runThread", errno);
+    }
+
+    // The profile and join engines have no task pool, so they split their
+    // work between the threads as between processes.
+    if (results->shared->engine != ENGINE_DFS) {
+        params.rank = results->index;
+        params.nprocs = results->shared->num_threads;
+        retval = results->shared->engine == ENGINE_JOIN ?
+            join_solve_multi(&params, results->solutions,
+                    results->max_queens) :
+            profile_solve_multi(&params, results->solutions,
+                    results->max_queens);
+    } else {
+        retval = aq_solve_multi(&params, &callbacks, results->solutions,
+                results->max_queens, results->open_bound);
+    }
+
+    for (int i = 0; i < aq_num_k(&params); ++i) {
+        TRACE_INFO(SOLVE_END, (params.multi ? 0 : params.k) + i,
+                results->max_queens[i], store_count(&results->solutions[i]),
+                results->open_bound[i]);
+    }
+
+    if (retval == -1) {
+        fprintf(stderr, "%s: Solver failed (errno %d)\n", "runThread",
+                errno);
+        exit(EXIT_UNKNOWN);
+    }
+
+    if (results->shared->heartbeat) {
+        pthread_mutex_lock(&results->shared->print_lock);
+        results->shared->beats[results->index].tasks_remaining = 0;
+        results->shared->beats[results->index].rate = 0;
+        results->shared->beats[results->index].done = 1;
+        pthread_mutex_unlock(&results->shared->print_lock);
+    }
+
+    if (thread_perf != NULL) {
+        perf_close(&counts);
+        perf_add(&thread_perf[results->index], &counts);
+    }
+
+    return NULL;
+}
+
+/**
+ * Merges the results of every thread for the index-th k into the store of
+ * the first thread with the most queens, in the same way as gatherResults
+ * does for every process of the MPI build, including the bound with
+ * --time-limit.
+ */
+static inline
+void mergeResults(struct thread_results *results, int num_threads, int index,
+        int open_bound, struct program_args *args) {
+    int all = 0;
+
+    for (int i = 0; i < num_threads; ++i) {
+        TRACE_INFO(GATHER_SOURCE, i, store_count(&results[i].solutions[index]),
+                results[i].max_queens[index]);
+        if (results[i].max_queens[index] > results[all].max_queens[index]) {
+            all = i;
+        }
+    }
+
+    // The stores drop the duplicates.
+    for (int i = 0; i < num_threads; ++i) {
+        if (i == all ||
+            results[i].max_queens[index] != results[all].max_queens[index]) {
+            continue;
+        }
+
+        if (store_merge(&results[all].solutions[index],
+                    &results[i].solutions[index]) == -1) {
+            fprintf(stderr, "%s: Failed to merge solutions (errno %d)\n",
+                    "mergeResults", errno);
+            exit(EXIT_UNKNOWN);
+        }
+    }
+
+    TRACE_INFO(GATHER_END, args->k, results[all].max_queens[index],
+            store_count(&results[all].solutions[index]));
+    printSolutions(&results[all].solutions[index],
+            results[all].max_queens[index], args);
+    if (args->time_limit) {
+        printBound(results[all].max_queens[index], open_bound, args);
+    }
+}
+
+/**
+ * Seeds the results of the exact search with the local search, splitting
+ * args->anneal seconds evenly over every k.
+ *
+ * The local search runs on the main thread before any solver starts. Only
+ * the number of queens found is kept, as the starting maximum of every
+ * thread, so that the exact search cuts every branch that cannot reach it.
+ * The board itself is not stored: it need not be one that the exact search
+ * can reach, and the results must be those of a search without a seed.
+ */
+static inline
+void seedResults(struct thread_results *results, int num_threads,
+        struct program_args *args, int num_k) {
+    struct aq_board seed;
+    int first_k = args->all_k ? 0 : args->k;
+    int num_queens;
+
+    for (int i = 0; i < num_k; ++i) {
+        num_queens = anneal_run(args->N, first_k + i, args->w,
+                args->anneal / num_k, 0, &seed);
+        for (int j = 0; j < num_threads; ++j) {
+            results[j].max_queens[i] = num_queens;
+        }
+    }
+}
+
+/**
+ * Returns non-zero if a seed was not reached: every task was run to the end,
+ * yet no thread found a solution for a k with a non-zero maximum. The exact
+ * search only misses a seed that has more queens than any board it can
+ * reach.
+ */
+static inline
+int seedMissed(struct thread_results *results, int num_threads, int num_k) {
+    struct shared_state *shared = results[0].shared;
+    size_t count;
+    int max_queens;
+
+    if (shared->next_task < shared->num_tasks) {
+        return 0;
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        for (int j = 0; j < num_k; ++j) {
+            if (results[i].open_bound[j]) {
+                return 0;
+            }
+        }
+    }
+
+    for (int j = 0; j < num_k; ++j) {
+        count = 0;
+        max_queens = 0;
+        for (int i = 0; i < num_threads; ++i) {
+            count += store_count(&results[i].solutions[j]);
+            if (results[i].max_queens[j] > max_queens) {
+                max_queens = results[i].max_queens[j];
+            }
+        }
+
+        if (max_queens && !count) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Runs the solver of every thread to the end.
+ */
+static inline
+void runThreads(struct thread_results *results, int num_threads) {
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_create(&results[i].thread, NULL, runThread, &results[i]);
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(results[i].thread, NULL);
+    }
+}
+
+/**
+ * Runs the Aggressive Queens algorithm.
+ *
+ * Behaves like godFunction of the MPI build: in target mode the witness is
+ * stored and its number of queens returned, otherwise the merged results
+ * are printed and the return value is zero.
+ */
+static inline
+int godFunction(struct program_args *args, struct aq_board *witness) {
+    struct shared_state shared;
+    struct thread_results *results;
+    struct program_args args_k = *args;
+    struct aq_store no_solutions;
+    int num_threads = getNumThreads();
+    int num_queens = 0;
+    int open_bound[AQ_MAX_ATTACKS + 1];
+    int bounds[AQ_MAX_ATTACKS + 1];
+    struct aq_geometry geometry;
+    int num_k;
+    int first_k;
+
+    shared.params.N = args->N;
+    shared.params.k = args->k;
+    shared.params.w = args->w;
+    shared.params.target = args->target;
+    shared.params.balance = 0;
+    shared.params.multi = args->all_k;
+    shared.params.order = args->order;
+    shared.params.split_depth = 0;
+    shared.params.rank = 0;
+    shared.params.nprocs = 1;
+    shared.num_tasks = aq_num_tasks(&shared.params);
+    num_k = aq_num_k(&shared.params);
+    shared.next_task = 0;
+    shared.found = 0;
+    shared.heartbeat = args->heartbeat;
+    shared.engine = args->engine;
+    shared.num_threads = num_threads;
+    shared.start = getTime();
+    shared.deadline = args->time_limit ? shared.start + args->time_limit : 0;
+    shared.last_print = shared.start;
+    pthread_mutex_init(&shared.print_lock, NULL);
+    TRACE_INFO(SOLVE_START, args->N, args->k, args->w, num_threads,
+            args->engine);
+
+    results = calloc(num_threads, sizeof(struct thread_results));
+    shared.beats = calloc(num_threads, sizeof(struct heartbeat));
+    if (results == NULL || shared.beats == NULL) {
+        fprintf(stderr, "%s: Failed to allocate results for %d threads\n",
+                "godFunction", num_threads);
+        exit(EXIT_UNKNOWN);
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        results[i].shared = &shared;
+        results[i].index = i;
+        results[i].last = shared.start;
+        shared.beats[i].tasks_remaining = -1;
+        for (int j = 0; j < num_k; ++j) {
+            store_init(&results[i].solutions[j], args->N, args->memory);
+        }
+    }
+
+    if (args->anneal && !args->target) {
+        seedResults(results, num_threads, args, num_k);
+    }
+
+    runThreads(results, num_threads);
+
+    // A seed the exact search cannot reach leaves it without solutions, so
+    // it runs again without one.
+    if (args->anneal && !args->target &&
+        seedMissed(results, num_threads, num_k)) {
+        shared.next_task = 0;
+        for (int i = 0; i < num_threads; ++i) {
+            shared.beats[i].done = 0;
+            for (int j = 0; j < num_k; ++j) {
+                store_clear(&results[i].solutions[j]);
+                results[i].max_queens[j] = 0;
+            }
+        }
+
+        runThreads(results, num_threads);
+    }
+
+    if (args->target) {
+        for (int i = 0; i < num_threads; ++i) {
+            if (results[i].found) {
+                *witness = results[i].witness;
+                board_geometry_init(&geometry, args->N);
+                num_queens = board_count_occupied(witness, &geometry);
+                break;
+            }
+        }
+    } else {
+        // Out of time, the tasks no thread took are as open as those cut
+        // short.
+        for (int j = 0; j < num_k; ++j) {
+            open_bound[j] = 0;
+            for (int i = 0; i < num_threads; ++i) {
+                if (results[i].open_bound[j] > open_bound[j]) {
+                    open_bound[j] = results[i].open_bound[j];
+                }
+            }
+        }
+
+        for (int i = shared.next_task; args->time_limit &&
+                i < shared.num_tasks; ++i) {
+            aq_task_bound(&shared.params, shared.num_tasks - 1 - i, bounds);
+            for (int j = 0; j < num_k; ++j) {
+                if (bounds[j] > open_bound[j]) {
+                    open_bound[j] = bounds[j];
+                }
+            }
+        }
+
+        // No queen is attacked more than AQ_MAX_ATTACKS times, so any
+        // larger k has no solutions.
+        store_init(&no_solutions, args->N, 0);
+        first_k = args->all_k ? 0 : args->k;
+        PERF_PHASE(GATHER);
+        for (int i = 0; first_k + i <= args->k; ++i) {
+            args_k.k = first_k + i;
+            if (i < num_k) {
+                mergeResults(results, num_threads, i, open_bound[i],
+                        &args_k);
+            } else {
+                printSolutions(&no_solutions, 0, &args_k);
+                if (args->time_limit) {
+                    printBound(0, 0, &args_k);
+                }
+            }
+        }
+
+        PERF_PHASE(OTHER);
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        for (int j = 0; j < num_k; ++j) {
+            store_free(&results[i].solutions[j]);
+        }
+    }
+
+    pthread_mutex_destroy(&shared.print_lock);
+    free(shared.beats);
+    free(results);
+    return num_queens;
+}
+
+/**
+ * Runs a single instance and prints its result.
+ */
+static inline
+void runQuery(struct program_args *args) {
+    struct aq_board witness;
+    struct aq_board seed;
+    struct aq_params params;
+    int num_queens = 0;
+    int lower_bound = 0;
+
+    if (args->probe) {
+        params.N = args->N;
+        params.k = args->k;
+        params.w = args->w;
+        if (args->anneal) {
+            lower_bound = anneal_run(args->N, args->k, args->w, args->anneal,
+                    0, &seed);
+        }
+
+        // Each failed probe proves that no larger solution exists, so the
+        // first target that succeeds is the maximum. Targets the local
+        // search already reached need no probe.
+        for (args->target = aq_upper_bound(&params);
+                args->target > lower_bound; --args->target) {
+            num_queens = godFunction(args, &witness);
+            if (num_queens) {
+                break;
+            }
+        }
+
+        if (!num_queens && lower_bound) {
+            num_queens = lower_bound;
+            witness = seed;
+        }
+
+        args->target = 0;
+        printWitness(num_queens, &witness, args);
+    } else if (args->target) {
+        num_queens = godFunction(args, &witness);
+        printWitness(num_queens, &witness, args);
+    } else if (args->quick) {
+        num_queens = anneal_run(args->N, args->k, args->w, args->anneal, 0,
+                &witness);
+        printWitness(num_queens, &witness, args);
+    } else if (args->output) {
+        // A single process has nothing to spread, so the results are
+        // printed as usual, only into the file. --output is never part of a
+        // daemon query, so stdout is not needed afterwards.
+        if (freopen(args->output, "w", stdout) == NULL) {
+            fprintf(stderr, "%s: Failed to open %s (errno %d)\n",
+                    "runQuery", args->output, errno);
+            exit(EXIT_UNKNOWN);
+        }
+
+        godFunction(args, NULL);
+    } else {
+        godFunction(args, NULL);
+    }
+
+    fflush(stdout);
+}
+
+/**
+ * Prints what every thread counted with --perf, then what the main thread,
+ * which merges the results, counted, and the total.
+ */
+static inline
+void reportPerf() {
+    struct perf_counts counts;
+    struct perf_counts total;
+    char who[16];
+
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < getNumThreads(); ++i) {
+        snprintf(who, sizeof(who), "%d", i);
+        printPerf(who, &thread_perf[i]);
+        perf_add(&total, &thread_perf[i]);
+    }
+
+    perf_close(&counts);
+    printPerf("main", &counts);
+    perf_add(&total, &counts);
+    printPerf("all", &total);
+}
+
+/**
+ * Serves queries over the socket given with --daemon, until one asks for a
+ * shutdown. The process stays up between queries, and the threads of each
+ * query cost next to nothing to start.
+ */
+static inline
+void serveQueries(struct program_args *args) {
+    struct daemon_state *daemon = malloc(sizeof(struct daemon_state));
+    struct program_args query;
+
+    if (daemon == NULL || daemonOpen(daemon, args->daemon) == -1) {
+        fprintf(stderr, "%s: Failed to listen on %s (errno %d)\n",
+                "serveQueries", args->daemon, errno);
+        exit(EXIT_UNKNOWN);
+    }
+
+    while (daemonNextQuery(daemon, &query)) {
+        daemonBeginAnswer(daemon);
+        runQuery(&query);
+        daemonEndAnswer(daemon);
+    }
+
+    daemonClose(daemon);
+    free(daemon);
+}
+
+/**
+ * Takes the same arguments as the MPI build, and prints the same output.
+ * See findAQ.c.
+ */
+int main(int argc, char* argv[]) {
+    struct program_args args;
+    int retval;
+
+    // But first, let me expand the stack size.
+    expandStackSize();
+
+    // Merging the partial results of shards solves nothing.
+    if (argc > 1 && !strcmp(argv[1], "merge")) {
+        return mergeShards(argc - 2, argv + 2);
+    }
+
+    // Read our arguments!
+    retval = readProgramArgs(argc, argv, &args);
+    if (retval != EXIT_OK) {
+        return retval;
+    }
+
+    // A shard runs on its own, so it needs no MPI.
+    if (args.num_shards) {
+        return runShard(&args);
+    }
+
+    // The threads share the trace of the process, and the last one is
+    // written at exit.
+    if (args.trace && trace_open(args.trace, 0) == -1) {
+        fprintf(stderr, "%s: Failed to open trace %s (errno %d)\n", "main",
+                args.trace, errno);
+        return EXIT_UNKNOWN;
+    }
+
+    // Every thread counts in itself, the main thread included.
+    if (args.perf) {
+        thread_perf = calloc(getNumThreads(), sizeof(struct perf_counts));
+        if (thread_perf == NULL) {
+            fprintf(stderr, "%s: Failed to allocate counts\n", "main");
+            return EXIT_UNKNOWN;
+        }
+
+        if (perf_open() == -1) {
+            fprintf(stderr, "%s: Performance counters unavailable "
+                    "(errno %d)\n", "main", errno);
+        }
+    }
+
+    // Run the AQ solver.
+    if (args.daemon) {
+        serveQueries(&args);
+    } else {
+        runQuery(&args);
+    }
+
+    if (args.perf) {
+        reportPerf();
+        free(thread_perf);
+    }
+
+    return EXIT_OK;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,882 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A meet-in-the-middle engine for normal boards.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "join.h"
+#include "trace.h"
+
+/**
+ * A set of lines, one bit per line.
+ */
+struct join_lines {
+    uint64_t bits[2];
+};
+
+/**
+ * The signature of a half. slots holds, for every line crossing the
+ * midline, the queen nearest to it, or -1, and needed the number of attacks
+ * every such queen still needs. Queens are numbered in the order their
+ * first line comes up, and the unused bytes are zero, so that equal
+ * signatures are equal byte for byte.
+ */
+struct join_signature {
+    int num_queens;
+    int8_t slots[AQ_JOIN_MAX_LINES];
+    int8_t needed[AQ_JOIN_MAX_LINES];
+};
+
+/**
+ * A placement of a half with the most queens of its signature, kept when
+ * that signature takes part in a largest solution.
+ */
+struct join_placement {
+    size_t signature;
+    struct aq_board board;
+};
+
+/**
+ * Every signature of one half, the top half or the bottom half if flip is
+ * set, which has rows rows.
+ *
+ * best holds the most queens of any placement with each signature, and used
+ * whether the signature takes part in a largest solution. index is an
+ * open-addressing hash table holding the position of every signature plus
+ * one. Once the join is done, the placements of the used signatures are
+ * gathered, and those of the i-th signature are the num_placements[i] from
+ * first_placement[i].
+ */
+struct join_half {
+    int flip;
+    int rows;
+
+    struct join_signature *signatures;
+    int *best;
+    char *used;
+    size_t count;
+    size_t capacity;
+    size_t *index;
+    size_t index_capacity;
+
+    struct join_placement *placements;
+    size_t placements_count;
+    size_t placements_capacity;
+    size_t *first_placement;
+    size_t *num_placements;
+};
+
+/**
+ * An entry of the join table: a signature of the bottom half with the most
+ * queens num_queens, and a set of its lines the top half may occupy. next is
+ * the position of the next entry of the same bucket plus one, or zero.
+ */
+struct join_entry {
+    struct join_lines lines;
+    size_t signature;
+    size_t next;
+    int num_queens;
+};
+
+/**
+ * A pair of signatures, of the top and the bottom half, making a largest
+ * solution.
+ */
+struct join_pair {
+    size_t top;
+    size_t bottom;
+};
+
+/**
+ * The state of one run of the engine, for a single k.
+ *
+ * lines gives the column, diagonal and anti-diagonal of every cell, and on
+ * which side of every row each line has cells (see lines.h). The signatures of the top half are shared out between
+ * nprocs instances round-robin, of which this is the rank-th.
+ *
+ * While a half is enumerated, slots holds the queen last placed on every
+ * line, and attacks the number of attacks on every queen so far.
+ */
+struct join_context {
+    int size;
+    int k;
+    int rank;
+    int nprocs;
+    struct aq_lines lines;
+
+    struct join_half top;
+    struct join_half bottom;
+
+    struct join_entry *entries;
+    size_t entries_count;
+    size_t entries_capacity;
+    size_t *buckets;
+    size_t num_buckets;
+    struct join_lines *occupied;
+
+    struct join_pair *pairs;
+    size_t pairs_count;
+    size_t pairs_capacity;
+    int max_queens;
+    size_t current;
+
+    struct aq_geometry geometry;
+    struct aq_board board;
+    int num_queens;
+    int8_t slots[AQ_JOIN_MAX_LINES];
+    int attacks[AQ_BOARD_MAX_CELLS];
+    int collect;
+    int error;
+};
+
+/**
+ * Makes room for one more element in an array that grows by doubling.
+ * Returns 0, or -1 with errno set.
+ */
+static
+int join_reserve(void **array, size_t *capacity, size_t count, size_t size) {
+    size_t new_capacity;
+    void *grown;
+
+    if (count < *capacity) {
+        return 0;
+    }
+
+    new_capacity = *capacity ? *capacity * 2 : AQ_JOIN_INITIAL_CAPACITY;
+    grown = realloc(*array, new_capacity * size);
+    if (grown == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    *array = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * Returns the slot of the index of a half holding a signature, or the empty
+ * slot where it would go.
+ */
+static inline
+size_t join_find(struct join_half *half,
+        const struct join_signature *signature) {
+    size_t mask = half->index_capacity - 1;
+    size_t slot = lines_hash(signature, sizeof(*signature)) & mask;
+
+    for (;; slot = (slot + 1) & mask) {
+        if (!half->index[slot] ||
+            !memcmp(&half->signatures[half->index[slot] - 1], signature,
+                sizeof(*signature))) {
+            return slot;
+        }
+    }
+}
+
+/**
+ * Doubles the index of a half and re-inserts every signature.
+ */
+static
+int join_grow(struct join_half *half) {
+    size_t capacity = half->index_capacity ?
+        half->index_capacity * 2 : AQ_JOIN_INITIAL_CAPACITY;
+    size_t *old = half->index;
+
+    half->index = calloc(capacity, sizeof(size_t));
+    if (half->index == NULL) {
+        half->index = old;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    half->index_capacity = capacity;
+    for (size_t i = 0; i < half->count; ++i) {
+        half->index[join_find(half, &half->signatures[i])] = i + 1;
+    }
+
+    free(old);
+    return 0;
+}
+
+/**
+ * Records a placement of a half with num_queens queens and the given
+ * signature, keeping the most queens of every signature.
+ */
+static
+int join_remember(struct join_half *half,
+        const struct join_signature *signature, int num_queens) {
+    size_t slot;
+
+    // Keep the index at most half full.
+    if (2 * (half->count + 1) > half->index_capacity &&
+        join_grow(half) == -1) {
+        return -1;
+    }
+
+    slot = join_find(half, signature);
+    if (half->index[slot]) {
+        if (num_queens > half->best[half->index[slot] - 1]) {
+            half->best[half->index[slot] - 1] = num_queens;
+        }
+
+        return 0;
+    }
+
+    if (half->count == half->capacity) {
+        size_t capacity = half->capacity;
+        size_t count = half->count;
+        if (join_reserve((void**) &half->signatures, &capacity, count,
+                    sizeof(struct join_signature)) == -1 ||
+            join_reserve((void**) &half->best, &half->capacity, count,
+                sizeof(int)) == -1) {
+            return -1;
+        }
+    }
+
+    half->signatures[half->count] = *signature;
+    half->best[half->count] = num_queens;
+    half->index[slot] = ++half->count;
+    return 0;
+}
+
+/**
+ * Keeps a placement of a half whose signature takes part in a largest
+ * solution, if it has the most queens of that signature.
+ */
+static
+int join_keep(struct join_context *ctx, struct join_half *half,
+        const struct join_signature *signature, int num_queens) {
+    size_t slot = join_find(half, signature);
+    size_t i = half->index[slot] - 1;
+
+    if (!half->used[i] || num_queens != half->best[i]) {
+        return 0;
+    }
+
+    if (join_reserve((void**) &half->placements, &half->placements_capacity,
+                half->placements_count, sizeof(struct join_placement)) == -1) {
+        return -1;
+    }
+
+    half->placements[half->placements_count].signature = i;
+    half->placements[half->placements_count].board = ctx->board;
+    half->placements_count++;
+    return 0;
+}
+
+/**
+ * Returns the lines that have cells on the far side of the r-th row of a
+ * half, counted from its outer edge.
+ */
+static inline
+const uint8_t *join_live(struct join_context *ctx, struct join_half *half,
+        int r) {
+    return half->flip ? ctx->lines.above[ctx->size - 1 - r] :
+                        ctx->lines.below[r];
+}
+
+/**
+ * Checks the queens of a half once the r-th row is placed. Returns 0 if some
+ * queen can no longer be attacked exactly k times, since every line it is
+ * last on adds at most one attack.
+ */
+static
+int join_row_done(struct join_context *ctx, struct join_half *half, int r) {
+    const uint8_t *live = join_live(ctx, half, r);
+    int open[AQ_BOARD_MAX_CELLS];
+
+    memset(open, 0, ctx->num_queens * sizeof(int));
+    for (int i = 0; i < ctx->lines.num_lines; ++i) {
+        if (live[i] && ctx->slots[i] != -1) {
+            open[(int) ctx->slots[i]]++;
+        }
+    }
+
+    for (int i = 0; i < ctx->num_queens; ++i) {
+        if (ctx->k - ctx->attacks[i] > open[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Handles a fully placed half: records its signature, or keeps it.
+ */
+static
+void join_finish(struct join_context *ctx, struct join_half *half) {
+    const uint8_t *live = join_live(ctx, half, half->rows - 1);
+    struct join_signature signature;
+    int8_t map[AQ_BOARD_MAX_CELLS];
+    int queen;
+
+    memset(&signature, 0, sizeof(signature));
+    memset(signature.slots, -1, sizeof(signature.slots));
+    memset(map, -1, ctx->num_queens);
+    for (int i = 0; i < ctx->lines.num_lines; ++i) {
+        if (!live[i] || ctx->slots[i] == -1) {
+            continue;
+        }
+
+        queen = ctx->slots[i];
+        if (map[queen] == -1) {
+            map[queen] = signature.num_queens;
+            signature.needed[signature.num_queens++] =
+                ctx->k - ctx->attacks[queen];
+        }
+
+        signature.slots[i] = map[queen];
+    }
+
+    if ((ctx->collect ?
+         join_keep(ctx, half, &signature, ctx->num_queens) :
+         join_remember(half, &signature, ctx->num_queens)) == -1) {
+        ctx->error = errno;
+    }
+}
+
+/**
+ * Places the rest of a half from a cell on, trying every placement.
+ * last is the queen last placed on the current row, or -1.
+ *
+ * Attacks only grow as queens are added, so a new queen that already sees
+ * more than k queens, or a queen it attacks that is attacked more than k
+ * times, ends the placement.
+ */
+static
+void join_place(struct join_context *ctx, struct join_half *half, int r,
+        int c, int last) {
+    int row = half->flip ? ctx->size - 1 - r : r;
+    const uint8_t *lines = ctx->lines.cells[row][c];
+    int queen = ctx->num_queens;
+    int8_t saved[3];
+    int attacks = 0;
+    int legal = 1;
+
+    if (ctx->error) {
+        return;
+    }
+
+    if (c == ctx->size) {
+        if (!join_row_done(ctx, half, r)) {
+            return;
+        }
+
+        if (r + 1 == half->rows) {
+            join_finish(ctx, half);
+        } else {
+            join_place(ctx, half, r + 1, 0, -1);
+        }
+
+        return;
+    }
+
+    join_place(ctx, half, r, c + 1, last);
+
+    // A queen on the cell sees the queen last placed on each of its lines,
+    // and the last queen of the row, which in turn see it.
+    for (int i = 0; i < 3; ++i) {
+        if (ctx->slots[lines[i]] != -1) {
+            attacks++;
+            legal &= ++ctx->attacks[(int) ctx->slots[lines[i]]] <= ctx->k;
+        }
+    }
+
+    if (last != -1) {
+        attacks++;
+        legal &= ++ctx->attacks[last] <= ctx->k;
+    }
+
+    if (legal && attacks <= ctx->k) {
+        ctx->attacks[queen] = attacks;
+        for (int i = 0; i < 3; ++i) {
+            saved[i] = ctx->slots[lines[i]];
+            ctx->slots[lines[i]] = queen;
+        }
+
+        ctx->num_queens++;
+        board_set_occupied(&ctx->board, &ctx->geometry, row, c);
+        join_place(ctx, half, r, c + 1, queen);
+        board_set_unoccupied(&ctx->board, &ctx->geometry, row, c);
+        ctx->num_queens--;
+
+        for (int i = 0; i < 3; ++i) {
+            ctx->slots[lines[i]] = saved[i];
+        }
+    }
+
+    if (last != -1) {
+        ctx->attacks[last]--;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        if (ctx->slots[lines[i]] != -1) {
+            ctx->attacks[(int) ctx->slots[lines[i]]]--;
+        }
+    }
+}
+
+/**
+ * Enumerates every placement of a half.
+ */
+static inline
+void join_enumerate(struct join_context *ctx, struct join_half *half) {
+    ctx->num_queens = 0;
+    memset(ctx->slots, -1, sizeof(ctx->slots));
+    join_place(ctx, half, 0, 0, -1);
+}
+
+/**
+ * Returns the lines a signature occupies.
+ */
+static inline
+struct join_lines join_occupied(struct join_context *ctx,
+        const struct join_signature *signature) {
+    struct join_lines occupied = { { 0, 0 } };
+
+    for (int i = 0; i < ctx->lines.num_lines; ++i) {
+        if (signature->slots[i] != -1) {
+            occupied.bits[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+
+    return occupied;
+}
+
+/**
+ * Adds an entry for the index-th signature of the bottom half to the join
+ * table, for join_subsets.
+ */
+static
+void join_insert(struct join_context *ctx, size_t index,
+        const struct join_lines *lines) {
+    if (join_reserve((void**) &ctx->entries, &ctx->entries_capacity,
+                ctx->entries_count, sizeof(struct join_entry)) == -1) {
+        ctx->error = errno;
+        return;
+    }
+
+    ctx->entries[ctx->entries_count].lines = *lines;
+    ctx->entries[ctx->entries_count].signature = index;
+    ctx->entries[ctx->entries_count].num_queens = ctx->bottom.best[index];
+    ctx->entries_count++;
+}
+
+/**
+ * Looks up the signatures of the bottom half that join the index-th
+ * signature of the top half, when lines are the lines both occupy, for
+ * join_subsets.
+ *
+ * The entries of a bucket with the same lines only say that each half gets
+ * the attacks it needs from lines. They join if the halves share no other
+ * line either. Before the largest solution is known, this only finds it;
+ * after, every pair making it is kept. Buckets hold the most queens first,
+ * so the rest of a bucket is skipped once it cannot make the largest
+ * solution.
+ */
+static
+void join_match(struct join_context *ctx, size_t index,
+        const struct join_lines *lines) {
+    struct join_lines top = join_occupied(ctx,
+            &ctx->top.signatures[index]);
+    size_t bucket = lines_hash(lines, sizeof(*lines)) & (ctx->num_buckets - 1);
+    struct join_entry *entry;
+    int num_queens;
+
+    for (size_t e = ctx->buckets[bucket]; e; e = entry->next) {
+        entry = &ctx->entries[e - 1];
+        num_queens = ctx->top.best[index] + entry->num_queens;
+        if (num_queens < ctx->max_queens ||
+            (num_queens == ctx->max_queens && !ctx->collect)) {
+            return;
+        }
+
+        if (memcmp(&entry->lines, lines, sizeof(*lines)) ||
+            ((top.bits[0] & ctx->occupied[entry->signature].bits[0]) &
+             ~lines->bits[0]) ||
+            ((top.bits[1] & ctx->occupied[entry->signature].bits[1]) &
+             ~lines->bits[1])) {
+            continue;
+        }
+
+        if (!ctx->collect) {
+            ctx->max_queens = num_queens;
+            continue;
+        }
+
+        if (join_reserve((void**) &ctx->pairs, &ctx->pairs_capacity,
+                    ctx->pairs_count, sizeof(struct join_pair)) == -1) {
+            ctx->error = errno;
+            return;
+        }
+
+        ctx->pairs[ctx->pairs_count].top = index;
+        ctx->pairs[ctx->pairs_count].bottom = entry->signature;
+        ctx->pairs_count++;
+        ctx->top.used[index] = 1;
+        ctx->bottom.used[entry->signature] = 1;
+    }
+}
+
+/**
+ * Calls visit with every set of lines of a signature the other half may
+ * occupy, from its queen-th queen on: for every queen, as many of the lines
+ * it is on as it needs attacks.
+ */
+static
+void join_subsets(struct join_context *ctx, size_t index,
+        const struct join_signature *signature, int queen,
+        struct join_lines *lines,
+        void (*visit)(struct join_context*, size_t, const struct join_lines*)) {
+    int own[3];
+    int num_own = 0;
+    int count;
+
+    if (ctx->error) {
+        return;
+    }
+
+    if (queen == signature->num_queens) {
+        visit(ctx, index, lines);
+        return;
+    }
+
+    for (int i = 0; i < ctx->lines.num_lines && num_own < 3; ++i) {
+        if (signature->slots[i] == queen) {
+            own[num_own++] = i;
+        }
+    }
+
+    for (int subset = 0; subset < 1 << num_own; ++subset) {
+        count = 0;
+        for (int i = 0; i < num_own; ++i) {
+            count += subset >> i & 1;
+        }
+
+        if (count != signature->needed[queen]) {
+            continue;
+        }
+
+        for (int i = 0; i < num_own; ++i) {
+            if (subset >> i & 1) {
+                lines->bits[own[i] / 64] |= 1ULL << (own[i] % 64);
+            }
+        }
+
+        join_subsets(ctx, index, signature, queen + 1, lines, visit);
+
+        for (int i = 0; i < num_own; ++i) {
+            lines->bits[own[i] / 64] &= ~(1ULL << (own[i] % 64));
+        }
+    }
+}
+
+/**
+ * Orders entries of the join table by most queens first.
+ */
+static
+int join_entry_compare(const void *p1, const void *p2) {
+    const struct join_entry *a = p1;
+    const struct join_entry *b = p2;
+
+    return (b->num_queens > a->num_queens) - (b->num_queens < a->num_queens);
+}
+
+/**
+ * Builds the join table over the signatures of the bottom half.
+ */
+static
+int join_build(struct join_context *ctx) {
+    struct join_lines lines = { { 0, 0 } };
+    size_t bucket;
+
+    ctx->occupied = malloc((ctx->bottom.count + 1) *
+            sizeof(struct join_lines));
+    if (ctx->occupied == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (size_t i = 0; i < ctx->bottom.count && !ctx->error; ++i) {
+        ctx->occupied[i] = join_occupied(ctx, &ctx->bottom.signatures[i]);
+        join_subsets(ctx, i, &ctx->bottom.signatures[i], 0, &lines,
+                join_insert);
+    }
+
+    if (ctx->error) {
+        errno = ctx->error;
+        return -1;
+    }
+
+    // Keep the table at most half full.
+    ctx->num_buckets = 1;
+    while (ctx->num_buckets < 2 * ctx->entries_count) {
+        ctx->num_buckets *= 2;
+    }
+
+    ctx->buckets = calloc(ctx->num_buckets, sizeof(size_t));
+    if (ctx->buckets == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Link every bucket from its fewest queens up, so that it starts with
+    // the most.
+    qsort(ctx->entries, ctx->entries_count, sizeof(struct join_entry),
+            join_entry_compare);
+    for (size_t i = ctx->entries_count; i-- > 0;) {
+        bucket = lines_hash(&ctx->entries[i].lines,
+                sizeof(struct join_lines)) & (ctx->num_buckets - 1);
+        ctx->entries[i].next = ctx->buckets[bucket];
+        ctx->buckets[bucket] = i + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Probes the join table with this instance's share of the signatures of
+ * the top half.
+ */
+static
+void join_probe(struct join_context *ctx) {
+    struct join_lines lines = { { 0, 0 } };
+
+    for (size_t i = ctx->rank; i < ctx->top.count && !ctx->error;
+            i += ctx->nprocs) {
+        join_subsets(ctx, i, &ctx->top.signatures[i], 0, &lines,
+                join_match);
+    }
+}
+
+/**
+ * Orders placements by signature.
+ */
+static
+int join_placement_compare(const void *p1, const void *p2) {
+    const struct join_placement *a = p1;
+    const struct join_placement *b = p2;
+
+    return (a->signature > b->signature) - (a->signature < b->signature);
+}
+
+/**
+ * Gathers the placements of the used signatures of a half, grouped by
+ * signature.
+ */
+static
+int join_gather(struct join_context *ctx, struct join_half *half) {
+    join_enumerate(ctx, half);
+    if (ctx->error) {
+        errno = ctx->error;
+        return -1;
+    }
+
+    half->first_placement = calloc(half->count + 1, sizeof(size_t));
+    half->num_placements = calloc(half->count + 1, sizeof(size_t));
+    if (half->first_placement == NULL || half->num_placements == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    qsort(half->placements, half->placements_count,
+            sizeof(struct join_placement), join_placement_compare);
+    for (size_t i = half->placements_count; i-- > 0;) {
+        half->first_placement[half->placements[i].signature] = i;
+        half->num_placements[half->placements[i].signature]++;
+    }
+
+    return 0;
+}
+
+/**
+ * Stores every board made of a pair of placements of the kept pairs of
+ * signatures.
+ */
+static
+int join_combine(struct join_context *ctx, struct aq_store *solutions) {
+    struct join_placement *top;
+    struct join_placement *bottom;
+    struct aq_board board;
+
+    for (size_t i = 0; i < ctx->pairs_count; ++i) {
+        top = ctx->top.placements +
+            ctx->top.first_placement[ctx->pairs[i].top];
+        bottom = ctx->bottom.placements +
+            ctx->bottom.first_placement[ctx->pairs[i].bottom];
+        for (size_t j = 0; j < ctx->top.num_placements[ctx->pairs[i].top];
+                ++j) {
+            for (size_t l = 0;
+                    l < ctx->bottom.num_placements[ctx->pairs[i].bottom];
+                    ++l) {
+                for (int s = 0; s < AQ_BOARD_SLICES; ++s) {
+                    board.slices[s] = top[j].board.slices[s] |
+                        bottom[l].board.slices[s];
+                }
+
+                if (store_insert(solutions, &board) == -1) {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Sets up the lines of every cell, on which side of every row each line
+ * has cells, and the two halves.
+ */
+static
+void join_context_init(struct join_context *ctx,
+        const struct aq_params *params, int k) {
+    int N = params->N;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->size = N;
+    ctx->k = k;
+    ctx->rank = params->rank;
+    ctx->nprocs = params->nprocs > 0 ? params->nprocs : 1;
+    ctx->max_queens = -1;
+    board_geometry_init(&ctx->geometry, N);
+    ctx->board = board_new();
+    lines_init(&ctx->lines, N);
+
+    ctx->top.rows = N / 2;
+    ctx->bottom.rows = N - N / 2;
+    ctx->bottom.flip = 1;
+}
+
+/**
+ * Releases the tables of a half.
+ */
+static
+void join_half_free(struct join_half *half) {
+    free(half->signatures);
+    free(half->best);
+    free(half->used);
+    free(half->index);
+    free(half->placements);
+    free(half->first_placement);
+    free(half->num_placements);
+}
+
+/**
+ * Releases the tables of a context.
+ */
+static
+void join_context_free(struct join_context *ctx) {
+    join_half_free(&ctx->top);
+    join_half_free(&ctx->bottom);
+    free(ctx->entries);
+    free(ctx->buckets);
+    free(ctx->occupied);
+    free(ctx->pairs);
+}
+
+/**
+ * Runs the join for a single k, over this instance's share of the top half.
+ * Returns the most queens found, or -1 with errno set.
+ */
+static
+int join_run(struct join_context *ctx, struct aq_store *solutions) {
+    join_enumerate(ctx, &ctx->top);
+    join_enumerate(ctx, &ctx->bottom);
+    if (ctx->error) {
+        errno = ctx->error;
+        return -1;
+    }
+
+    if (join_build(ctx) == -1) {
+        return -1;
+    }
+
+    // Find the largest solution, then the pairs of signatures making it.
+    join_probe(ctx);
+    ctx->top.used = calloc(ctx->top.count + 1, 1);
+    ctx->bottom.used = calloc(ctx->bottom.count + 1, 1);
+    if (ctx->top.used == NULL || ctx->bottom.used == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ctx->collect = 1;
+    if (ctx->max_queens > 0) {
+        join_probe(ctx);
+    }
+
+    TRACE_INFO(JOIN_K, ctx->k, ctx->max_queens, ctx->top.count,
+            ctx->bottom.count, ctx->pairs_count);
+    if (ctx->error) {
+        errno = ctx->error;
+        return -1;
+    }
+
+    if (!ctx->pairs_count) {
+        return ctx->max_queens > 0 ? ctx->max_queens : 0;
+    }
+
+    if (join_gather(ctx, &ctx->top) == -1 ||
+        join_gather(ctx, &ctx->bottom) == -1 ||
+        join_combine(ctx, solutions) == -1) {
+        return -1;
+    }
+
+    return ctx->max_queens;
+}
+
+/**
+ * Solves a single k. Returns the most queens found, or -1 with errno set.
+ */
+static
+int join_solve_k(const struct aq_params *params, int k,
+        struct aq_store *solutions) {
+    struct join_context *ctx = malloc(sizeof(struct join_context));
+    int max_queens;
+
+    if (ctx == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    join_context_init(ctx, params, k);
+    max_queens = join_run(ctx, solutions);
+    join_context_free(ctx);
+    free(ctx);
+    return max_queens;
+}
+
+/**
+ * Runs a complete search like aq_solve_multi, with the same meaning of the
+ * arguments, except that max_queens only goes out. Returns 0, or -1 with
+ * errno set.
+ */
+int join_solve_multi(const struct aq_params *params,
+        struct aq_store *solutions, int *max_queens) {
+    int num_k = aq_num_k(params);
+
+    if (params->w || params->N > AQ_JOIN_MAX_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (int i = 0; i < num_k; ++i) {
+        store_clear(&solutions[i]);
+        max_queens[i] = join_solve_k(params, params->multi ? i : params->k,
+                &solutions[i]);
+        if (max_queens[i] == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
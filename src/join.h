@@ -0,0 +1,59 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A meet-in-the-middle engine for normal boards.
+ *
+ * The board is cut between two rows, and every placement of the top half and
+ * of the bottom half is enumerated on its own, the bottom half from the last
+ * row up. A half only matters to the other through its signature: for every
+ * column, diagonal and anti-diagonal crossing the midline, the queen nearest
+ * to the midline on it, if any, together with how many more attacks each
+ * such queen still needs. No row crosses the midline, and two queens facing
+ * each other across it on a line attack each other, so two halves make a
+ * solution exactly when every queen of either signature is on as many lines
+ * occupied by the other half as it needs attacks.
+ *
+ * Placements of a half with the same signature are interchangeable, so only
+ * the most queens of each signature counts. The signatures of the two halves
+ * are joined through a hash table keyed on the lines both halves occupy,
+ * which each signature constrains on its own side. Boards are only built for
+ * the pairs of signatures that make a largest solution, by enumerating the
+ * halves once more.
+ *
+ * This trades memory for time: every signature of both halves is held at
+ * once, but neither half is enumerated again for each placement of the
+ * other, as the search of aq.h does. Like the profile engine, it finds every
+ * board that passes board_all_has_same_attacks, and wrap-around boards are
+ * not supported.
+ */
+
+#ifndef AQ_JOIN_H_
+#define AQ_JOIN_H_
+
+#include "aq.h"
+#include "lines.h"
+#include "store.h"
+
+/**
+ * Largest board the engine handles, and the number of lines of such a
+ * board: its columns, diagonals and anti-diagonals.
+ */
+#define AQ_JOIN_MAX_SIZE AQ_LINES_MAX_SIZE
+#define AQ_JOIN_MAX_LINES AQ_LINES_MAX
+
+/**
+ * Number of signatures, placements and join entries the tables first make
+ * room for.
+ */
+#define AQ_JOIN_INITIAL_CAPACITY 4096
+
+/**
+ * Function prototypes.
+ */
+int join_solve_multi(const struct aq_params *params,
+        struct aq_store *solutions, int *max_queens);
+
+#endif /* AQ_JOIN_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -2,13 +2,12 @@
  * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
  * National University of Singapore.
  *
- * A simple logger.
+ * The lines of a normal board.
  */
 
-#include "log.h"
+#include "lines.h"
 
-#ifndef NDEBUG
-extern void LOG(const char*, const char*, ...);
-#endif
+extern void lines_init(struct aq_lines*, int);
+extern uint64_t lines_hash(const void*, size_t);
 
 /* vim: set ts=4 sw=4 et: */
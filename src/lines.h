@@ -0,0 +1,99 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * The lines of a normal board, shared by the engines that sweep it row by
+ * row (profile.h and join.h).
+ *
+ * A board of size N has N columns, then 2N - 1 diagonals and 2N - 1
+ * anti-diagonals, numbered in that order. Rows are left out, since the
+ * engines place a whole row at once.
+ */
+
+#ifndef AQ_LINES_H_
+#define AQ_LINES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Largest board the lines are kept for, and the number of lines of such a
+ * board.
+ */
+#define AQ_LINES_MAX_SIZE 16
+#define AQ_LINES_MAX (5 * AQ_LINES_MAX_SIZE - 2)
+
+/**
+ * The lines of a board.
+ *
+ * cells gives the column, diagonal and anti-diagonal of every cell. below
+ * tells whether a line has any cell in a row after a row, and above whether
+ * it has any in a row before it.
+ */
+struct aq_lines {
+    int size;
+    int num_lines;
+    uint8_t cells[AQ_LINES_MAX_SIZE][AQ_LINES_MAX_SIZE][3];
+    uint8_t below[AQ_LINES_MAX_SIZE][AQ_LINES_MAX];
+    uint8_t above[AQ_LINES_MAX_SIZE][AQ_LINES_MAX];
+};
+
+/**
+ * Sets up the lines of a board of a size.
+ */
+inline
+void lines_init(struct aq_lines *lines, int size) {
+    int N = size;
+
+    memset(lines, 0, sizeof(*lines));
+    lines->size = N;
+    lines->num_lines = 5 * N - 2;
+
+    for (int r = 0; r < N; ++r) {
+        for (int c = 0; c < N; ++c) {
+            lines->cells[r][c][0] = c;
+            lines->cells[r][c][1] = N + c - r + N - 1;
+            lines->cells[r][c][2] = 3 * N - 1 + c + r;
+        }
+    }
+
+    for (int r = N - 2; r >= 0; --r) {
+        memcpy(lines->below[r], lines->below[r + 1], lines->num_lines);
+        for (int c = 0; c < N; ++c) {
+            for (int i = 0; i < 3; ++i) {
+                lines->below[r][lines->cells[r + 1][c][i]] = 1;
+            }
+        }
+    }
+
+    for (int r = 1; r < N; ++r) {
+        memcpy(lines->above[r], lines->above[r - 1], lines->num_lines);
+        for (int c = 0; c < N; ++c) {
+            for (int i = 0; i < 3; ++i) {
+                lines->above[r][lines->cells[r - 1][c][i]] = 1;
+            }
+        }
+    }
+}
+
+/**
+ * Hashes bytes, such as the key of a frontier or a signature, with FNV-1a,
+ * folding the high bits into the low ones that pick a slot.
+ */
+inline
+uint64_t lines_hash(const void *bytes, size_t length) {
+    const uint8_t *key = bytes;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= key[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash ^ (hash >> 29);
+}
+
+#endif /* AQ_LINES_H_ */
+
+/* vim: set ts=4 sw=4 et: */
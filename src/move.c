@@ -7,7 +7,9 @@
 
 #include "move.h"
 
-extern void move_apply(struct aq_board*, struct aq_move*, int depth);
-extern void move_undo(struct aq_board*, struct aq_move*);
+extern void move_apply(struct aq_board*, const struct aq_geometry*,
+        struct aq_move*, int depth);
+extern void move_undo(struct aq_board*, const struct aq_geometry*,
+        struct aq_move*);
 
 /* vim: set ts=4 sw=4 et: */
@@ -24,8 +24,9 @@ struct aq_move {
  * Applies a move to a specific board.
  */
 inline
-void move_apply(struct aq_board *board, struct aq_move *move, int depth) {
-    board_set_occupied(board, move->row, move->col);
+void move_apply(struct aq_board *board, const struct aq_geometry *geometry,
+        struct aq_move *move, int depth) {
+    board_set_occupied(board, geometry, move->row, move->col);
     move->applied = 1;
     move->depth = depth;
 }
@@ -34,8 +35,9 @@ void move_apply(struct aq_board *board, struct aq_move *move, int depth) {
  * Undo a move to a specific board.
  */
 inline
-void move_undo(struct aq_board *board, struct aq_move *move) {
-    board_set_unoccupied(board, move->row, move->col);
+void move_undo(struct aq_board *board, const struct aq_geometry *geometry,
+        struct aq_move *move) {
+    board_set_unoccupied(board, geometry, move->row, move->col);
     move->applied = 0;
 }
 
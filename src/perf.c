@@ -0,0 +1,307 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Hardware performance counters around the phases of a search.
+ */
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <unistd.h>
+
+#ifdef AQ_PERF
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "perf.h"
+#include "trace.h"
+
+#define AQ_PERF_NAME(name, label) label,
+
+__thread struct perf_thread perf_thread = { .leader = -1 };
+
+const char *const PERF_PHASE_NAMES[] = { AQ_PERF_PHASES(AQ_PERF_NAME) };
+const char *const PERF_COUNTER_NAMES[] = { AQ_PERF_COUNTERS(AQ_PERF_NAME) };
+
+extern void perf_enter(int);
+
+#ifdef AQ_PERF
+
+/**
+ * The type and configuration of the event of every counter but PERF_TIME,
+ * which is kept last.
+ */
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} PERF_EVENTS[PERF_TIME] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+        PERF_COUNT_HW_CACHE_OP_READ << 8 |
+        PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+/**
+ * Reads a counter from its mapped page with rdpmc into value. Returns 0, or
+ * -1 if the kernel does not let user space read it right now.
+ *
+ * The kernel bumps lock around every update of the page, so the read is
+ * retried until it saw none.
+ */
+static inline
+int perf_read_page(void *mapped, uint64_t *value) {
+#if defined(__x86_64__) || defined(__i386__)
+    volatile struct perf_event_mmap_page *page = mapped;
+    uint32_t sequence;
+    uint32_t index;
+    uint32_t low, high;
+    uint64_t count;
+    int64_t pmc;
+    int width;
+
+    do {
+        sequence = page->lock;
+        __asm__ volatile ("" ::: "memory");
+        index = page->index;
+        if (!page->cap_user_rdpmc || !index) {
+            return -1;
+        }
+
+        count = page->offset;
+        width = page->pmc_width;
+        __asm__ volatile ("rdpmc" : "=a" (low), "=d" (high) :
+                "c" (index - 1));
+        __asm__ volatile ("" ::: "memory");
+    } while (page->lock != sequence);
+
+    // The hardware counter is only width bits wide, and signed.
+    if (width < 1 || width > 64) {
+        return -1;
+    }
+
+    pmc = (int64_t) (((uint64_t) high << 32 | low) << (64 - width)) >>
+        (64 - width);
+    *value = count + pmc;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Reads the whole group of the thread with a system call, into values if
+ * not NULL, and its enabled and running times into times if not NULL.
+ * Returns 0, or -1 on failure.
+ */
+static
+int perf_read_group(uint64_t *values, uint64_t *times) {
+    uint64_t buffer[3 + PERF_NUM_COUNTERS];
+    ssize_t expected = (3 + perf_thread.num_open) * sizeof(uint64_t);
+
+    if (read(perf_thread.leader, buffer, sizeof(buffer)) != expected) {
+        return -1;
+    }
+
+    if (values != NULL) {
+        memcpy(values, buffer + 3, perf_thread.num_open * sizeof(uint64_t));
+    }
+
+    if (times != NULL) {
+        times[0] = buffer[1];
+        times[1] = buffer[2];
+    }
+
+    return 0;
+}
+
+/**
+ * Reads every counter of the thread into values, from user space where the
+ * kernel allows it. Returns 0, or -1 on failure.
+ */
+static inline
+int perf_read(uint64_t *values) {
+    for (int i = 0; i < perf_thread.num_open; ++i) {
+        if (perf_read_page(perf_thread.pages[i], &values[i]) == -1) {
+            return perf_read_group(values, NULL);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Closes the counters of the thread, keeping what they counted.
+ */
+static
+void perf_stop(void) {
+    for (int i = 0; i < perf_thread.num_open; ++i) {
+        munmap(perf_thread.pages[i], sysconf(_SC_PAGESIZE));
+        close(perf_thread.fds[i]);
+    }
+
+    perf_thread.num_open = 0;
+    perf_thread.leader = -1;
+}
+
+/**
+ * Starts counting in the calling thread from zero, with every counter that
+ * can be opened. Returns 0, or -1 with errno set if none of the kernel can
+ * be, in which case only time is counted.
+ */
+int perf_open(void) {
+    struct perf_event_attr attr;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    int first_errno = 0;
+    void *page;
+    int fd;
+
+    perf_stop();
+    memset(&perf_thread, 0, sizeof(perf_thread));
+    perf_thread.leader = -1;
+    for (int i = 0; i < PERF_TIME; ++i) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_EVENTS[i].type;
+        attr.config = PERF_EVENTS[i].config;
+        attr.read_format = PERF_FORMAT_GROUP |
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, perf_thread.leader,
+                0);
+        if (fd == -1) {
+            first_errno = first_errno ? first_errno : errno;
+            continue;
+        }
+
+        page = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (page == MAP_FAILED) {
+            first_errno = first_errno ? first_errno : errno;
+            close(fd);
+            continue;
+        }
+
+        if (perf_thread.leader == -1) {
+            perf_thread.leader = fd;
+        }
+
+        perf_thread.fds[perf_thread.num_open] = fd;
+        perf_thread.pages[perf_thread.num_open] = page;
+        perf_thread.counters[perf_thread.num_open++] = i;
+        perf_thread.counts.available |= 1ULL << i;
+    }
+
+    if (perf_thread.leader != -1 && perf_read(perf_thread.last) == -1) {
+        first_errno = EIO;
+        perf_stop();
+        perf_thread.counts.available = 0;
+    }
+
+    perf_thread.counts.available |= 1ULL << PERF_TIME;
+    perf_thread.last[PERF_TIME] = trace_clock(CLOCK_MONOTONIC);
+    perf_thread.phase = PERF_OTHER;
+    perf_thread.on = 1;
+    if (perf_thread.leader == -1) {
+        errno = first_errno;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Charges the counts since the previous phase point to the phase of the
+ * thread, and moves it into another. The counters stop for good if they
+ * cannot be read, leaving only time.
+ */
+void perf_switch(int phase) {
+    uint64_t values[PERF_NUM_COUNTERS];
+    uint64_t *counts = perf_thread.counts.values[perf_thread.phase];
+    uint64_t now = trace_clock(CLOCK_MONOTONIC);
+
+    if (perf_thread.num_open && perf_read(values) == -1) {
+        perf_stop();
+    }
+
+    for (int i = 0; i < perf_thread.num_open; ++i) {
+        counts[perf_thread.counters[i]] += values[i] - perf_thread.last[i];
+        perf_thread.last[i] = values[i];
+    }
+
+    counts[PERF_TIME] += now - perf_thread.last[PERF_TIME];
+    perf_thread.last[PERF_TIME] = now;
+    perf_thread.phase = phase;
+}
+
+/**
+ * Stops counting in the calling thread, and stores what it counted in
+ * counts, unless that is NULL. Counts are zero if it never counted.
+ */
+void perf_close(struct perf_counts *counts) {
+    uint64_t times[2];
+
+    if (perf_thread.on) {
+        perf_switch(PERF_OTHER);
+    }
+
+    if (perf_thread.num_open && perf_read_group(NULL, times) == 0) {
+        perf_thread.counts.time_enabled = times[0];
+        perf_thread.counts.time_running = times[1];
+    }
+
+    if (counts != NULL) {
+        *counts = perf_thread.counts;
+    }
+
+    perf_stop();
+    perf_thread.on = 0;
+    memset(&perf_thread.counts, 0, sizeof(perf_thread.counts));
+}
+
+#else
+
+/**
+ * Counting is not built in, so it never starts.
+ */
+int perf_open(void) {
+    errno = ENOSYS;
+    return -1;
+}
+
+void perf_switch(int phase) {
+}
+
+void perf_close(struct perf_counts *counts) {
+    if (counts != NULL) {
+        memset(counts, 0, sizeof(*counts));
+    }
+}
+
+#endif
+
+/**
+ * Adds counts to a total.
+ */
+void perf_add(struct perf_counts *total, const struct perf_counts *counts) {
+    for (int i = 0; i < PERF_NUM_PHASES; ++i) {
+        for (int j = 0; j < PERF_NUM_COUNTERS; ++j) {
+            total->values[i][j] += counts->values[i][j];
+        }
+    }
+
+    total->available |= counts->available;
+    total->time_enabled += counts->time_enabled;
+    total->time_running += counts->time_running;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,137 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Hardware performance counters around the phases of a search.
+ *
+ * Every thread that calls perf_open counts the events of AQ_PERF_COUNTERS
+ * in itself through Linux perf_event_open, as a single group so that the
+ * counters always run together. A phase point, PERF_PHASE, reads every
+ * counter and charges what was counted since the previous phase point to
+ * the phase the thread was in, then moves it into the new phase. Every count
+ * thus lands in exactly one phase, and the phases add up to the whole run.
+ *
+ * Each counter is mapped into the thread, and read with rdpmc from user
+ * space whenever the kernel allows it, so a phase point makes no system
+ * call. Where it does not (off x86, or while a counter is not on the
+ * hardware), the group is read with a single read instead. The time spent in
+ * a phase is taken from CLOCK_MONOTONIC, which needs no system call either.
+ * Only user space is counted, and nothing else changes about the code, so
+ * unlike a gprof build the inlined hot paths stay inlined.
+ *
+ * With more counters than the hardware has, the kernel multiplexes them, and
+ * each only counts part of the time. perf_close reads how long the group was
+ * enabled and how long it actually ran, so that the report can flag counts
+ * that only cover part of the run. They are not scaled.
+ *
+ * The phase points compile to nothing unless configure --enable-perf
+ * defines AQ_PERF. Until perf_open, those that remain only cost a branch.
+ */
+
+#ifndef AQ_PERF_H_
+#define AQ_PERF_H_
+
+#include <stdint.h>
+
+/**
+ * Every phase, along with its name in reports. A thread starts out in
+ * OTHER.
+ */
+#define AQ_PERF_PHASES(X) \
+    X(OTHER, "other") \
+    X(MOVES, "moves") \
+    X(SIMULATE, "simulate") \
+    X(SOLUTIONS, "solutions") \
+    X(GATHER, "gather")
+
+/**
+ * Every counter, along with its name in reports. Counters the hardware or
+ * the kernel does not offer are left out.
+ */
+#define AQ_PERF_COUNTERS(X) \
+    X(CYCLES, "cycles") \
+    X(INSTRUCTIONS, "instructions") \
+    X(BRANCH_MISSES, "branch-misses") \
+    X(L1D_MISSES, "l1d-misses") \
+    X(LLC_MISSES, "llc-misses") \
+    X(TIME, "time-ns")
+
+#define AQ_PERF_ENUM(name, label) PERF_##name,
+
+enum perf_phase {
+    AQ_PERF_PHASES(AQ_PERF_ENUM)
+    PERF_NUM_PHASES
+};
+
+enum perf_counter {
+    AQ_PERF_COUNTERS(AQ_PERF_ENUM)
+    PERF_NUM_COUNTERS
+};
+
+/**
+ * The counts of a thread, or of many added up, for every phase. Bit i of
+ * available is set if the i-th counter was counted at all. time_enabled and
+ * time_running are the nanoseconds the group was enabled and actually ran
+ * on the hardware, which differ once the kernel multiplexes it.
+ */
+struct perf_counts {
+    uint64_t values[PERF_NUM_PHASES][PERF_NUM_COUNTERS];
+    uint64_t available;
+    uint64_t time_enabled;
+    uint64_t time_running;
+};
+
+/**
+ * The counters of a thread, which count while on is set. leader is the file
+ * descriptor of the group, or -1 if no counter could be opened, in which
+ * case only time is counted. The i-th counter of the group is counter
+ * counters[i], mapped at pages[i], and last[i] holds its value at the
+ * previous phase point. The time of that point is last[PERF_TIME], which
+ * no counter of the group uses.
+ */
+struct perf_thread {
+    int on;
+    int leader;
+    int phase;
+    int num_open;
+    int fds[PERF_NUM_COUNTERS];
+    int counters[PERF_NUM_COUNTERS];
+    void *pages[PERF_NUM_COUNTERS];
+    uint64_t last[PERF_NUM_COUNTERS];
+    struct perf_counts counts;
+};
+
+extern __thread struct perf_thread perf_thread;
+extern const char *const PERF_PHASE_NAMES[];
+extern const char *const PERF_COUNTER_NAMES[];
+
+/**
+ * Phase points.
+ */
+#ifdef AQ_PERF
+#define PERF_PHASE(phase) perf_enter(PERF_##phase)
+#else
+#define PERF_PHASE(phase) ((void) 0)
+#endif
+
+/**
+ * Function prototypes.
+ */
+int perf_open(void);
+void perf_switch(int phase);
+void perf_close(struct perf_counts *counts);
+void perf_add(struct perf_counts *total, const struct perf_counts *counts);
+
+/**
+ * Moves the thread into a phase, if counting is on.
+ */
+inline
+void perf_enter(int phase) {
+    if (perf_thread.on) {
+        perf_switch(phase);
+    }
+}
+
+#endif /* AQ_PERF_H_ */
+
+/* vim: set ts=4 sw=4 et: */
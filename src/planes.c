@@ -0,0 +1,35 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Whole-board attack planes.
+ */
+
+#include "planes.h"
+
+extern struct aq_board planes_shift(struct aq_board*, int,
+        const struct aq_geometry*);
+extern struct aq_board planes_step(struct aq_board*, int,
+        struct aq_planes_geometry*);
+extern void planes_geometry_init(struct aq_planes_geometry*, int);
+extern struct aq_board planes_ray_fill(struct aq_board*, int,
+        struct aq_planes_geometry*);
+extern void planes_seen(struct aq_board*, struct aq_planes_geometry*,
+        struct aq_board[8]);
+extern struct aq_planes planes_count(struct aq_board[8],
+        struct aq_planes_geometry*);
+extern int planes_get(struct aq_planes*, int, int, struct aq_planes_geometry*);
+extern void planes_compare(struct aq_planes*, int, struct aq_board*,
+        struct aq_board*, struct aq_planes_geometry*);
+extern void planes_attacks(struct aq_board*, struct aq_planes_geometry*,
+        struct aq_planes_attacks*);
+extern int planes_uniform_attacks(struct aq_board*, struct aq_planes_geometry*,
+        struct aq_planes_attacks*);
+extern struct aq_board planes_cells_with_max_attacks(struct aq_board*, int,
+        struct aq_planes_geometry*);
+extern struct aq_board planes_candidates(struct aq_board*, int,
+        struct aq_planes_geometry*, struct aq_planes_attacks*);
+extern int planes_can_reach(struct aq_board*, int, struct aq_planes_geometry*,
+        struct aq_planes_attacks*, struct aq_board*);
+
+/* vim: set ts=4 sw=4 et: */
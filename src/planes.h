@@ -0,0 +1,474 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Whole-board attack planes.
+ *
+ * Instead of walking the rays of one cell at a time, these functions work on
+ * every cell of the board at once. For each of the eight directions, a
+ * Kogge-Stone fill over the slices finds the cells that have a queen
+ * somewhere in that direction. Summing these eight planes into bit-sliced
+ * counters gives, for every cell, the number of queens it sees: for an
+ * empty cell, the number of attacks a queen placed there would receive; for
+ * an occupied cell, the number of attacks on its queen.
+ *
+ * Boards are used as plain bit masks here. Only normal boards are handled,
+ * since rays on a wrap-around board do not end at the edges.
+ */
+
+#ifndef AQ_PLANES_H_
+#define AQ_PLANES_H_
+
+#include "board.h"
+
+/**
+ * Number of bits needed to count up to eight attacks.
+ */
+#define AQ_PLANES_COUNTER_BITS 4
+
+/**
+ * Number of doubling rounds of a fill, enough for rays across a board up to
+ * 16 wide.
+ */
+#define AQ_PLANES_ROUNDS 4
+
+/**
+ * Bit-sliced per-cell counters: bit b of the count of a cell is stored in
+ * bits[b] at the position of the cell.
+ */
+struct aq_planes {
+    struct aq_board bits[AQ_PLANES_COUNTER_BITS];
+};
+
+/**
+ * The attacks on every cell of a board: seen[d] holds the cells that see a
+ * queen in direction d, and counters the number of such directions.
+ */
+struct aq_planes_attacks {
+    struct aq_board seen[8];
+    struct aq_planes counters;
+};
+
+/**
+ * The masks that only depend on the size of the board, computed once per
+ * search by planes_geometry_init, on top of the layout of the board itself.
+ *
+ * The eight directions go around the 3x3 neighbourhood of a cell in
+ * row-major order, so that direction 7 - d is the opposite of direction d.
+ * steps[d] is the number of positions a cell moves by for one step in
+ * direction d, and propagators[d][r] holds the cells that can be entered by
+ * 2^r such steps without crossing an edge.
+ */
+struct aq_planes_geometry {
+    struct aq_geometry board;
+    struct aq_board first_col;
+    struct aq_board last_col;
+    int steps[8];
+    int num_rounds;
+    struct aq_board propagators[8][AQ_PLANES_ROUNDS];
+};
+
+/**
+ * Moves every cell of a mask by s positions, towards higher positions if s is
+ * positive and towards lower ones otherwise. Cells moved off the board are
+ * dropped.
+ */
+inline
+struct aq_board planes_shift(struct aq_board *mask, int s,
+        const struct aq_geometry *geometry) {
+    struct aq_board result = board_new();
+    int words = (s < 0 ? -s : s) >> 6;
+    int bits = (s < 0 ? -s : s) & 63;
+
+    // Position 0 is the top bit of slice 0, so moving towards higher
+    // positions is a right shift of the slices taken as one big number.
+    for (int i = 0; i < geometry->slices_occupied; ++i) {
+        uint64_t value = 0;
+        int from = s >= 0 ? i - words : i + words;
+        int next = s >= 0 ? from - 1 : from + 1;
+
+        if (from >= 0 && from < geometry->slices_occupied) {
+            value = s >= 0 ? mask->slices[from] >> bits :
+                             mask->slices[from] << bits;
+        }
+
+        if (bits && next >= 0 && next < geometry->slices_occupied) {
+            value |= s >= 0 ? mask->slices[next] << (64 - bits) :
+                              mask->slices[next] >> (64 - bits);
+        }
+
+        result.slices[i] = value & geometry->all.slices[i];
+    }
+
+    return result;
+}
+
+/**
+ * Moves every cell of a mask by one step in direction d, dropping cells that
+ * would leave the board.
+ */
+inline
+struct aq_board planes_step(struct aq_board *mask, int d,
+        struct aq_planes_geometry *geometry) {
+    struct aq_board result = planes_shift(mask, geometry->steps[d],
+            &geometry->board);
+    int dc = (d < 4 ? d : d + 1) % 3 - 1;
+
+    // Cells that crossed the left or right edge ended up on the other side.
+    for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+        if (dc > 0) {
+            result.slices[i] &= ~geometry->first_col.slices[i];
+        } else if (dc < 0) {
+            result.slices[i] &= ~geometry->last_col.slices[i];
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Computes the masks of a board size.
+ */
+inline
+void planes_geometry_init(struct aq_planes_geometry *geometry, int size) {
+    struct aq_board shifted;
+    int neighbour;
+
+    board_geometry_init(&geometry->board, size);
+    geometry->first_col = board_new();
+    geometry->last_col = board_new();
+
+    for (int i = 0; i < size; ++i) {
+        board_set_occupied(&geometry->first_col, &geometry->board, i, 0);
+        board_set_occupied(&geometry->last_col, &geometry->board, i,
+                size - 1);
+    }
+
+    geometry->num_rounds = 0;
+    while ((1 << geometry->num_rounds) < size) {
+        geometry->num_rounds++;
+    }
+
+    for (int d = 0; d < 8; ++d) {
+        neighbour = d < 4 ? d : d + 1;
+        geometry->steps[d] = (neighbour / 3 - 1) * size + neighbour % 3 - 1;
+    }
+
+    // The propagator of a fill only depends on the board, so its rounds are
+    // done here once instead of at every fill.
+    for (int d = 0; d < 8; ++d) {
+        geometry->propagators[d][0] = planes_step(&geometry->board.all, d,
+                geometry);
+        for (int r = 1; r < geometry->num_rounds; ++r) {
+            shifted = planes_shift(&geometry->propagators[d][r - 1],
+                    geometry->steps[d] << (r - 1), &geometry->board);
+            geometry->propagators[d][r] = geometry->propagators[d][r - 1];
+            for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+                geometry->propagators[d][r].slices[i] &= shifted.slices[i];
+            }
+        }
+    }
+}
+
+/**
+ * Returns every cell that is reached from a cell of the mask by one or more
+ * steps in direction d. Uses a Kogge-Stone fill, so that boards up to 16
+ * wide need four rounds of shifts instead of fifteen.
+ */
+inline
+struct aq_board planes_ray_fill(struct aq_board *mask, int d,
+        struct aq_planes_geometry *geometry) {
+    struct aq_board gen = planes_step(mask, d, geometry);
+    struct aq_board shifted;
+
+    for (int r = 0; r < geometry->num_rounds; ++r) {
+        shifted = planes_shift(&gen, geometry->steps[d] << r,
+                &geometry->board);
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            gen.slices[i] |= geometry->propagators[d][r].slices[i] &
+                             shifted.slices[i];
+        }
+    }
+
+    return gen;
+}
+
+/**
+ * Computes, for every cell, the cells that see a queen in each direction.
+ * seen[d] holds the cells with a queen somewhere in direction d.
+ */
+inline
+void planes_seen(struct aq_board *board, struct aq_planes_geometry *geometry,
+        struct aq_board seen[8]) {
+    // A cell sees a queen in a direction if it is reached from that queen by
+    // stepping the opposite way.
+    for (int d = 0; d < 8; ++d) {
+        seen[d] = planes_ray_fill(board, 7 - d, geometry);
+    }
+}
+
+/**
+ * Sums the eight direction planes into bit-sliced counters.
+ */
+inline
+struct aq_planes planes_count(struct aq_board seen[8],
+        struct aq_planes_geometry *geometry) {
+    struct aq_planes counters;
+    uint64_t carry;
+    uint64_t next;
+
+    for (int b = 0; b < AQ_PLANES_COUNTER_BITS; ++b) {
+        counters.bits[b] = board_new();
+    }
+
+    for (int d = 0; d < 8; ++d) {
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            carry = seen[d].slices[i];
+            for (int b = 0; b < AQ_PLANES_COUNTER_BITS && carry; ++b) {
+                next = counters.bits[b].slices[i] & carry;
+                counters.bits[b].slices[i] ^= carry;
+                carry = next;
+            }
+        }
+    }
+
+    return counters;
+}
+
+/**
+ * Returns the count of a cell in bit-sliced counters.
+ */
+inline
+int planes_get(struct aq_planes *counters, int row, int col,
+        struct aq_planes_geometry *geometry) {
+    int count = 0;
+
+    for (int b = 0; b < AQ_PLANES_COUNTER_BITS; ++b) {
+        if (board_is_occupied(&counters->bits[b], &geometry->board, row,
+                col)) {
+            count |= 1 << b;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Compares bit-sliced counters against a constant, setting the cells whose
+ * count is above k in above and those whose count is exactly k in equal.
+ */
+inline
+void planes_compare(struct aq_planes *counters, int k, struct aq_board *above,
+        struct aq_board *equal, struct aq_planes_geometry *geometry) {
+    *above = board_new();
+    *equal = geometry->board.all;
+
+    if (k >= 1 << AQ_PLANES_COUNTER_BITS) {
+        board_clear(equal, &geometry->board);
+        return;
+    }
+
+    // Walk from the most significant bit, as long as the count and k agree.
+    for (int b = AQ_PLANES_COUNTER_BITS - 1; b >= 0; --b) {
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            uint64_t bit = counters->bits[b].slices[i];
+            if ((k >> b) & 1) {
+                equal->slices[i] &= bit;
+            } else {
+                above->slices[i] |= equal->slices[i] & bit;
+                equal->slices[i] &= ~bit;
+            }
+        }
+    }
+}
+
+/**
+ * Computes the attacks on every cell of a board.
+ */
+inline
+void planes_attacks(struct aq_board *board,
+        struct aq_planes_geometry *geometry,
+        struct aq_planes_attacks *attacks) {
+    planes_seen(board, geometry, attacks->seen);
+    attacks->counters = planes_count(attacks->seen, geometry);
+}
+
+/**
+ * Returns the number of attacks every queen of a board receives, or -1 if
+ * they do not all receive the same number. This is the whole-board
+ * equivalent of board_max_attacks for boards on which
+ * board_all_has_same_attacks holds.
+ */
+inline
+int planes_uniform_attacks(struct aq_board *board,
+        struct aq_planes_geometry *geometry,
+        struct aq_planes_attacks *attacks) {
+    uint64_t set;
+    uint64_t any;
+    int count = 0;
+
+    // Every bit of the counters must be either set or clear on every queen.
+    for (int b = 0; b < AQ_PLANES_COUNTER_BITS; ++b) {
+        set = 0;
+        any = 0;
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            set |= ~attacks->counters.bits[b].slices[i] & board->slices[i];
+            any |= attacks->counters.bits[b].slices[i] & board->slices[i];
+        }
+
+        if (set && any) {
+            return -1;
+        }
+
+        count |= any ? 1 << b : 0;
+    }
+
+    return count;
+}
+
+/**
+ * Returns the empty cells on which a queen would receive at most k attacks.
+ */
+inline
+struct aq_board planes_cells_with_max_attacks(struct aq_board *board, int k,
+        struct aq_planes_geometry *geometry) {
+    struct aq_planes_attacks attacks;
+    struct aq_board above;
+    struct aq_board equal;
+    struct aq_board mask = geometry->board.all;
+
+    planes_attacks(board, geometry, &attacks);
+    planes_compare(&attacks.counters, k, &above, &equal, geometry);
+
+    for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+        mask.slices[i] &= ~above.slices[i] & ~board->slices[i];
+    }
+
+    return mask;
+}
+
+/**
+ * Returns the empty cells on which a queen can be placed without any queen
+ * being attacked more than k times, given the attacks on every cell. This is
+ * the whole-board equivalent of checking board_cell_count_attacks and
+ * board_simulate_max_attacks for every cell.
+ *
+ * A new queen only adds an attack to the queens that saw nothing in its
+ * direction, so it may not go on the open rays of queens already attacked
+ * k times.
+ */
+inline
+struct aq_board planes_candidates(struct aq_board *board, int k,
+        struct aq_planes_geometry *geometry,
+        struct aq_planes_attacks *attacks) {
+    struct aq_board above;
+    struct aq_board equal;
+    struct aq_board open;
+    struct aq_board ray;
+    struct aq_board mask = geometry->board.all;
+    uint64_t any_open;
+    uint64_t any_equal = 0;
+
+    planes_compare(&attacks->counters, k, &above, &equal, geometry);
+
+    for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+        // A queen already attacked more than k times cannot be fixed.
+        if (above.slices[i] & board->slices[i]) {
+            board_clear(&mask, &geometry->board);
+            return mask;
+        }
+
+        mask.slices[i] &= ~above.slices[i] & ~board->slices[i];
+        equal.slices[i] &= board->slices[i];
+        any_equal |= equal.slices[i];
+    }
+
+    for (int d = 0; d < 8 && any_equal; ++d) {
+        open = board_new();
+        any_open = 0;
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            open.slices[i] = equal.slices[i] & ~attacks->seen[d].slices[i];
+            any_open |= open.slices[i];
+        }
+
+        if (!any_open) {
+            continue;
+        }
+
+        ray = planes_ray_fill(&open, d, geometry);
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            mask.slices[i] &= ~ray.slices[i];
+        }
+    }
+
+    return mask;
+}
+
+/**
+ * Returns non-zero if every queen of a board could still end up attacked
+ * exactly k times, given the attacks on every cell and the cells that may
+ * still receive a queen.
+ *
+ * Queens are never removed, and a queen only gains an attack from a direction
+ * in which it sees nothing yet, once a queen is placed on its ray that way. A
+ * queen whose attacks plus such reachable directions fall short of k is
+ * therefore short of k on every board below this one.
+ */
+inline
+int planes_can_reach(struct aq_board *board, int k,
+        struct aq_planes_geometry *geometry,
+        struct aq_planes_attacks *attacks, struct aq_board *legal) {
+    struct aq_board reachable[8];
+    struct aq_board short_of = board_new();
+    struct aq_planes potential;
+    struct aq_board above;
+    struct aq_board equal;
+    uint64_t any_short = 0;
+    uint64_t any_open;
+
+    planes_compare(&attacks->counters, k, &above, &equal, geometry);
+    for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+        short_of.slices[i] = board->slices[i] & ~above.slices[i] &
+                             ~equal.slices[i];
+        any_short |= short_of.slices[i];
+    }
+
+    if (!any_short) {
+        return 1;
+    }
+
+    // A queen can still gain an attack from direction d if a legal cell lies
+    // that way, which is the same as being reached from a legal cell by
+    // stepping the opposite way. Only the queens short of k matter, so
+    // directions in which all of them already see a queen need no fill.
+    for (int d = 0; d < 8; ++d) {
+        reachable[d] = attacks->seen[d];
+        any_open = 0;
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            any_open |= short_of.slices[i] & ~attacks->seen[d].slices[i];
+        }
+
+        if (!any_open) {
+            continue;
+        }
+
+        reachable[d] = planes_ray_fill(legal, 7 - d, geometry);
+        for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+            reachable[d].slices[i] |= attacks->seen[d].slices[i];
+        }
+    }
+
+    potential = planes_count(reachable, geometry);
+    planes_compare(&potential, k, &above, &equal, geometry);
+    for (int i = 0; i < geometry->board.slices_occupied; ++i) {
+        if (short_of.slices[i] & ~above.slices[i] & ~equal.slices[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+#endif /* AQ_PLANES_H_ */
+
+/* vim: set ts=4 sw=4 et: */
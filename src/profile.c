@@ -0,0 +1,551 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A row-by-row dynamic programming engine for normal boards.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "profile.h"
+#include "trace.h"
+
+/**
+ * A frontier. slots holds, for every line, the queen that is lowest on it,
+ * or -1, and needed the number of attacks every such queen still needs.
+ * Queens are numbered in the order their first line comes up, so that equal
+ * frontiers are equal byte for byte.
+ */
+struct profile_state {
+    int num_queens;
+    int8_t slots[AQ_PROFILE_MAX_LINES];
+    int8_t needed[AQ_PROFILE_MAX_QUEENS];
+};
+
+/**
+ * An entry of the memo. The key, of length bytes, is kept in the arena at
+ * offset. value is the most queens the rows left can take, or -1 if no
+ * completion is a solution.
+ */
+struct profile_entry {
+    uint64_t hash;
+    size_t offset;
+    int length;
+    int value;
+};
+
+/**
+ * The state of one run of the engine, for a single k.
+ *
+ * lines gives the column, diagonal and anti-diagonal of every cell, and
+ * whether a line still has cells below a row (see lines.h). The first row is shared
+ * out between nprocs instances by pattern, of which this is the rank-th.
+ */
+struct profile_context {
+    int size;
+    int k;
+    int rank;
+    int nprocs;
+    int num_patterns;
+    struct aq_lines lines;
+
+    struct profile_entry *entries;
+    size_t capacity;
+    size_t count;
+    uint8_t *arena;
+    size_t arena_size;
+    size_t arena_capacity;
+
+    struct aq_geometry geometry;
+    struct aq_board board;
+    struct aq_store *solutions;
+    int error;
+};
+
+/**
+ * A row being placed, from left to right. pending is the frontier above
+ * with the attacks the new queens deal already taken off, and attacks the
+ * number of attacks on every new queen so far.
+ *
+ * To evaluate, best collects the most queens of any completion. To collect,
+ * every completion with exactly target queens is stored.
+ */
+struct profile_row {
+    int row;
+    const struct profile_state *state;
+    struct profile_state pending;
+    int num_queens;
+    int cols[AQ_PROFILE_MAX_SIZE];
+    int attacks[AQ_PROFILE_MAX_SIZE];
+
+    int collect;
+    int best;
+    int target;
+};
+
+static int profile_value(struct profile_context*, int,
+        const struct profile_state*);
+static void profile_collect(struct profile_context*, int,
+        const struct profile_state*, int);
+
+/**
+ * Sets up the lines of every cell and their liveness.
+ */
+static
+void profile_context_init(struct profile_context *ctx,
+        const struct aq_params *params, int k) {
+    int N = params->N;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->size = N;
+    ctx->k = k;
+    ctx->rank = params->rank;
+    ctx->nprocs = params->nprocs > 0 ? params->nprocs : 1;
+    board_geometry_init(&ctx->geometry, N);
+    ctx->board = board_new();
+    lines_init(&ctx->lines, N);
+}
+
+/**
+ * Releases the memo of a context.
+ */
+static
+void profile_context_free(struct profile_context *ctx) {
+    free(ctx->entries);
+    free(ctx->arena);
+}
+
+/**
+ * Encodes the frontier below a row as a key, returning its length.
+ */
+static inline
+int profile_key(struct profile_context *ctx, int row,
+        const struct profile_state *state, uint8_t *key) {
+    int length = 0;
+
+    key[length++] = row;
+    for (int i = 0; i < ctx->lines.num_lines; ++i) {
+        key[length++] = state->slots[i] + 1;
+    }
+
+    for (int i = 0; i < state->num_queens; ++i) {
+        key[length++] = state->needed[i];
+    }
+
+    return length;
+}
+
+/**
+ * Returns the slot of the memo holding a key, or the empty slot where it
+ * would go.
+ */
+static inline
+size_t profile_find(struct profile_context *ctx, const uint8_t *key,
+        int length, uint64_t hash) {
+    size_t mask = ctx->capacity - 1;
+    size_t slot = hash & mask;
+    struct profile_entry *entry;
+
+    for (;; slot = (slot + 1) & mask) {
+        entry = &ctx->entries[slot];
+        if (!entry->length ||
+            (entry->hash == hash && entry->length == length &&
+             !memcmp(ctx->arena + entry->offset, key, length))) {
+            return slot;
+        }
+    }
+}
+
+/**
+ * Doubles the memo and re-inserts every entry.
+ */
+static
+int profile_grow(struct profile_context *ctx) {
+    size_t capacity = ctx->capacity ?
+        ctx->capacity * 2 : AQ_PROFILE_INITIAL_CAPACITY;
+    struct profile_entry *old = ctx->entries;
+    size_t old_capacity = ctx->capacity;
+    size_t slot;
+
+    ctx->entries = calloc(capacity, sizeof(struct profile_entry));
+    if (ctx->entries == NULL) {
+        ctx->entries = old;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ctx->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old[i].length) {
+            slot = old[i].hash & (capacity - 1);
+            while (ctx->entries[slot].length) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            ctx->entries[slot] = old[i];
+        }
+    }
+
+    free(old);
+    return 0;
+}
+
+/**
+ * Remembers the value of a key.
+ */
+static
+int profile_remember(struct profile_context *ctx, const uint8_t *key,
+        int length, uint64_t hash, int value) {
+    struct profile_entry *entry;
+    uint8_t *arena;
+    size_t capacity;
+
+    // Keep the memo at most half full.
+    if (2 * (ctx->count + 1) > ctx->capacity && profile_grow(ctx) == -1) {
+        return -1;
+    }
+
+    if (ctx->arena_size + length > ctx->arena_capacity) {
+        capacity = ctx->arena_capacity ? ctx->arena_capacity * 2 :
+            AQ_PROFILE_INITIAL_CAPACITY * 64;
+        arena = realloc(ctx->arena, capacity);
+        if (arena == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        ctx->arena = arena;
+        ctx->arena_capacity = capacity;
+    }
+
+    entry = &ctx->entries[profile_find(ctx, key, length, hash)];
+    entry->hash = hash;
+    entry->offset = ctx->arena_size;
+    entry->length = length;
+    entry->value = value;
+    memcpy(ctx->arena + ctx->arena_size, key, length);
+    ctx->arena_size += length;
+    ctx->count++;
+    return 0;
+}
+
+/**
+ * Builds the frontier below a fully placed row. Returns 0 if some queen can
+ * no longer be attacked exactly k times.
+ */
+static
+int profile_next(struct profile_context *ctx, struct profile_row *row,
+        struct profile_state *next) {
+    const struct profile_state *state = row->state;
+    int num_queens = state->num_queens + row->num_queens;
+    int8_t slots[AQ_PROFILE_MAX_LINES];
+    int8_t needed[AQ_PROFILE_MAX_QUEENS];
+    int8_t map[AQ_PROFILE_MAX_QUEENS];
+    int open[AQ_PROFILE_MAX_QUEENS];
+    int id;
+
+    memcpy(slots, state->slots, ctx->lines.num_lines);
+    memcpy(needed, row->pending.needed, state->num_queens);
+    for (int i = 0; i < row->num_queens; ++i) {
+        id = state->num_queens + i;
+        needed[id] = ctx->k - row->attacks[i];
+        for (int j = 0; j < 3; ++j) {
+            slots[ctx->lines.cells[row->row][row->cols[i]][j]] = id;
+        }
+    }
+
+    // Rays along lines with no cells left below can never be closed.
+    memset(open, 0, num_queens * sizeof(int));
+    for (int i = 0; i < ctx->lines.num_lines; ++i) {
+        if (!ctx->lines.below[row->row][i]) {
+            slots[i] = -1;
+        } else if (slots[i] != -1) {
+            open[(int) slots[i]]++;
+        }
+    }
+
+    // Every open ray adds at most one attack.
+    for (int i = 0; i < num_queens; ++i) {
+        if (needed[i] > open[i]) {
+            return 0;
+        }
+
+        map[i] = -1;
+    }
+
+    next->num_queens = 0;
+    for (int i = 0; i < ctx->lines.num_lines; ++i) {
+        next->slots[i] = -1;
+        if (slots[i] == -1) {
+            continue;
+        }
+
+        if (map[(int) slots[i]] == -1) {
+            map[(int) slots[i]] = next->num_queens;
+            next->needed[next->num_queens++] = needed[(int) slots[i]];
+        }
+
+        next->slots[i] = map[(int) slots[i]];
+    }
+
+    return 1;
+}
+
+/**
+ * Handles a fully placed row: evaluates or collects the rows below it.
+ */
+static
+void profile_finish(struct profile_context *ctx, struct profile_row *row) {
+    struct profile_state next;
+    int value;
+
+    if (!profile_next(ctx, row, &next)) {
+        return;
+    }
+
+    // The patterns of the first row are dealt out round-robin.
+    if (row->row == 0 && ctx->num_patterns++ % ctx->nprocs != ctx->rank) {
+        return;
+    }
+
+    value = profile_value(ctx, row->row + 1, &next);
+    if (value < 0) {
+        return;
+    }
+
+    if (!row->collect) {
+        if (row->num_queens + value > row->best) {
+            row->best = row->num_queens + value;
+        }
+
+        return;
+    }
+
+    if (row->num_queens + value != row->target) {
+        return;
+    }
+
+    for (int i = 0; i < row->num_queens; ++i) {
+        board_set_occupied(&ctx->board, &ctx->geometry, row->row,
+                row->cols[i]);
+    }
+
+    if (row->row + 1 == ctx->size) {
+        if (store_insert(ctx->solutions, &ctx->board) == -1) {
+            ctx->error = errno;
+        }
+    } else {
+        profile_collect(ctx, row->row + 1, &next, value);
+    }
+
+    for (int i = 0; i < row->num_queens; ++i) {
+        board_set_unoccupied(&ctx->board, &ctx->geometry, row->row,
+                row->cols[i]);
+    }
+}
+
+/**
+ * Places the rest of a row from a column on, trying every pattern.
+ *
+ * Attacks only grow as queens are added, so a new queen that already sees
+ * more than k queens, or a queen above that is attacked more than it still
+ * can be, ends the pattern.
+ */
+static
+void profile_place(struct profile_context *ctx, struct profile_row *row,
+        int col) {
+    const uint8_t *lines;
+    int attacks = 0;
+    int legal = 1;
+    int previous = row->num_queens - 1;
+    int queen;
+
+    if (col == ctx->size) {
+        profile_finish(ctx, row);
+        return;
+    }
+
+    profile_place(ctx, row, col + 1);
+    if (ctx->error) {
+        return;
+    }
+
+    // A queen on col sees the lowest queen on each of its lines above, and
+    // the previous queen of the row, which in turn sees it.
+    lines = ctx->lines.cells[row->row][col];
+    for (int i = 0; i < 3; ++i) {
+        queen = row->state->slots[lines[i]];
+        if (queen != -1) {
+            attacks++;
+            legal &= --row->pending.needed[queen] >= 0;
+        }
+    }
+
+    if (previous >= 0) {
+        attacks++;
+        legal &= ++row->attacks[previous] <= ctx->k;
+    }
+
+    if (legal && attacks <= ctx->k) {
+        row->cols[row->num_queens] = col;
+        row->attacks[row->num_queens] = attacks;
+        row->num_queens++;
+        profile_place(ctx, row, col + 1);
+        row->num_queens--;
+    }
+
+    if (previous >= 0) {
+        row->attacks[previous]--;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        queen = row->state->slots[lines[i]];
+        if (queen != -1) {
+            row->pending.needed[queen]++;
+        }
+    }
+}
+
+/**
+ * Starts placing a row below a frontier.
+ */
+static inline
+void profile_row_init(struct profile_row *row, int r,
+        const struct profile_state *state) {
+    row->row = r;
+    row->state = state;
+    row->pending.num_queens = state->num_queens;
+    memcpy(row->pending.needed, state->needed, state->num_queens);
+    row->num_queens = 0;
+    row->collect = 0;
+    row->best = -1;
+    row->target = 0;
+}
+
+/**
+ * Returns the most queens rows r on can take below a frontier, or -1 if no
+ * completion is a solution.
+ */
+static
+int profile_value(struct profile_context *ctx, int r,
+        const struct profile_state *state) {
+    uint8_t key[1 + AQ_PROFILE_MAX_LINES + AQ_PROFILE_MAX_QUEENS];
+    struct profile_row row;
+    int length;
+    uint64_t hash;
+    size_t slot;
+
+    // Every line is dead below the last row, so the frontier is empty.
+    if (r == ctx->size) {
+        return 0;
+    }
+
+    length = profile_key(ctx, r, state, key);
+    hash = lines_hash(key, length);
+    if (ctx->capacity) {
+        slot = profile_find(ctx, key, length, hash);
+        if (ctx->entries[slot].length) {
+            return ctx->entries[slot].value;
+        }
+    }
+
+    profile_row_init(&row, r, state);
+    profile_place(ctx, &row, 0);
+    if (!ctx->error && profile_remember(ctx, key, length, hash,
+                row.best) == -1) {
+        ctx->error = errno;
+    }
+
+    return row.best;
+}
+
+/**
+ * Stores every completion of rows r on below a frontier with exactly target
+ * queens.
+ */
+static
+void profile_collect(struct profile_context *ctx, int r,
+        const struct profile_state *state, int target) {
+    struct profile_row row;
+
+    profile_row_init(&row, r, state);
+    row.collect = 1;
+    row.target = target;
+    profile_place(ctx, &row, 0);
+}
+
+/**
+ * Solves a single k over this instance's share of the first row. Returns
+ * the most queens found, or -1 with errno set.
+ */
+static
+int profile_solve_k(const struct aq_params *params, int k,
+        struct aq_store *solutions) {
+    struct profile_context *ctx = malloc(sizeof(struct profile_context));
+    struct profile_state empty;
+    struct profile_row row;
+    int max_queens;
+
+    if (ctx == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    profile_context_init(ctx, params, k);
+    ctx->solutions = solutions;
+    empty.num_queens = 0;
+    memset(empty.slots, -1, sizeof(empty.slots));
+
+    // The first row is evaluated apart from the memo, since only this
+    // instance's patterns count towards it.
+    profile_row_init(&row, 0, &empty);
+    profile_place(ctx, &row, 0);
+    max_queens = row.best;
+
+    if (!ctx->error && max_queens > 0) {
+        ctx->num_patterns = 0;
+        profile_collect(ctx, 0, &empty, max_queens);
+    }
+
+    TRACE_INFO(PROFILE_K, k, max_queens, ctx->count);
+    if (ctx->error) {
+        errno = ctx->error;
+        max_queens = -1;
+    } else if (max_queens < 0) {
+        max_queens = 0;
+    }
+
+    profile_context_free(ctx);
+    free(ctx);
+    return max_queens;
+}
+
+/**
+ * Runs a complete search like aq_solve_multi, with the same meaning of the
+ * arguments, except that max_queens only goes out. Returns 0, or -1 with
+ * errno set.
+ */
+int profile_solve_multi(const struct aq_params *params,
+        struct aq_store *solutions, int *max_queens) {
+    int num_k = aq_num_k(params);
+
+    if (params->w || params->N > AQ_PROFILE_MAX_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (int i = 0; i < num_k; ++i) {
+        store_clear(&solutions[i]);
+        max_queens[i] = profile_solve_k(params, params->multi ? i : params->k,
+                &solutions[i]);
+        if (max_queens[i] == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,61 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A row-by-row dynamic programming engine for normal boards.
+ *
+ * The board is swept one row at a time, placing a whole row of queens at
+ * once. The rows above only matter to the rows below through the frontier:
+ * for every column, diagonal and anti-diagonal, the lowest queen on it, if
+ * any, together with how many more attacks each such queen still needs.
+ * Attacks from above and within a row are known as soon as the row is
+ * placed, and every ray pointing down adds one attack as soon as a queen
+ * lands on its line. Different histories that leave the same frontier have
+ * the same best completion, so it is only computed once.
+ *
+ * This trades the search over cell sets for a search over frontiers, which
+ * pays off when k is small enough to keep the frontiers few. Wrap-around
+ * boards have no top row to start from, and are not supported.
+ *
+ * Every board that passes board_all_has_same_attacks is found. The search of
+ * aq.h never places a queen on the row or column of the one placed before
+ * it, so it can miss boards with most of their queens on a single line,
+ * such as 0,1,2,6 for N = 3 and k = 2, and then lists fewer solutions. On
+ * the tiniest boards it even finds a smaller maximum: none for N = 2 and
+ * k = 2, where three queens fit.
+ */
+
+#ifndef AQ_PROFILE_H_
+#define AQ_PROFILE_H_
+
+#include "aq.h"
+#include "lines.h"
+#include "store.h"
+
+/**
+ * Largest board the engine handles, and the number of lines of such a
+ * board: its columns, diagonals and anti-diagonals.
+ */
+#define AQ_PROFILE_MAX_SIZE AQ_LINES_MAX_SIZE
+#define AQ_PROFILE_MAX_LINES AQ_LINES_MAX
+
+/**
+ * Largest number of queens on the frontier while a row is placed: one for
+ * every line, plus the row itself.
+ */
+#define AQ_PROFILE_MAX_QUEENS (AQ_PROFILE_MAX_LINES + AQ_PROFILE_MAX_SIZE)
+
+/**
+ * Number of frontiers the memo first makes room for.
+ */
+#define AQ_PROFILE_INITIAL_CAPACITY 4096
+
+/**
+ * Function prototypes.
+ */
+int profile_solve_multi(const struct aq_params *params,
+        struct aq_store *solutions, int *max_queens);
+
+#endif /* AQ_PROFILE_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,331 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Shards of a search run as independent jobs, shared by every findAQ driver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "aq.h"
+#include "join.h"
+#include "profile.h"
+#include "shard.h"
+#include "store.h"
+#include "trace.h"
+
+static const char SHARD_MAGIC[8] = "AQSHARD1";
+
+/**
+ * Writes the partial result of a shard to path. The file is written under a
+ * temporary name first, so that a shard killed halfway leaves no partial
+ * result behind. Returns 0, or -1 with errno set.
+ */
+static
+int writeShard(const char *path, struct shard_header *header,
+        struct aq_store *solutions, int *max_queens) {
+    char temporary[PATH_MAX];
+    struct shard_result result;
+    int saved_errno;
+    FILE *file;
+    int failed;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", path) >=
+            (int) sizeof(temporary)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    file = fopen(temporary, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    failed = fwrite(header, sizeof(*header), 1, file) != 1;
+    for (int i = 0; i < header->num_k && !failed; ++i) {
+        memset(&result, 0, sizeof(result));
+        result.max_queens = max_queens[i];
+        result.count = header->l ? store_count(&solutions[i]) : 0;
+        failed = fwrite(&result, sizeof(result), 1, file) != 1 ||
+            (result.count && fwrite(store_slices(&solutions[i], 0),
+                sizeof(uint64_t) * solutions[i].width, result.count,
+                file) != result.count);
+    }
+
+    saved_errno = errno;
+    failed |= fclose(file) != 0;
+    if (failed || rename(temporary, path) == -1) {
+        saved_errno = failed ? saved_errno : errno;
+        remove(temporary);
+        errno = saved_errno;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Solves a single shard of an instance in this process, and writes its
+ * partial result to the file given with --output.
+ */
+int runShard(struct program_args *args) {
+    struct aq_store solutions[AQ_MAX_ATTACKS + 1];
+    int max_queens[AQ_MAX_ATTACKS + 1];
+    struct shard_header header;
+    struct aq_params params;
+    int retval;
+    int num_k;
+
+    if (args->trace && trace_open(args->trace, args->shard) == -1) {
+        fprintf(stderr, "%s: Failed to open trace %s (errno %d)\n",
+                "runShard", args->trace, errno);
+        return EXIT_UNKNOWN;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.N = args->N;
+    params.k = args->k;
+    params.w = args->w;
+    params.multi = args->all_k;
+    params.order = args->order;
+    params.rank = args->shard;
+    params.nprocs = args->num_shards;
+    params.split_depth = args->shard_depth;
+    num_k = aq_num_k(&params);
+    for (int i = 0; i < num_k; ++i) {
+        store_init(&solutions[i], args->N, args->memory);
+        max_queens[i] = 0;
+    }
+
+    TRACE_INFO(SOLVE_START, args->N, args->k, args->w, args->num_shards,
+            args->engine);
+    if (args->engine == ENGINE_PROFILE) {
+        retval = profile_solve_multi(&params, solutions, max_queens);
+    } else if (args->engine == ENGINE_JOIN) {
+        retval = join_solve_multi(&params, solutions, max_queens);
+    } else {
+        retval = aq_solve_multi(&params, NULL, solutions, max_queens, NULL);
+    }
+
+    if (retval == -1) {
+        fprintf(stderr, "%s: Solver failed (errno %d)\n", "runShard", errno);
+        return EXIT_UNKNOWN;
+    }
+
+    for (int i = 0; i < num_k; ++i) {
+        TRACE_INFO(SOLVE_END, (params.multi ? 0 : params.k) + i,
+                max_queens[i], store_count(&solutions[i]), 0);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHARD_MAGIC, sizeof(header.magic));
+    header.N = args->N;
+    header.k = args->k;
+    header.l = args->l;
+    header.w = args->w;
+    header.all_k = args->all_k;
+    header.engine = args->engine;
+    header.shard = args->shard;
+    header.num_shards = args->num_shards;
+    header.shard_depth = args->shard_depth;
+    header.num_k = num_k;
+    retval = writeShard(args->output, &header, solutions, max_queens);
+    if (retval == -1) {
+        fprintf(stderr, "%s: Failed to write %s (errno %d)\n", "runShard",
+                args->output, errno);
+    }
+
+    for (int i = 0; i < num_k; ++i) {
+        store_free(&solutions[i]);
+    }
+
+    return retval == -1 ? EXIT_UNKNOWN : EXIT_OK;
+}
+
+/**
+ * Returns whether two partial results come from shards of the same run.
+ */
+static inline
+int sameRun(struct shard_header *first, struct shard_header *second) {
+    return first->N == second->N && first->k == second->k &&
+        first->l == second->l && first->w == second->w &&
+        first->all_k == second->all_k && first->engine == second->engine &&
+        first->num_shards == second->num_shards &&
+        first->shard_depth == second->shard_depth &&
+        first->num_k == second->num_k;
+}
+
+/**
+ * Reads the partial result of a shard from file, merging its solutions into
+ * those with the most queens so far. Returns 0, or -1 if the file is cut
+ * short or a store cannot grow.
+ */
+static
+int readShard(FILE *file, struct shard_header *header,
+        struct aq_store *solutions, int *max_queens) {
+    uint64_t slices[AQ_BOARD_SLICES];
+    struct shard_result result;
+
+    for (int i = 0; i < header->num_k; ++i) {
+        if (fread(&result, sizeof(result), 1, file) != 1) {
+            return -1;
+        }
+
+        if (result.max_queens > max_queens[i]) {
+            store_clear(&solutions[i]);
+            max_queens[i] = result.max_queens;
+        }
+
+        for (uint64_t j = 0; j < result.count; ++j) {
+            if (fread(slices, sizeof(uint64_t), solutions[i].width,
+                        file) != (size_t) solutions[i].width) {
+                return -1;
+            }
+
+            // The store drops the duplicates.
+            if (result.max_queens == max_queens[i] &&
+                store_insert_slices(&solutions[i], slices) == -1) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Merges the partial results of every shard of a run, given as paths, and
+ * prints the results of the whole run as findAQ would, with --orbits if the
+ * paths follow it. Every shard must be given exactly once.
+ */
+int mergeShards(int argc, char *argv[]) {
+    struct aq_store solutions[AQ_MAX_ATTACKS + 1];
+    int max_queens[AQ_MAX_ATTACKS + 1];
+    struct shard_header first;
+    struct shard_header header;
+    struct program_args args;
+    struct aq_store no_solutions;
+    char *seen = NULL;
+    int orbits = 0;
+    int missing = 0;
+    int first_k;
+    FILE *file;
+
+    if (argc > 0 && !strcmp(argv[0], "--orbits")) {
+        orbits = 1;
+        argc--;
+        argv++;
+    }
+
+    if (argc < 1) {
+        fprintf(stderr, "merge: The partial result of every shard is "
+                "required.\n");
+        return EXIT_NUM_ARGS_INCORRECT;
+    }
+
+    memset(&first, 0, sizeof(first));
+    for (int i = 0; i < argc; ++i) {
+        file = fopen(argv[i], "rb");
+        if (file == NULL) {
+            fprintf(stderr, "%s: Failed to open %s (errno %d)\n",
+                    "mergeShards", argv[i], errno);
+            return EXIT_UNKNOWN;
+        }
+
+        if (fread(&header, sizeof(header), 1, file) != 1 ||
+            memcmp(header.magic, SHARD_MAGIC, sizeof(header.magic)) ||
+            header.N < 2 || header.N * header.N > AQ_BOARD_MAX_CELLS ||
+            header.num_k < 1 || header.num_k > AQ_MAX_ATTACKS + 1 ||
+            header.num_shards < 1 || header.shard < 0 ||
+            header.shard >= header.num_shards) {
+            fprintf(stderr, "merge: %s is not a partial result.\n", argv[i]);
+            return EXIT_ARGS_INVALID;
+        }
+
+        if (i == 0) {
+            // Every shard is of the same run, so the first tells whether
+            // --orbits applies before anything is merged.
+            first = header;
+            if (orbits && !first.w && first.engine == ENGINE_DFS) {
+                fprintf(stderr, "merge: --orbits needs w, or --engine "
+                        "profile or join.\n");
+                return EXIT_ARGS_INVALID;
+            }
+
+            seen = calloc(first.num_shards, 1);
+            if (seen == NULL) {
+                fprintf(stderr, "%s: Failed to allocate %d shards\n",
+                        "mergeShards", first.num_shards);
+                return EXIT_UNKNOWN;
+            }
+
+            for (int j = 0; j < first.num_k; ++j) {
+                store_init(&solutions[j], first.N, 0);
+                max_queens[j] = 0;
+            }
+        } else if (!sameRun(&first, &header)) {
+            fprintf(stderr, "merge: %s is from another run than %s.\n",
+                    argv[i], argv[0]);
+            return EXIT_ARGS_INVALID;
+        }
+
+        if (seen[header.shard]) {
+            fprintf(stderr, "merge: Shard %d/%d is given twice.\n",
+                    header.shard, header.num_shards);
+            return EXIT_ARGS_INVALID;
+        }
+
+        seen[header.shard] = 1;
+        if (readShard(file, &header, solutions, max_queens) == -1) {
+            fprintf(stderr, "%s: Failed to read %s (errno %d)\n",
+                    "mergeShards", argv[i], errno);
+            return EXIT_UNKNOWN;
+        }
+
+        fclose(file);
+    }
+
+    for (int i = 0; i < first.num_shards; ++i) {
+        if (!seen[i]) {
+            fprintf(stderr, "merge: Shard %d/%d is missing.\n", i,
+                    first.num_shards);
+            missing++;
+        }
+    }
+
+    if (missing) {
+        return EXIT_ARGS_INVALID;
+    }
+
+    memset(&args, 0, sizeof(args));
+    args.N = first.N;
+    args.l = first.l;
+    args.w = first.w;
+    args.orbits = orbits;
+    store_init(&no_solutions, first.N, 0);
+
+    // No queen is attacked more than AQ_MAX_ATTACKS times, so any larger k
+    // has no solutions.
+    first_k = first.all_k ? 0 : first.k;
+    for (int i = 0; first_k + i <= first.k; ++i) {
+        args.k = first_k + i;
+        if (i < first.num_k) {
+            printSolutions(&solutions[i], max_queens[i], &args);
+        } else {
+            printSolutions(&no_solutions, 0, &args);
+        }
+    }
+
+    for (int i = 0; i < first.num_k; ++i) {
+        store_free(&solutions[i]);
+    }
+
+    free(seen);
+    return EXIT_OK;
+}
+
+/* vim: set ts=4 sw=4 et: */
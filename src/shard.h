@@ -0,0 +1,62 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Shards of a search run as independent jobs, shared by every findAQ driver.
+ *
+ * With --shard i/n, findAQ solves the i-th of n shards of an instance in a
+ * single process, without MPI, and writes what it found to a partial result
+ * file. The shards are the tasks of the search dealt out round-robin, or
+ * with --shard-depth d the nodes at depth d (see aq_params), so any number
+ * of shards may run as a job array and a failed shard may simply be run
+ * again. findAQ merge [--orbits] then reads the partial result of every
+ * shard and prints what findAQ would have printed for the whole instance.
+ *
+ * A partial result file holds a struct shard_header, followed for each of
+ * its num_k values of k by a struct shard_result and the occupied slices of
+ * its solutions (see store.h). Solutions are only kept when l asks for them.
+ * Numbers are in the byte order of the host that wrote them.
+ */
+
+#ifndef AQ_SHARD_H_
+#define AQ_SHARD_H_
+
+#include <stdint.h>
+
+#include "cli.h"
+
+/**
+ * The header of a partial result file.
+ */
+struct shard_header {
+    char magic[8];
+    int32_t N;
+    int32_t k;
+    int32_t l;
+    int32_t w;
+    int32_t all_k;
+    int32_t engine;
+    int32_t shard;
+    int32_t num_shards;
+    int32_t shard_depth;
+    int32_t num_k;
+};
+
+/**
+ * The results of a shard for one k, followed by count boards.
+ */
+struct shard_result {
+    int32_t max_queens;
+    int32_t reserved;
+    uint64_t count;
+};
+
+/**
+ * Function prototypes.
+ */
+int runShard(struct program_args*);
+int mergeShards(int, char**);
+
+#endif /* AQ_SHARD_H_ */
+
+/* vim: set ts=4 sw=4 et: */
@@ -128,13 +128,14 @@ int stack_count(struct aq_stack *stack) {
 }
 
 /**
- * Dumps the contents of a stack.
+ * Dumps the contents of a stack to stderr.
  */
 inline
 void stack_dump(struct aq_stack *stack) {
     for (int i = 0; i <= stack->top; ++i) {
-        LOG("stack_dump", "row=%d, col=%d, depth=%d", stack->stack[i].row,
-                stack->stack[i].col, stack->stack[i].depth);
+        fprintf(stderr, "stack_dump: row=%d, col=%d, depth=%d\n",
+                stack->stack[i].row, stack->stack[i].col,
+                stack->stack[i].depth);
     }
 }
 
@@ -0,0 +1,320 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A growable set of solutions.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "store.h"
+#include "trace.h"
+
+extern size_t store_count(struct aq_store*);
+extern const uint64_t *store_slices(struct aq_store*, size_t);
+extern struct aq_board store_get(struct aq_store*, size_t);
+extern uint64_t store_hash(const uint64_t*, int);
+
+/**
+ * Returns the slot of the index holding a board, or the empty slot where it
+ * would go.
+ */
+static inline
+size_t store_find(struct aq_store *store, const uint64_t *slices) {
+    size_t mask = store->index_capacity - 1;
+    size_t slot = (size_t) store_hash(slices, store->width) & mask;
+
+    while (store->index[slot] &&
+           memcmp(store_slices(store, store->index[slot] - 1), slices,
+               store->width * sizeof(uint64_t))) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/**
+ * Maps the spill file of a store with room for capacity boards.
+ */
+static
+uint64_t *store_map(struct aq_store *store, size_t capacity) {
+    size_t bytes = capacity * store->width * sizeof(uint64_t);
+    void *boards;
+
+    if (ftruncate(store->fd, bytes) == -1) {
+        return NULL;
+    }
+
+    boards = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd,
+            0);
+    return boards == MAP_FAILED ? NULL : boards;
+}
+
+/**
+ * Moves the boards of a store from memory into a new spill file in $TMPDIR.
+ */
+static
+int store_spill(struct aq_store *store, size_t capacity) {
+    const char *dir = getenv("TMPDIR");
+    uint64_t *boards;
+
+    snprintf(store->path, AQ_STORE_PATH_MAX, "%s/aq-store-XXXXXX",
+            dir ? dir : "/tmp");
+    store->fd = mkstemp(store->path);
+    if (store->fd == -1) {
+        return -1;
+    }
+
+    boards = store_map(store, capacity);
+    if (boards == NULL) {
+        close(store->fd);
+        unlink(store->path);
+        store->fd = -1;
+        return -1;
+    }
+
+    TRACE_INFO(STORE_SPILL, store->count);
+    memcpy(boards, store->boards,
+            store->count * store->width * sizeof(uint64_t));
+    free(store->boards);
+    store->boards = boards;
+    return 0;
+}
+
+/**
+ * Maps an unlinked file in $TMPDIR of the given number of zero bytes, for an
+ * index that does not fit the budget. Sets fd to the file.
+ */
+static
+size_t *store_map_index(size_t bytes, int *fd) {
+    const char *dir = getenv("TMPDIR");
+    char path[AQ_STORE_PATH_MAX];
+    void *index;
+
+    snprintf(path, AQ_STORE_PATH_MAX, "%s/aq-index-XXXXXX",
+            dir ? dir : "/tmp");
+    *fd = mkstemp(path);
+    if (*fd == -1) {
+        return NULL;
+    }
+
+    unlink(path);
+    index = ftruncate(*fd, bytes) == -1 ? MAP_FAILED :
+        mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    if (index == MAP_FAILED) {
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+
+    return index;
+}
+
+/**
+ * Releases the index of a store.
+ */
+static
+void store_free_index(struct aq_store *store) {
+    if (store->index_fd == -1) {
+        free(store->index);
+    } else {
+        munmap(store->index, store->index_capacity * sizeof(size_t));
+        close(store->index_fd);
+    }
+
+    store->index = NULL;
+    store->index_fd = -1;
+}
+
+/**
+ * Doubles the index and re-inserts every board. The index counts towards the
+ * budget, so the boards are spilled first once both no longer fit, and the
+ * index itself is moved to a file if it does not fit on its own.
+ */
+static
+int store_grow_index(struct aq_store *store) {
+    size_t capacity = store->index_capacity ?
+        store->index_capacity * 2 : AQ_STORE_INITIAL_CAPACITY * 2;
+    size_t bytes = capacity * sizeof(size_t);
+    size_t *index;
+    int fd = -1;
+
+    if (store->fd == -1 && store->capacity &&
+        bytes + store->capacity * store->width * sizeof(uint64_t) >
+        store->budget && store_spill(store, store->capacity) == -1) {
+        return -1;
+    }
+
+    if (bytes <= store->budget) {
+        index = calloc(capacity, sizeof(size_t));
+        if (index == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+    } else {
+        index = store_map_index(bytes, &fd);
+        if (index == NULL) {
+            return -1;
+        }
+    }
+
+    store_free_index(store);
+    store->index = index;
+    store->index_fd = fd;
+    store->index_capacity = capacity;
+
+    for (size_t i = 0; i < store->count; ++i) {
+        store->index[store_find(store, store_slices(store, i))] = i + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Doubles the room for boards, spilling to a file once they and the index no
+ * longer fit the budget.
+ */
+static
+int store_grow(struct aq_store *store) {
+    size_t capacity = store->capacity ?
+        store->capacity * 2 : AQ_STORE_INITIAL_CAPACITY;
+    size_t bytes = capacity * store->width * sizeof(uint64_t);
+    size_t resident = bytes;
+    uint64_t *boards;
+
+    if (store->index_fd == -1) {
+        resident += store->index_capacity * sizeof(size_t);
+    }
+
+    if (store->fd == -1 && resident <= store->budget) {
+        boards = realloc(store->boards, bytes);
+        if (boards == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        store->boards = boards;
+    } else if (store->fd == -1) {
+        if (store_spill(store, capacity) == -1) {
+            return -1;
+        }
+    } else {
+        munmap(store->boards, store->capacity * store->width *
+                sizeof(uint64_t));
+        store->boards = store_map(store, capacity);
+        if (store->boards == NULL) {
+            return -1;
+        }
+    }
+
+    store->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Initializes an empty store.
+ */
+void store_init(struct aq_store *store, int size, size_t budget) {
+    struct aq_geometry geometry;
+
+    board_geometry_init(&geometry, size);
+    store->size = size;
+    store->width = geometry.slices_occupied;
+    store->boards = NULL;
+    store->count = 0;
+    store->capacity = 0;
+    store->budget = budget ? budget : AQ_STORE_BUDGET;
+    store->index = NULL;
+    store->index_capacity = 0;
+    store->index_fd = -1;
+    store->fd = -1;
+    store->path[0] = '\0';
+}
+
+/**
+ * Releases a store.
+ */
+void store_free(struct aq_store *store) {
+    if (store->fd == -1) {
+        free(store->boards);
+    } else if (store->boards != NULL) {
+        munmap(store->boards, store->capacity * store->width *
+                sizeof(uint64_t));
+    }
+
+    if (store->fd != -1) {
+        close(store->fd);
+        unlink(store->path);
+    }
+
+    store_free_index(store);
+    store_init(store, store->size, store->budget);
+}
+
+/**
+ * Removes every board.
+ */
+void store_clear(struct aq_store *store) {
+    store->count = 0;
+    if (store->index) {
+        memset(store->index, 0, store->index_capacity * sizeof(size_t));
+    }
+}
+
+/**
+ * Adds a board given as its occupied slices.
+ */
+int store_insert_slices(struct aq_store *store, const uint64_t *slices) {
+    size_t slot;
+
+    // Keep the index at most half full.
+    if (2 * (store->count + 1) > store->index_capacity &&
+        store_grow_index(store) == -1) {
+        return -1;
+    }
+
+    slot = store_find(store, slices);
+    if (store->index[slot]) {
+        return 0;
+    }
+
+    if (store->count == store->capacity && store_grow(store) == -1) {
+        return -1;
+    }
+
+    memcpy(store->boards + store->count * store->width, slices,
+            store->width * sizeof(uint64_t));
+    store->count++;
+    store->index[slot] = store->count;
+    return 1;
+}
+
+/**
+ * Adds a board.
+ */
+int store_insert(struct aq_store *store, struct aq_board *board) {
+    return store_insert_slices(store, board->slices);
+}
+
+/**
+ * Adds every board of another store.
+ */
+int store_merge(struct aq_store *store, struct aq_store *other) {
+    for (size_t i = 0; i < other->count; ++i) {
+        if (store_insert_slices(store, store_slices(other, i)) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
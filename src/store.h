@@ -0,0 +1,150 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * A growable set of solutions.
+ *
+ * Boards are kept back to back as their occupied slices only. They are held
+ * in memory until the store outgrows its budget, after which they are moved
+ * to a memory-mapped file, so the number of solutions is only bounded by
+ * disk space. A hash index over the boards drops duplicates on insertion.
+ * The index counts towards the budget as well, and is moved to a file of its
+ * own once it alone outgrows it. Spill files are private to the store, and
+ * removed when it is released.
+ */
+
+#ifndef AQ_STORE_H_
+#define AQ_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+/**
+ * Default number of bytes of boards and index kept in memory before spilling.
+ */
+#define AQ_STORE_BUDGET (64L * 1024L * 1024L)
+
+/**
+ * Number of boards the store first makes room for.
+ */
+#define AQ_STORE_INITIAL_CAPACITY 64
+
+/**
+ * Maximum length of the path of a spill file.
+ */
+#define AQ_STORE_PATH_MAX 256
+
+/**
+ * A set of boards of the same size.
+ *
+ * index is an open-addressing hash table holding the position of every
+ * board plus one, with zero marking an empty slot. fd is -1 as long as the
+ * boards are in memory, and index_fd as long as the index is.
+ */
+struct aq_store {
+    int size;
+    int width;
+
+    uint64_t *boards;
+    size_t count;
+    size_t capacity;
+    size_t budget;
+
+    size_t *index;
+    size_t index_capacity;
+    int index_fd;
+
+    int fd;
+    char path[AQ_STORE_PATH_MAX];
+};
+
+/**
+ * Initializes an empty store for boards of the given size. Nothing is
+ * allocated until the first insertion. A budget of zero means
+ * AQ_STORE_BUDGET.
+ */
+void store_init(struct aq_store *store, int size, size_t budget);
+
+/**
+ * Releases a store, removing its spill file if it has one.
+ */
+void store_free(struct aq_store *store);
+
+/**
+ * Removes every board, keeping the space already allocated.
+ */
+void store_clear(struct aq_store *store);
+
+/**
+ * Adds a board given as its occupied slices, unless it is already present.
+ *
+ * Returns 1 if the board was added, 0 if it was a duplicate, or -1 with errno
+ * set if the store could not grow.
+ */
+int store_insert_slices(struct aq_store *store, const uint64_t *slices);
+
+/**
+ * Adds a board, unless it is already present. See store_insert_slices.
+ */
+int store_insert(struct aq_store *store, struct aq_board *board);
+
+/**
+ * Adds every board of another store of the same size. Returns 0, or -1 with
+ * errno set.
+ */
+int store_merge(struct aq_store *store, struct aq_store *other);
+
+/**
+ * Returns the number of boards in a store.
+ */
+inline
+size_t store_count(struct aq_store *store) {
+    return store->count;
+}
+
+/**
+ * Returns the occupied slices of the i-th board of a store.
+ */
+inline
+const uint64_t *store_slices(struct aq_store *store, size_t i) {
+    return store->boards + i * store->width;
+}
+
+/**
+ * Returns the i-th board of a store.
+ */
+inline
+struct aq_board store_get(struct aq_store *store, size_t i) {
+    struct aq_board board = { {0} };
+    const uint64_t *slices = store_slices(store, i);
+
+    for (int j = 0; j < store->width; ++j) {
+        board.slices[j] = slices[j];
+    }
+
+    return board;
+}
+
+/**
+ * Hashes the occupied slices of a board. The index of a store only uses the
+ * low bits of the hash, so the high bits are free to tell processes which
+ * of them owns a board.
+ */
+inline
+uint64_t store_hash(const uint64_t *slices, int width) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+
+    for (int i = 0; i < width; ++i) {
+        hash ^= slices[i];
+        hash *= 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+
+    return hash;
+}
+
+#endif /* AQ_STORE_H_ */
+
+/* vim: set ts=4 sw=4 et: */
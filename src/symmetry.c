@@ -0,0 +1,19 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Board symmetries.
+ */
+
+#include "symmetry.h"
+
+extern void symmetry_map(int, int, int*, int*);
+extern struct aq_board symmetry_transform(struct aq_board*,
+        const struct aq_geometry*, int, int, int);
+extern struct aq_board symmetry_canonical(struct aq_board*,
+        const struct aq_geometry*, int);
+extern int symmetry_qsort_compare(const void*, const void*);
+extern int symmetry_orbit(struct aq_board*, const struct aq_geometry*, int,
+        struct aq_board*);
+
+/* vim: set ts=4 sw=4 et: */
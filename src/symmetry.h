@@ -0,0 +1,182 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Board symmetries.
+ *
+ * Every board is equivalent to its images under the eight symmetries of the
+ * square (the dihedral group D4). On a wrap-around board, each image can be
+ * further translated by any (row, col) offset, which gives a group of order
+ * 8 * N * N.
+ */
+
+#ifndef AQ_SYMMETRY_H_
+#define AQ_SYMMETRY_H_
+
+#include <stdlib.h>
+#include "board.h"
+
+/**
+ * Number of symmetries of the square.
+ */
+#define AQ_SYMMETRY_DIHEDRAL 8
+
+/**
+ * Largest possible orbit of a board, reached on a wrap-around board of the
+ * maximum size (16 * 16 translations of each dihedral image).
+ */
+#define AQ_SYMMETRY_MAX_ORBIT (AQ_SYMMETRY_DIHEDRAL * 16 * 16)
+
+/**
+ * Maps a position through the t-th symmetry of the square.
+ *
+ * Bit 2 of t transposes the board, bit 0 flips the rows and bit 1 flips the
+ * columns. Together these generate all of D4.
+ */
+inline
+void symmetry_map(int size, int t, int *row, int *col) {
+    int r = *row, c = *col;
+
+    if (t & 4) {
+        int tmp = r;
+        r = c;
+        c = tmp;
+    }
+
+    if (t & 1) {
+        r = size - 1 - r;
+    }
+
+    if (t & 2) {
+        c = size - 1 - c;
+    }
+
+    *row = r;
+    *col = c;
+}
+
+/**
+ * Returns the image of a board under the t-th symmetry of the square,
+ * followed by a wrap-around translation of (dr, dc).
+ */
+inline
+struct aq_board symmetry_transform(struct aq_board *board,
+        const struct aq_geometry *geometry, int t, int dr, int dc) {
+    struct aq_board image = board_new();
+    int size = geometry->size;
+
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j < size; ++j) {
+            if (board_is_occupied(board, geometry, i, j)) {
+                int r = i, c = j;
+                symmetry_map(size, t, &r, &c);
+                board_set_occupied(&image, geometry, (r + dr) % size,
+                        (c + dc) % size);
+            }
+        }
+    }
+
+    return image;
+}
+
+/**
+ * Returns the canonical representative of the orbit of a board: the image
+ * that compares greatest under boards_compare, i.e. the one whose sorted
+ * list of queens is lexicographically smallest.
+ *
+ * On a wrap-around board the canonical image always has a queen at (0, 0),
+ * so only the translations that move a queen there need to be considered.
+ */
+inline
+struct aq_board symmetry_canonical(struct aq_board *board,
+        const struct aq_geometry *geometry, int wrap) {
+    struct aq_board best = *board;
+    struct aq_board image;
+    int size = geometry->size;
+
+    for (int t = 0; t < AQ_SYMMETRY_DIHEDRAL; ++t) {
+        if (!wrap) {
+            image = symmetry_transform(board, geometry, t, 0, 0);
+            if (boards_compare(&image, &best, geometry) > 0) {
+                best = image;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                if (!board_is_occupied(board, geometry, i, j)) {
+                    continue;
+                }
+
+                int r = i, c = j;
+                symmetry_map(size, t, &r, &c);
+                image = symmetry_transform(board, geometry, t,
+                        (size - r) % size, (size - c) % size);
+                if (boards_compare(&image, &best, geometry) > 0) {
+                    best = image;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Comparator for qsort, ordering boards from greatest to smallest. qsort
+ * cannot pass the geometry along, so every slice is compared, which gives the
+ * same order as boards_compare since the slices past the board are clear.
+ */
+inline
+int symmetry_qsort_compare(const void *b1, const void *b2) {
+    const struct aq_board *board1 = b1;
+    const struct aq_board *board2 = b2;
+
+    for (int i = 0; i < AQ_BOARD_SLICES; ++i) {
+        if (board1->slices[i] != board2->slices[i]) {
+            return board2->slices[i] < board1->slices[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Expands a board into its full orbit. orbit must have space for at least
+ * AQ_SYMMETRY_MAX_ORBIT boards. Returns the number of distinct images, which
+ * are sorted from greatest to smallest.
+ */
+inline
+int symmetry_orbit(struct aq_board *board, const struct aq_geometry *geometry,
+        int wrap, struct aq_board *orbit) {
+    int num_images = 0;
+    int num_translations = wrap ? geometry->size : 1;
+
+    for (int t = 0; t < AQ_SYMMETRY_DIHEDRAL; ++t) {
+        for (int dr = 0; dr < num_translations; ++dr) {
+            for (int dc = 0; dc < num_translations; ++dc) {
+                orbit[num_images++] = symmetry_transform(board, geometry, t,
+                        dr, dc);
+            }
+        }
+    }
+
+    qsort(orbit, num_images, sizeof(struct aq_board), symmetry_qsort_compare);
+
+    // Remove the duplicates.
+    int num_distinct = 0;
+    for (int i = 0; i < num_images; ++i) {
+        if (num_distinct == 0 ||
+            !boards_are_equal(&orbit[num_distinct - 1], &orbit[i],
+                geometry)) {
+            orbit[num_distinct++] = orbit[i];
+        }
+    }
+
+    return num_distinct;
+}
+
+#endif /* AQ_SYMMETRY_H_ */
+
+/* vim: set ts=4 sw=4 et: */
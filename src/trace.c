@@ -0,0 +1,189 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Leveled tracing into an in-memory ring buffer.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define AQ_TRACE_NAME(name, args) #name,
+#define AQ_TRACE_ARGS(name, args) args,
+
+struct trace_ring trace_ring;
+__thread int trace_thread;
+
+const char *const TRACE_EVENT_NAMES[] = { AQ_TRACE_EVENTS(AQ_TRACE_NAME) };
+const char *const TRACE_EVENT_ARGS[] = { AQ_TRACE_EVENTS(AQ_TRACE_ARGS) };
+
+/**
+ * Signals that end the process, after which the trace is dumped before the
+ * default action runs.
+ */
+static const int FATAL_SIGNALS[] = {
+    SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGTERM
+};
+
+extern uint64_t trace_clock(clockid_t);
+extern void trace_emit(int, int, const int32_t*);
+
+/**
+ * Writes a whole buffer to a file descriptor. Returns 0, or -1 on failure.
+ */
+static
+int trace_write(int fd, const void *buffer, size_t length) {
+    const char *bytes = buffer;
+    ssize_t written;
+
+    while (length > 0) {
+        written = write(fd, bytes, length);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (written <= 0) {
+            return -1;
+        }
+
+        bytes += written;
+        length -= written;
+    }
+
+    return 0;
+}
+
+/**
+ * Dumps the trace on SIGUSR1 and goes on.
+ */
+static
+void trace_on_request(int signal) {
+    int saved_errno = errno;
+
+    trace_dump();
+    errno = saved_errno;
+}
+
+/**
+ * Dumps the trace on a fatal signal, then lets it end the process.
+ */
+static
+void trace_on_fatal(int signal) {
+    trace_dump();
+    trace_ring.records = NULL;
+    raise(signal);
+}
+
+/**
+ * Starts tracing into a ring buffer, which is dumped to prefix.rank at exit,
+ * on a fatal signal and on SIGUSR1. Returns 0, or -1 with errno set.
+ */
+int trace_open(const char *prefix, int rank) {
+    struct sigaction action;
+    static int registered = 0;
+
+    if (snprintf(trace_ring.path, sizeof(trace_ring.path), "%s.%d", prefix,
+                rank) >= (int) sizeof(trace_ring.path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    trace_ring.rank = rank;
+    trace_ring.head = 0;
+    trace_ring.start = trace_clock(CLOCK_MONOTONIC);
+    trace_ring.wall_start = trace_clock(CLOCK_REALTIME);
+    trace_ring.records = calloc(AQ_TRACE_CAPACITY,
+            sizeof(struct trace_record));
+    if (trace_ring.records == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Dumping must be the last thing a fatal signal does, so the default
+    // action is restored before the handler runs.
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND;
+    action.sa_handler = trace_on_fatal;
+    for (size_t i = 0; i < sizeof(FATAL_SIGNALS) / sizeof(int); ++i) {
+        sigaction(FATAL_SIGNALS[i], &action, NULL);
+    }
+
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = trace_on_request;
+    sigaction(SIGUSR1, &action, NULL);
+
+    if (!registered) {
+        atexit(trace_close);
+        registered = 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Writes the events in the ring buffer to the trace file, oldest first. Only
+ * uses calls that are safe in a signal handler.
+ */
+void trace_dump(void) {
+    struct trace_header header;
+    uint64_t head = trace_ring.head;
+    uint64_t first;
+    int fd;
+
+    if (trace_ring.records == NULL) {
+        return;
+    }
+
+    fd = open(trace_ring.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return;
+    }
+
+    first = head > AQ_TRACE_CAPACITY ? head - AQ_TRACE_CAPACITY : 0;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "AQTRACE1", sizeof(header.magic));
+    header.rank = trace_ring.rank;
+    header.level = AQ_TRACE_LEVEL;
+    header.start = trace_ring.wall_start;
+    header.count = head - first;
+    header.lost = first;
+
+    // The events wrap around the end of the buffer at most once.
+    first &= AQ_TRACE_CAPACITY - 1;
+    if (trace_write(fd, &header, sizeof(header)) == 0 &&
+        trace_write(fd, trace_ring.records + first,
+            (header.count < AQ_TRACE_CAPACITY - first ?
+                header.count : AQ_TRACE_CAPACITY - first) *
+            sizeof(struct trace_record)) == 0 &&
+        header.count > AQ_TRACE_CAPACITY - first) {
+        trace_write(fd, trace_ring.records,
+                (header.count - (AQ_TRACE_CAPACITY - first)) *
+                sizeof(struct trace_record));
+    }
+
+    close(fd);
+}
+
+/**
+ * Dumps the trace one last time and stops tracing.
+ */
+void trace_close(void) {
+    struct trace_record *records = trace_ring.records;
+
+    trace_dump();
+    trace_ring.records = NULL;
+    free(records);
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,199 @@
+/**
+ * CS3210 Parallel Computing: Group Project 1 (MPI Aggressive Queen)
+ * National University of Singapore.
+ *
+ * Leveled tracing into an in-memory ring buffer.
+ *
+ * A trace point records a fixed-size binary event: the time, the event and a
+ * few integer arguments. Events go into a ring buffer of the process that
+ * keeps the last AQ_TRACE_CAPACITY of them, which trace_dump writes to a file
+ * for the aqtrace decoder. Nothing is written to the file while the search
+ * runs.
+ *
+ * Every trace point has a level, and those above AQ_TRACE_LEVEL compile to
+ * nothing at all. The level defaults to AQ_TRACE_INFO for release builds and
+ * AQ_TRACE_DEBUG otherwise, and configure --enable-trace sets it explicitly.
+ * Until trace_open is called, the trace points that remain only cost a
+ * branch.
+ */
+
+#ifndef AQ_TRACE_H_
+#define AQ_TRACE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Trace levels. Events at AQ_TRACE_INFO happen a few times per task, those
+ * at AQ_TRACE_DEBUG on every move.
+ */
+#define AQ_TRACE_OFF 0
+#define AQ_TRACE_INFO 1
+#define AQ_TRACE_DEBUG 2
+
+#ifndef AQ_TRACE_LEVEL
+#ifdef NDEBUG
+#define AQ_TRACE_LEVEL AQ_TRACE_INFO
+#else
+#define AQ_TRACE_LEVEL AQ_TRACE_DEBUG
+#endif
+#endif
+
+/**
+ * Number of events the ring buffer keeps, which must be a power of two, and
+ * the number of arguments of an event.
+ */
+#define AQ_TRACE_CAPACITY (1 << 16)
+#define AQ_TRACE_MAX_ARGS 5
+
+/**
+ * Longest path of a trace file.
+ */
+#define AQ_TRACE_PATH_MAX 4096
+
+/**
+ * Every event, along with the names of its arguments for the decoder.
+ */
+#define AQ_TRACE_EVENTS(X) \
+    X(SOLVE_START, "N k w nprocs engine") \
+    X(SOLVE_END, "k max_queens solutions open_bound") \
+    X(TASK_ASSIGN, "task cost owner") \
+    X(TASK_START, "task tasks_remaining") \
+    X(TASK_END, "task max_queens stopped") \
+    X(MOVE_APPLY, "row col depth") \
+    X(MOVE_UNDO, "row col depth") \
+    X(MOVE_GENERATE, "row col depth") \
+    X(SOLUTION, "queens index depth") \
+    X(GATHER_SOURCE, "source solutions max_queens") \
+    X(GATHER_END, "k max_queens solutions") \
+    X(WITNESS, "queens target owner") \
+    X(ANNEAL, "queens k owner") \
+    X(ANNEAL_FOUND, "queens steps") \
+    X(STORE_SPILL, "solutions") \
+    X(DAEMON_QUERY, "action pending") \
+    X(PROFILE_K, "k queens frontiers") \
+    X(JOIN_K, "k queens top bottom pairs")
+
+#define AQ_TRACE_ENUM(name, args) TRACE_##name,
+
+enum trace_event {
+    AQ_TRACE_EVENTS(AQ_TRACE_ENUM)
+    TRACE_NUM_EVENTS
+};
+
+/**
+ * Actions of a DAEMON_QUERY event.
+ */
+#define AQ_TRACE_QUERY_SOLVE 0
+#define AQ_TRACE_QUERY_MEMORY 1
+#define AQ_TRACE_QUERY_COALESCE 2
+
+/**
+ * An event. time is in nanoseconds since trace_open, and thread tells the
+ * threads of a process apart.
+ */
+struct trace_record {
+    uint64_t time;
+    uint8_t event;
+    uint8_t level;
+    uint16_t thread;
+    int32_t args[AQ_TRACE_MAX_ARGS];
+};
+
+/**
+ * The header of a trace file, followed by count events, oldest first. start
+ * is the wall clock time of trace_open in nanoseconds, which lines up the
+ * files of different processes.
+ */
+struct trace_header {
+    char magic[8];
+    int32_t rank;
+    int32_t level;
+    uint64_t start;
+    uint64_t count;
+    uint64_t lost;
+};
+
+/**
+ * The ring buffer of the process, which is global so that a signal handler
+ * can reach it (see aq.h). records is NULL while tracing is off.
+ * head counts every event ever recorded, so the slot of an event is head
+ * modulo AQ_TRACE_CAPACITY.
+ */
+struct trace_ring {
+    struct trace_record *records;
+    uint64_t head;
+    uint64_t start;
+    uint64_t wall_start;
+    int rank;
+    char path[AQ_TRACE_PATH_MAX];
+};
+
+extern struct trace_ring trace_ring;
+extern __thread int trace_thread;
+extern const char *const TRACE_EVENT_NAMES[];
+extern const char *const TRACE_EVENT_ARGS[];
+
+/**
+ * Trace points. The arguments are converted to 32-bit integers, and those
+ * not given are zero.
+ */
+#if AQ_TRACE_LEVEL >= AQ_TRACE_INFO
+#define TRACE_INFO(event, ...) trace_emit(AQ_TRACE_INFO, TRACE_##event, \
+        (const int32_t[AQ_TRACE_MAX_ARGS]) { __VA_ARGS__ })
+#else
+#define TRACE_INFO(event, ...) ((void) 0)
+#endif
+
+#if AQ_TRACE_LEVEL >= AQ_TRACE_DEBUG
+#define TRACE_DEBUG(event, ...) trace_emit(AQ_TRACE_DEBUG, TRACE_##event, \
+        (const int32_t[AQ_TRACE_MAX_ARGS]) { __VA_ARGS__ })
+#else
+#define TRACE_DEBUG(event, ...) ((void) 0)
+#endif
+
+/**
+ * Function prototypes.
+ */
+int trace_open(const char *prefix, int rank);
+void trace_dump(void);
+void trace_close(void);
+
+/**
+ * Returns the time of a clock in nanoseconds.
+ */
+inline
+uint64_t trace_clock(clockid_t clock) {
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Records an event, if tracing is on. Slots are claimed atomically, so any
+ * thread may record at any time.
+ */
+inline
+void trace_emit(int level, int event, const int32_t *args) {
+    struct trace_record *record;
+    uint64_t slot;
+
+    if (trace_ring.records == NULL) {
+        return;
+    }
+
+    slot = __sync_fetch_and_add(&trace_ring.head, 1);
+    record = &trace_ring.records[slot & (AQ_TRACE_CAPACITY - 1)];
+    record->time = trace_clock(CLOCK_MONOTONIC) - trace_ring.start;
+    record->event = event;
+    record->level = level;
+    record->thread = trace_thread;
+    for (int i = 0; i < AQ_TRACE_MAX_ARGS; ++i) {
+        record->args[i] = args[i];
+    }
+}
+
+#endif /* AQ_TRACE_H_ */
+
+/* vim: set ts=4 sw=4 et: */